@@ -46,6 +46,9 @@ SPINLOCK_INLINE
 spinlock_data_t spinlock_data_get(volatile spinlock_data_t *sd);
 SPINLOCK_INLINE
 spinlock_data_t spinlock_data_testandset(volatile spinlock_data_t *sd);
+SPINLOCK_INLINE
+bool spinlock_data_cas(volatile spinlock_data_t *sd,
+		       spinlock_data_t oldval, spinlock_data_t newval);
 
 ////////////////////////////////////////////////////////////
 
@@ -118,5 +121,43 @@ spinlock_data_testandset(volatile spinlock_data_t *sd)
 	return x;
 }
 
+/*
+ * Compare-and-swap a spinlock_data_t: if *SD is OLDVAL, replace it
+ * with NEWVAL and return true; otherwise leave it alone and return
+ * false. Also uses LL/SC; see above.
+ *
+ * False is also returned if the SC fails because someone else got in
+ * between; callers are expected to reload and retry in a loop.
+ *
+ * GCC runs the assembler in noreorder mode, so the branch delay slot
+ * is filled explicitly.
+ */
+SPINLOCK_INLINE
+bool
+spinlock_data_cas(volatile spinlock_data_t *sd,
+		  spinlock_data_t oldval, spinlock_data_t newval)
+{
+	spinlock_data_t x;
+	spinlock_data_t y;
+
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 instructions */
+		".set volatile;"	/* avoid unwanted optimization */
+		".set noreorder;"	/* we fill the delay slot */
+		"move %1, $0;"		/*   y = 0 (failure) */
+		"ll %0, 0(%2);"		/*   x = *sd */
+		"bne %0, %3, 1f;"	/*   if (x != oldval) fail */
+		"nop;"			/*   (delay slot) */
+		"move %1, %4;"		/*   y = newval */
+		"sc %1, 0(%2);"		/*   *sd = y; y = success? */
+		"1:"
+		".set pop"		/* restore assembler mode */
+		: "=&r" (x), "=&r" (y)
+		: "r" (sd), "r" (oldval), "r" (newval)
+		: "memory");
+	return y != 0;
+}
+
 
 #endif /* _MIPS_SPINLOCK_H_ */
@@ -38,6 +38,13 @@
 #define PAGE_SIZE  4096         /* size of VM page */
 #define PAGE_FRAME 0xfffff000   /* mask for getting page number from addr */
 
+/*
+ * Cache line size that per-cpu data is padded out to, so different
+ * cpus' data never share a line. The r3000's lines are smaller; this
+ * is big enough for the later MIPS parts too.
+ */
+#define CACHELINE_SIZE 64
+
 /*
  * MIPS-I hardwired memory layout:
  *    0xc0000000 - 0xffffffff   kseg2 (kernel, tlb-mapped)
@@ -117,12 +124,11 @@ paddr_t ram_getfirstfree(void);
  */
 
 struct tlbshootdown {
-	/*
-	 * Change this to what you need for your VM design.
-	 */
-	int ts_placeholder;
+	vaddr_t ts_vaddr;	/* Page to invalidate, or TLBSHOOTDOWN_ALL */
 };
 
+#define TLBSHOOTDOWN_ALL ((vaddr_t)-1)
+
 #define TLBSHOOTDOWN_MAX 16
 
 
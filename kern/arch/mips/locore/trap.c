@@ -28,6 +28,7 @@
  */
 
 #include <types.h>
+#include <kern/wait.h>
 #include <signal.h>
 #include <lib.h>
 #include <mips/specialreg.h>
@@ -36,6 +37,7 @@
 #include <spl.h>
 #include <thread.h>
 #include <current.h>
+#include <proc.h>
 #include <vm.h>
 #include <mainbus.h>
 #include <syscall.h>
@@ -108,13 +110,31 @@ kill_curthread(vaddr_t epc, unsigned code, vaddr_t vaddr)
 		break;
 	}
 
+	kprintf("Fatal user mode trap %u sig %d (%s, epc 0x%x, vaddr 0x%x)\n",
+		code, sig, trapcodenames[code], epc, vaddr);
+
 	/*
-	 * You will probably want to change this.
+	 * The parent sees the process as killed by SIG, unless it was
+	 * already ending. As with _exit, the other threads follow.
 	 */
+	proc_setexiting(curproc, _MKWAIT_SIG(sig));
+	sys_threadexit(0);
+}
 
-	kprintf("Fatal user mode trap %u sig %d (%s, epc 0x%x, vaddr 0x%x)\n",
-		code, sig, trapcodenames[code], epc, vaddr);
-	panic("I don't know how to handle this\n");
+/*
+ * Called on the way back to user mode. If another thread has ended
+ * the process (see proc_setexiting), end this one instead of running
+ * more user code. p_exiting is only ever set, so peeking at it
+ * without the lock is enough; a thread that misses it catches it on
+ * its next trip through.
+ */
+static
+void
+check_exiting(void)
+{
+	if (curproc->p_exiting) {
+		sys_threadexit(0);
+	}
 }
 
 /*
@@ -185,8 +205,20 @@ mips_trap(struct trapframe *tf)
 			doadjust = false;
 		}
 
+		/*
+		 * From user mode, the time until now was user time;
+		 * the interrupt is charged to the thread as system time.
+		 */
+		if (!iskern) {
+			usage_charge(curthread, true);
+		}
+
 		mainbus_interrupt(tf);
 
+		if (!iskern) {
+			usage_charge(curthread, false);
+		}
+
 		if (doadjust) {
 			KASSERT(curthread->t_curspl == IPL_HIGH);
 			KASSERT(curthread->t_iplhigh_count == 1);
@@ -195,6 +227,18 @@ mips_trap(struct trapframe *tf)
 		}
 
 		curthread->t_in_interrupt = old_in;
+
+		/*
+		 * A thread spinning in user mode only comes in on
+		 * interrupts, so check here too (see check_exiting).
+		 * Exiting sleeps, so first bring the interrupt state
+		 * back in sync as for the other traps below.
+		 */
+		if (!iskern && curproc->p_exiting) {
+			spl = splhigh();
+			splx(spl);
+			sys_threadexit(0);
+		}
 		goto done2;
 	}
 
@@ -212,6 +256,15 @@ mips_trap(struct trapframe *tf)
 	spl = splhigh();
 	splx(spl);
 
+	/*
+	 * Coming from user mode, the time since we last left the
+	 * kernel was user time. (Not before this: usage_charge goes
+	 * to splhigh and back, which would turn interrupts on early.)
+	 */
+	if (!iskern) {
+		usage_charge(curthread, true);
+	}
+
 	/* Syscall? Call the syscall handler and return. */
 	if (code == EX_SYS) {
 		/* Interrupts should have been on while in user mode. */
@@ -315,6 +368,12 @@ mips_trap(struct trapframe *tf)
 	panic("I can't handle this... I think I'll just die now...\n");
 
  done:
+	/* Going back to user mode; the time since entry was system time. */
+	if (!iskern) {
+		check_exiting();
+		usage_charge(curthread, false);
+	}
+
 	/*
 	 * Turn interrupts off on the processor, without affecting the
 	 * stored interrupt state.
@@ -367,6 +426,8 @@ mips_trap(struct trapframe *tf)
 void
 mips_usermode(struct trapframe *tf)
 {
+	/* The time since the thread was last charged was system time. */
+	usage_charge(curthread, false);
 
 	/*
 	 * Interrupts should be off within the kernel while entering
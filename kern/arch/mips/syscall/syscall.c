@@ -35,6 +35,8 @@
 #include <thread.h>
 #include <current.h>
 #include <syscall.h>
+#include <copyinout.h>
+#include <syscallstat.h>
 
 
 /*
@@ -81,15 +83,18 @@ syscall(struct trapframe *tf)
 	int callno;
 	int32_t retval;
 	int err;
+	uint64_t start;
 
 	off_t arg_64;
 	off_t ret_64;
+	userptr_t arg_ptr;
 
 	KASSERT(curthread != NULL);
 	KASSERT(curthread->t_curspl == 0);
 	KASSERT(curthread->t_iplhigh_count == 0);
 
 	callno = tf->tf_v0;
+	start = syscallstat_enter(callno);
 
 	/*
 	 * Initialize retval to 0. Many of the system calls don't
@@ -135,13 +140,67 @@ syscall(struct trapframe *tf)
 			case SYS_read:
 		// sys_read(int read_fd, void *buf, size_t buflen)
 		err = sys_read(tf->tf_a0, (userptr_t)tf->tf_a1, tf->tf_a2, &retval);
+		break;
+
+			case SYS_pread:
+		// The 64-bit offset doesn't fit in a3; it's on the stack
+		err = copyin((const_userptr_t)(tf->tf_sp+16), &arg_64, sizeof(arg_64));
+		if (!err) {
+			err = sys_pread(tf->tf_a0, (userptr_t)tf->tf_a1, tf->tf_a2, arg_64, &retval);
+		}
+		break;
+
+			case SYS_pwrite:
+		err = copyin((const_userptr_t)(tf->tf_sp+16), &arg_64, sizeof(arg_64));
+		if (!err) {
+			err = sys_pwrite(tf->tf_a0, (const_userptr_t)tf->tf_a1, tf->tf_a2, arg_64, &retval);
+		}
+		break;
+
+			case SYS_readv:
+		err = sys_readv(tf->tf_a0, (const_userptr_t)tf->tf_a1, tf->tf_a2, &retval);
+		break;
+
+			case SYS_writev:
+		err = sys_writev(tf->tf_a0, (const_userptr_t)tf->tf_a1, tf->tf_a2, &retval);
+		break;
+
+			case SYS_copy_file_range:
+		err = sys_copy_file_range(tf->tf_a0, tf->tf_a1, tf->tf_a2, &retval);
 		break;
 
 			case SYS_lseek:
 		arg_64 = ((int64_t)tf->tf_a2 << 32) | tf->tf_a3;
 		err = sys_lseek(tf->tf_a0, arg_64, (const_userptr_t)tf->tf_sp+16, &ret_64);
-		retval = (ret_64 >> 32) & 0xFFFF;
-		tf->tf_v1 = ret_64 & 0xFFFF;
+		if (!err) {
+			/* 64-bit return: high word in v0, low in v1 */
+			retval = (uint64_t)ret_64 >> 32;
+			tf->tf_v1 = (uint64_t)ret_64 & 0xffffffff;
+		}
+		break;
+
+			case SYS_dup2:
+		err = sys_dup2(tf->tf_a0, tf->tf_a1, &retval);
+		break;
+
+			case SYS_pipe:
+		err = sys_pipe((userptr_t)tf->tf_a0, &retval);
+		break;
+
+			case SYS_fsync:
+		err = sys_fsync(tf->tf_a0);
+		break;
+
+			case SYS_poll:
+		err = sys_poll((userptr_t)tf->tf_a0, tf->tf_a1, tf->tf_a2, &retval);
+		break;
+
+			case SYS_select:
+		// The fifth argument, the timeout pointer, is on the stack
+		err = copyin((const_userptr_t)(tf->tf_sp+16), &arg_ptr, sizeof(arg_ptr));
+		if (!err) {
+			err = sys_select(tf->tf_a0, (userptr_t)tf->tf_a1, (userptr_t)tf->tf_a2, (userptr_t)tf->tf_a3, arg_ptr, &retval);
+		}
 		break;
 
 			case SYS___getcwd:
@@ -160,18 +219,64 @@ syscall(struct trapframe *tf)
 		err = sys_fork(tf, &retval);
 		break;
 
-	//		case SYS_execv:
-	//	err = sys_execv();
-	//	break;
+	    case SYS_futex_wait:
+		err = sys_futex_wait((userptr_t)tf->tf_a0, tf->tf_a1);
+		break;
 
-	//		case SYS_waitpid:
-	//	err = sys_waitpid();
-	//	break;
+	    case SYS_futex_wake:
+		err = sys_futex_wake((userptr_t)tf->tf_a0, tf->tf_a1, &retval);
+		break;
+
+	    case SYS___threadfork:
+		err = sys___threadfork(tf, (userptr_t)tf->tf_a0,
+				       (userptr_t)tf->tf_a1,
+				       (userptr_t)tf->tf_a2, &retval);
+		break;
+
+	    case SYS_threadexit:
+		sys_threadexit(tf->tf_a0);
+		/* NOTREACHED */
+
+	    case SYS_threadjoin:
+		err = sys_threadjoin(tf->tf_a0, (userptr_t)tf->tf_a1);
+		break;
+
+	    case SYS_spawn:
+		err = sys_spawn((const_userptr_t)tf->tf_a0, (userptr_t)tf->tf_a1,
+				(const_userptr_t)tf->tf_a2, tf->tf_a3, &retval);
+		break;
+
+			case SYS_execv:
+		err = sys_execv((const_userptr_t)tf->tf_a0, (userptr_t)tf->tf_a1);
+		break;
 
-	//		case SYS__exit:
-	//	err = sys_exit();
-	//	break;
+			case SYS_waitpid:
+		err = sys_waitpid(tf->tf_a0, (userptr_t)tf->tf_a1, tf->tf_a2,
+				  &retval);
+		break;
+
+			case SYS_wait4:
+		err = sys_wait4(tf->tf_a0, (userptr_t)tf->tf_a1, tf->tf_a2,
+				(userptr_t)tf->tf_a3, &retval);
+		break;
+
+			case SYS_getrusage:
+		err = sys_getrusage(tf->tf_a0, (userptr_t)tf->tf_a1);
+		break;
 
+			case SYS__exit:
+		sys__exit(tf->tf_a0);
+		/* NOTREACHED */
+
+
+	    case SYS_syscallstat:
+		err = sys_syscallstat(tf->tf_a0, tf->tf_a1, (userptr_t)tf->tf_a2);
+		break;
+
+	    case SYS_ring_enter:
+		err = sys_ring_enter((userptr_t)tf->tf_a0, tf->tf_a1, tf->tf_a2,
+				     tf->tf_a3, &retval);
+		break;
 
 	    default:
 		kprintf("Unknown syscall %d\n", callno);
@@ -179,6 +284,7 @@ syscall(struct trapframe *tf)
 		break;
 	}
 
+	syscallstat_exit(callno, err, start);
 
 	if (err) {
 		/*
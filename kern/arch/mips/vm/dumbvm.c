@@ -35,6 +35,7 @@
 #include <spinlock.h>
 #include <proc.h>
 #include <current.h>
+#include <thread.h>
 #include <mips/tlb.h>
 #include <addrspace.h>
 #include <vm.h>
@@ -135,11 +136,30 @@ coremap_used_bytes() {
 	return 0;
 }
 
+/*
+ * Invalidate one page, or everything, in this cpu's TLB. dumbvm only
+ * asks for everything, when an address space used by more than one
+ * thread goes away (see as_decref).
+ */
 void
 vm_tlbshootdown(const struct tlbshootdown *ts)
 {
-	(void)ts;
-	panic("dumbvm tried to do tlb shootdown?!\n");
+	uint32_t ehi, elo;
+	int i, spl;
+
+	spl = splhigh();
+
+	for (i=0; i<NUM_TLB; i++) {
+		if (ts->ts_vaddr != TLBSHOOTDOWN_ALL) {
+			tlb_read(&ehi, &elo, i);
+			if ((ehi & TLBHI_VPAGE) != ts->ts_vaddr) {
+				continue;
+			}
+		}
+		tlb_write(TLBHI_INVALID(i), TLBLO_INVALID(), i);
+	}
+
+	splx(spl);
 }
 
 int
@@ -235,6 +255,8 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 		DEBUG(DB_VM, "dumbvm: 0x%x -> 0x%x\n", faultaddress, paddr);
 		tlb_write(ehi, elo, i);
 		splx(spl);
+		/* Everything is already in memory, so all faults are minor */
+		curthread->t_usage.u_minflt++;
 		return 0;
 	}
 
@@ -251,6 +273,10 @@ as_create(void)
 		return NULL;
 	}
 
+	spinlock_init(&as->as_reflock);
+	as->as_refcount = 1;
+	as->as_shared = false;
+
 	as->as_vbase1 = 0;
 	as->as_pbase1 = 0;
 	as->as_npages1 = 0;
@@ -262,10 +288,55 @@ as_create(void)
 	return as;
 }
 
+void
+as_incref(struct addrspace *as)
+{
+	spinlock_acquire(&as->as_reflock);
+	KASSERT(as->as_refcount > 0);
+	as->as_refcount++;
+	as->as_shared = true;
+	spinlock_release(&as->as_reflock);
+}
+
+void
+as_decref(struct addrspace *as)
+{
+	struct tlbshootdown ts;
+	unsigned refcount;
+	bool shared;
+
+	spinlock_acquire(&as->as_reflock);
+	KASSERT(as->as_refcount > 0);
+	refcount = --as->as_refcount;
+	shared = as->as_shared;
+	spinlock_release(&as->as_reflock);
+
+	if (refcount > 0) {
+		return;
+	}
+
+	if (shared) {
+		/*
+		 * Threads that ran in this address space on other cpus
+		 * may have left its mappings in their TLBs, since
+		 * switching to a kernel-only thread doesn't flush.
+		 * dumbvm never reuses the memory, so nothing waits for
+		 * the other cpus to finish; a real VM system would.
+		 */
+		ts.ts_vaddr = TLBSHOOTDOWN_ALL;
+		vm_tlbshootdown(&ts);
+		ipi_tlbshootdown_broadcast(&ts);
+	}
+
+	as_destroy(as);
+}
+
 void
 as_destroy(struct addrspace *as)
 {
 	dumbvm_can_sleep();
+	KASSERT(as->as_refcount == 0 || !as->as_shared);
+	spinlock_cleanup(&as->as_reflock);
 	kfree(as);
 }
 
@@ -392,6 +463,33 @@ as_define_stack(struct addrspace *as, vaddr_t *stackptr)
 	return 0;
 }
 
+int
+as_translate(struct addrspace *as, vaddr_t vaddr, paddr_t *ret)
+{
+	vaddr_t vbase1, vtop1, vbase2, vtop2, stackbase, stacktop;
+
+	vbase1 = as->as_vbase1;
+	vtop1 = vbase1 + as->as_npages1 * PAGE_SIZE;
+	vbase2 = as->as_vbase2;
+	vtop2 = vbase2 + as->as_npages2 * PAGE_SIZE;
+	stackbase = USERSTACK - DUMBVM_STACKPAGES * PAGE_SIZE;
+	stacktop = USERSTACK;
+
+	if (vaddr >= vbase1 && vaddr < vtop1) {
+		*ret = (vaddr - vbase1) + as->as_pbase1;
+	}
+	else if (vaddr >= vbase2 && vaddr < vtop2) {
+		*ret = (vaddr - vbase2) + as->as_pbase2;
+	}
+	else if (vaddr >= stackbase && vaddr < stacktop) {
+		*ret = (vaddr - stackbase) + as->as_stackpbase;
+	}
+	else {
+		return EFAULT;
+	}
+	return 0;
+}
+
 int
 as_copy(struct addrspace *old, struct addrspace **ret)
 {
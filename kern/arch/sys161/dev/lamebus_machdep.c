@@ -294,6 +294,43 @@ mainbus_debugger(void)
 #define LAMEBUS_IPI_BIT  0x00000800	/* inter-processor interrupt */
 #define MIPS_TIMER_BIT   0x00008000	/* on-chip timer */
 
+/*
+ * Cycle count for the current cpu.
+ *
+ * c0_count is reset to 0 every time it reaches c0_compare, i.e. every
+ * CPU_FREQUENCY/HZ cycles, which is also when hardclock runs; so count
+ * whole ticks with c_hardclocks and add the count register. The timer
+ * may have wrapped without hardclock having run yet (we're at
+ * splhigh, or the interrupt is just pending): read the count on both
+ * sides of the cause register to catch that.
+ */
+uint64_t
+cpu_cycles(void)
+{
+	uint32_t count1, count2, cause;
+	uint64_t ticks;
+	int spl;
+
+	spl = splhigh();
+	ticks = curcpu->c_hardclocks;
+	__asm volatile("mfc0 %0,$9" : "=r" (count1));	/* c0_count */
+	__asm volatile("mfc0 %0,$13" : "=r" (cause));	/* c0_cause */
+	__asm volatile("mfc0 %0,$9" : "=r" (count2));
+	if (count2 < count1 || (cause & MIPS_TIMER_BIT)) {
+		ticks++;
+	}
+	splx(spl);
+
+	return ticks * (CPU_FREQUENCY / HZ) + count2;
+}
+
+void
+cpu_cyclestime(uint64_t cycles, struct timespec *ret)
+{
+	ret->tv_sec = cycles / CPU_FREQUENCY;
+	ret->tv_nsec = (cycles % CPU_FREQUENCY) * (1000000000 / CPU_FREQUENCY);
+}
+
 void
 mainbus_interrupt(struct trapframe *tf)
 {
@@ -49,6 +49,7 @@
 
 #include <types.h>
 #include <kern/errno.h>
+#include <kern/poll.h>
 #include <lib.h>
 #include <uio.h>
 #include <cpu.h>
@@ -174,6 +175,7 @@ con_input(void *vcs, int ch)
 	cs->cs_gotchars_head = nexthead;
 
 	V(cs->cs_rsem);
+	pollq_wakeup(&cs->cs_pollq);
 }
 
 /*
@@ -302,10 +304,38 @@ con_ioctl(struct device *dev, int op, userptr_t data)
 	return EINVAL;
 }
 
+/*
+ * Readable if a character has come in that nobody has taken yet.
+ * Output only waits for the device to finish the previous character,
+ * so it's always writable.
+ *
+ * Hook onto the pollq before looking, so a character arriving in
+ * between still wakes the poller.
+ */
+static
+int
+con_poll(struct device *dev, int events, struct pollset *ps)
+{
+	struct con_softc *cs = dev->d_data;
+	int ready;
+
+	ready = events & POLLOUT;
+	if (events & POLLIN) {
+		if (ps != NULL) {
+			pollq_add(&cs->cs_pollq, ps);
+		}
+		if (cs->cs_gotchars_head != cs->cs_gotchars_tail) {
+			ready |= POLLIN;
+		}
+	}
+	return ready;
+}
+
 static const struct device_ops console_devops = {
 	.devop_eachopen = con_eachopen,
 	.devop_io = con_io,
 	.devop_ioctl = con_ioctl,
+	.devop_poll = con_poll,
 };
 
 static
@@ -386,6 +416,7 @@ config_con(struct con_softc *cs, int unit)
 	cs->cs_wsem = wsem;
 	cs->cs_gotchars_head = 0;
 	cs->cs_gotchars_tail = 0;
+	pollq_init(&cs->cs_pollq);
 
 	the_console = cs;
 	con_userlock_read = rlk;
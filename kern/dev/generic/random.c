@@ -30,6 +30,7 @@
 #include <types.h>
 #include <kern/errno.h>
 #include <kern/fcntl.h>
+#include <kern/poll.h>
 #include <lib.h>
 #include <uio.h>
 #include <vfs.h>
@@ -98,10 +99,23 @@ randioctl(struct device *dev, int op, userptr_t data)
 	return EIOCTL;
 }
 
+/*
+ * VFS poll function. There's always more randomness.
+ */
+static
+int
+randpoll(struct device *dev, int events, struct pollset *ps)
+{
+	(void)dev;
+	(void)ps;
+	return events & POLLIN;
+}
+
 static const struct device_ops random_devops = {
 	.devop_eachopen = randeachopen,
 	.devop_io = randio,
 	.devop_ioctl = randioctl,
+	.devop_poll = randpoll,
 };
 
 /*
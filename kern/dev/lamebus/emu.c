@@ -1087,6 +1087,7 @@ static const struct vnode_ops emufs_fileops = {
 	.vop_gettype = emufs_file_gettype,
 	.vop_isseekable = emufs_isseekable,
 	.vop_fsync = emufs_fsync,
+	.vop_poll = vopready_poll,
 	.vop_mmap = emufs_mmap,
 	.vop_truncate = emufs_truncate,
 	.vop_namefile = emufs_uio_op_notdir,
@@ -1121,6 +1122,7 @@ static const struct vnode_ops emufs_dirops = {
 	.vop_gettype = emufs_dir_gettype,
 	.vop_isseekable = emufs_isseekable,
 	.vop_fsync = emufs_void_op_isdir,
+	.vop_poll = vopready_poll,
 	.vop_mmap = emufs_void_op_isdir,
 	.vop_truncate = emufs_truncate_isdir,
 	.vop_namefile = emufs_namefile,
@@ -30,6 +30,7 @@
 #include <types.h>
 #include <kern/errno.h>
 #include <kern/fcntl.h>
+#include <kern/poll.h>
 #include <stat.h>
 #include <uio.h>
 #include <synch.h>
@@ -151,6 +152,7 @@ semfs_wakeup(struct semfs_sem *sem, unsigned newcount)
 	else {
 		cv_broadcast(sem->sems_cv, sem->sems_lock);
 	}
+	pollq_wakeup(&sem->sems_pollq);
 }
 
 /*
@@ -291,6 +293,34 @@ semfs_truncate(struct vnode *vn, off_t len)
 	return 0;
 }
 
+/*
+ * Poll. A semaphore is readable (P won't block) if the count isn't
+ * zero, and always writable.
+ */
+static
+int
+semfs_poll(struct vnode *vn, int events, struct pollset *ps)
+{
+	struct semfs_vnode *semv = vn->vn_data;
+	struct semfs_sem *sem;
+	int ready;
+
+	sem = semfs_getsem(semv);
+
+	ready = events & POLLOUT;
+	if (events & POLLIN) {
+		lock_acquire(sem->sems_lock);
+		if (ps != NULL) {
+			pollq_add(&sem->sems_pollq, ps);
+		}
+		if (sem->sems_count > 0) {
+			ready |= POLLIN;
+		}
+		lock_release(sem->sems_lock);
+	}
+	return ready;
+}
+
 ////////////////////////////////////////////////////////////
 // directory ops
 
@@ -663,6 +693,7 @@ static const struct vnode_ops semfs_dirops = {
 	.vop_gettype = semfs_gettype,
 	.vop_isseekable = semfs_isseekable,
 	.vop_fsync = semfs_fsync,
+	.vop_poll = vopready_poll,
 	.vop_mmap = vopfail_mmap_isdir,
 	.vop_truncate = vopfail_truncate_isdir,
 	.vop_namefile = semfs_namefile,
@@ -696,6 +727,7 @@ static const struct vnode_ops semfs_semops = {
 	.vop_gettype = semfs_gettype,
 	.vop_isseekable = semfs_isseekable,
 	.vop_fsync = semfs_fsync,
+	.vop_poll = semfs_poll,
 	.vop_mmap = vopfail_mmap_perm,
 	.vop_truncate = semfs_truncate,
 	.vop_namefile = vopfail_uio_notdir,
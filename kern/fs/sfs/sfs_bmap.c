@@ -50,24 +50,29 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
 	 daddr_t *diskblock)
 {
 	/*
-	 * I/O buffer for handling indirect blocks.
+	 * I/O buffer for handling indirect blocks when allocating.
 	 *
 	 * Note: in real life (and when you've done the fs assignment)
 	 * you would get space from the disk buffer cache for this,
 	 * not use a static area.
+	 *
+	 * Lookups without allocation (reads) don't hold the big lock,
+	 * only the vnode's sv_rwlock for reading, so several can be in
+	 * here at once; they use a buffer of their own.
 	 */
-	static uint32_t idbuf[SFS_DBPERIDB];
+	static uint32_t allocidbuf[SFS_DBPERIDB];
 
 	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+	uint32_t *idbuf;
 	daddr_t block;
 	daddr_t idblock;
 	uint32_t idnum, idoff;
 	int result;
 
-	KASSERT(sizeof(idbuf)==SFS_BLOCKSIZE);
+	KASSERT(sizeof(allocidbuf)==SFS_BLOCKSIZE);
 
-	/* Since we're using a static buffer, we'd better be locked. */
-	KASSERT(vfs_biglock_do_i_hold());
+	/* Allocating touches the freemap and the static buffer. */
+	KASSERT(!doalloc || vfs_biglock_do_i_hold());
 
 	/*
 	 * If the block we want is one of the direct blocks...
@@ -136,7 +141,18 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
 		*diskblock = 0;
 		return 0;
 	}
-	else if (idblock==0) {
+
+	if (doalloc) {
+		idbuf = allocidbuf;
+	}
+	else {
+		idbuf = kmalloc(SFS_BLOCKSIZE);
+		if (idbuf == NULL) {
+			return ENOMEM;
+		}
+	}
+
+	if (idblock==0) {
 		/*
 		 * There's no indirect block allocated, but we need to
 		 * allocate a block whose number needs to be stored in
@@ -155,20 +171,26 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
 		sv->sv_dirty = true;
 
 		/* Clear the indirect block buffer */
-		bzero(idbuf, sizeof(idbuf));
+		bzero(idbuf, SFS_BLOCKSIZE);
 	}
 	else {
 		/*
 		 * We already have an indirect block allocated; load it.
 		 */
-		result = sfs_readblock(sfs, idblock, idbuf, sizeof(idbuf));
+		result = sfs_readblock(sfs, idblock, idbuf, SFS_BLOCKSIZE);
 		if (result) {
+			if (idbuf != allocidbuf) {
+				kfree(idbuf);
+			}
 			return result;
 		}
 	}
 
 	/* Get the block out of the indirect block buffer */
 	block = idbuf[idoff];
+	if (idbuf != allocidbuf) {
+		kfree(idbuf);
+	}
 
 	/* If there's no block there, allocate one */
 	if (block==0 && doalloc) {
@@ -181,7 +203,7 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
 		idbuf[idoff] = block;
 
 		/* The indirect block is now dirty; write it back */
-		result = sfs_writeblock(sfs, idblock, idbuf, sizeof(idbuf));
+		result = sfs_writeblock(sfs, idblock, idbuf, SFS_BLOCKSIZE);
 		if (result) {
 			return result;
 		}
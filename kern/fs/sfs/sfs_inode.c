@@ -35,6 +35,7 @@
 #include <types.h>
 #include <kern/errno.h>
 #include <lib.h>
+#include <synch.h>
 #include <vfs.h>
 #include <sfs.h>
 #include "sfsprivate.h"
@@ -132,6 +133,7 @@ sfs_reclaim(struct vnode *v)
 	vnodearray_remove(sfs->sfs_vnodes, ix);
 
 	vnode_cleanup(&sv->sv_absvn);
+	rwlock_destroy(sv->sv_rwlock);
 
 	vfs_biglock_release();
 
@@ -232,9 +234,16 @@ sfs_loadvnode(struct sfs_fs *sfs, uint32_t ino, int forcetype,
 		      ino, sv->sv_i.sfi_type);
 	}
 
+	sv->sv_rwlock = rwlock_create("sfs_vnode");
+	if (sv->sv_rwlock == NULL) {
+		kfree(sv);
+		return ENOMEM;
+	}
+
 	/* Call the common vnode initializer */
 	result = vnode_init(&sv->sv_absvn, ops, &sfs->sfs_absfs, sv);
 	if (result) {
+		rwlock_destroy(sv->sv_rwlock);
 		kfree(sv);
 		return result;
 	}
@@ -246,6 +255,7 @@ sfs_loadvnode(struct sfs_fs *sfs, uint32_t ino, int forcetype,
 	result = vnodearray_add(sfs->sfs_vnodes, &sv->sv_absvn, NULL);
 	if (result) {
 		vnode_cleanup(&sv->sv_absvn);
+		rwlock_destroy(sv->sv_rwlock);
 		kfree(sv);
 		return result;
 	}
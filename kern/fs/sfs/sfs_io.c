@@ -36,6 +36,8 @@
 #include <kern/errno.h>
 #include <lib.h>
 #include <uio.h>
+#include <current.h>
+#include <thread.h>
 #include <vfs.h>
 #include <device.h>
 #include <sfs.h>
@@ -62,7 +64,20 @@ sfs_rwblock(struct sfs_fs *sfs, struct uio *uio)
 	int result;
 	int tries=0;
 
-	KASSERT(vfs_biglock_do_i_hold());
+	/*
+	 * The device takes care of one request at a time by itself.
+	 * Reads of file data come here without the big lock (see
+	 * sfs_read); everything else should have it.
+	 */
+	KASSERT(uio->uio_rw == UIO_READ || vfs_biglock_do_i_hold());
+
+	/* Charge the block to whoever asked for it; retries don't count */
+	if (uio->uio_rw == UIO_READ) {
+		curthread->t_usage.u_inblock++;
+	}
+	else {
+		curthread->t_usage.u_oublock++;
+	}
 
 	DEBUG(DB_SFS, "sfs: %s %llu\n",
 	      uio->uio_rw == UIO_READ ? "read" : "write",
@@ -151,17 +166,21 @@ sfs_partialio(struct sfs_vnode *sv, struct uio *uio,
 	      uint32_t skipstart, uint32_t len)
 {
 	/*
-	 * I/O buffer for handling partial sectors.
+	 * I/O buffer for handling partial sectors when writing.
 	 *
 	 * Note: in real life (and when you've done the fs assignment)
 	 * you would get space from the disk buffer cache for this,
 	 * not use a static area.
+	 *
+	 * Readers don't hold the big lock and may be in here several
+	 * at once, so they get a buffer of their own.
 	 */
-	static char iobuf[SFS_BLOCKSIZE];
+	static char writebuf[SFS_BLOCKSIZE];
 
 	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
 	daddr_t diskblock;
 	uint32_t fileblock;
+	char *iobuf;
 	int result;
 
 	/* Allocate missing blocks if and only if we're writing */
@@ -169,8 +188,17 @@ sfs_partialio(struct sfs_vnode *sv, struct uio *uio,
 
 	KASSERT(skipstart + len <= SFS_BLOCKSIZE);
 
-	/* We're using a global static buffer; it had better be locked */
-	KASSERT(vfs_biglock_do_i_hold());
+	if (doalloc) {
+		/* We're using a global static buffer; it had better be locked */
+		KASSERT(vfs_biglock_do_i_hold());
+		iobuf = writebuf;
+	}
+	else {
+		iobuf = kmalloc(SFS_BLOCKSIZE);
+		if (iobuf == NULL) {
+			return ENOMEM;
+		}
+	}
 
 	/* Compute the block offset of this block in the file */
 	fileblock = uio->uio_offset / SFS_BLOCKSIZE;
@@ -178,7 +206,7 @@ sfs_partialio(struct sfs_vnode *sv, struct uio *uio,
 	/* Get the disk block number */
 	result = sfs_bmap(sv, fileblock, doalloc, &diskblock);
 	if (result) {
-		return result;
+		goto out;
 	}
 
 	if (diskblock == 0) {
@@ -187,15 +215,15 @@ sfs_partialio(struct sfs_vnode *sv, struct uio *uio,
 		 * Zero the buffer.
 		 */
 		KASSERT(uio->uio_rw == UIO_READ);
-		bzero(iobuf, sizeof(iobuf));
+		bzero(iobuf, SFS_BLOCKSIZE);
 	}
 	else {
 		/*
 		 * Read the block.
 		 */
-		result = sfs_readblock(sfs, diskblock, iobuf, sizeof(iobuf));
+		result = sfs_readblock(sfs, diskblock, iobuf, SFS_BLOCKSIZE);
 		if (result) {
-			return result;
+			goto out;
 		}
 	}
 
@@ -204,20 +232,21 @@ sfs_partialio(struct sfs_vnode *sv, struct uio *uio,
 	 */
 	result = uiomove(iobuf+skipstart, len, uio);
 	if (result) {
-		return result;
+		goto out;
 	}
 
 	/*
 	 * If it was a write, write back the modified block.
 	 */
 	if (uio->uio_rw == UIO_WRITE) {
-		result = sfs_writeblock(sfs, diskblock, iobuf, sizeof(iobuf));
-		if (result) {
-			return result;
-		}
+		result = sfs_writeblock(sfs, diskblock, iobuf, SFS_BLOCKSIZE);
 	}
 
-	return 0;
+ out:
+	if (iobuf != writebuf) {
+		kfree(iobuf);
+	}
+	return result;
 }
 
 /*
@@ -38,6 +38,7 @@
 #include <stat.h>
 #include <lib.h>
 #include <uio.h>
+#include <synch.h>
 #include <vfs.h>
 #include <sfs.h>
 #include "sfsprivate.h"
@@ -92,6 +93,13 @@ sfs_eachopendir(struct vnode *v, int openflags)
 
 /*
  * Called for read(). sfs_io() does the work.
+ *
+ * Reads take only the vnode's rwlock, for reading, and not the big
+ * lock, so any number of them can run on a file (or on different
+ * files) at once; they only look at the inode and read blocks, and
+ * each uses its own buffers. Anything that changes a file's size or
+ * block map (write, truncate) holds the rwlock for writing as well as
+ * the big lock. The rwlock comes first.
  */
 static
 int
@@ -102,9 +110,9 @@ sfs_read(struct vnode *v, struct uio *uio)
 
 	KASSERT(uio->uio_rw==UIO_READ);
 
-	vfs_biglock_acquire();
+	rwlock_acquire_read(sv->sv_rwlock);
 	result = sfs_io(sv, uio);
-	vfs_biglock_release();
+	rwlock_release_read(sv->sv_rwlock);
 
 	return result;
 }
@@ -121,9 +129,11 @@ sfs_write(struct vnode *v, struct uio *uio)
 
 	KASSERT(uio->uio_rw==UIO_WRITE);
 
+	rwlock_acquire_write(sv->sv_rwlock);
 	vfs_biglock_acquire();
 	result = sfs_io(sv, uio);
 	vfs_biglock_release();
+	rwlock_release_write(sv->sv_rwlock);
 
 	return result;
 }
@@ -250,8 +260,14 @@ int
 sfs_truncate(struct vnode *v, off_t len)
 {
 	struct sfs_vnode *sv = v->vn_data;
+	int result;
+
+	/* Keep readers out while the block map changes */
+	rwlock_acquire_write(sv->sv_rwlock);
+	result = sfs_itrunc(sv, len);
+	rwlock_release_write(sv->sv_rwlock);
 
-	return sfs_itrunc(sv, len);
+	return result;
 }
 
 /*
@@ -599,6 +615,7 @@ const struct vnode_ops sfs_fileops = {
 	.vop_gettype = sfs_gettype,
 	.vop_isseekable = sfs_isseekable,
 	.vop_fsync = sfs_fsync,
+	.vop_poll = vopready_poll,
 	.vop_mmap = sfs_mmap,
 	.vop_truncate = sfs_truncate,
 	.vop_namefile = vopfail_uio_notdir,
@@ -633,6 +650,7 @@ const struct vnode_ops sfs_dirops = {
 	.vop_gettype = sfs_gettype,
 	.vop_isseekable = sfs_isseekable,
 	.vop_fsync = sfs_fsync,
+	.vop_poll = vopready_poll,
 	.vop_mmap = vopfail_mmap_isdir,
 	.vop_truncate = vopfail_truncate_isdir,
 	.vop_namefile = sfs_namefile,
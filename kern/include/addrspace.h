@@ -36,6 +36,7 @@
 
 
 #include <vm.h>
+#include <spinlock.h>
 #include "opt-dumbvm.h"
 
 struct vnode;
@@ -49,6 +50,9 @@ struct vnode;
  */
 
 struct addrspace {
+        struct spinlock as_reflock;     /* Protects as_refcount */
+        unsigned as_refcount;           /* See as_incref */
+        bool as_shared;                 /* Has had more than one user */
 #if OPT_DUMBVM
         vaddr_t as_vbase1;
         paddr_t as_pbase1;
@@ -83,8 +87,18 @@ struct addrspace {
  *                avoid potentially "seeing" it while it's being
  *                destroyed.
  *
- *    as_destroy - dispose of an address space. You may need to change
- *                the way this works if implementing user-level threads.
+ *    as_incref - take a reference to an address space. as_create and
+ *                as_copy return one with a single reference, which
+ *                normally becomes the process's; each user-level
+ *                thread holds another.
+ *
+ *    as_decref - drop a reference. The last one calls as_destroy. If
+ *                the address space was ever used by more than one
+ *                thread, its mappings may be in other cpus' TLBs,
+ *                so they are shot down first.
+ *
+ *    as_destroy - dispose of an address space. Use as_decref instead
+ *                unless nothing else has ever seen it.
  *
  *    as_define_region - set up a region of memory within the address
  *                space.
@@ -99,6 +113,12 @@ struct addrspace {
  *                (Normally called *after* as_complete_load().) Hands
  *                back the initial stack pointer for the new process.
  *
+ *    as_translate - find the physical address currently behind user
+ *                address VADDR. Fails with EFAULT if it isn't mapped.
+ *                The answer can go stale if the VM system moves pages
+ *                around; callers use it as an identity, not to access
+ *                memory.
+ *
  * Note that when using dumbvm, addrspace.c is not used and these
  * functions are found in dumbvm.c.
  */
@@ -107,6 +127,8 @@ struct addrspace *as_create(void);
 int               as_copy(struct addrspace *src, struct addrspace **ret);
 void              as_activate(void);
 void              as_deactivate(void);
+void              as_incref(struct addrspace *);
+void              as_decref(struct addrspace *);
 void              as_destroy(struct addrspace *);
 
 int               as_define_region(struct addrspace *as,
@@ -117,6 +139,8 @@ int               as_define_region(struct addrspace *as,
 int               as_prepare_load(struct addrspace *as);
 int               as_complete_load(struct addrspace *as);
 int               as_define_stack(struct addrspace *as, vaddr_t *initstackptr);
+int               as_translate(struct addrspace *as, vaddr_t vaddr,
+                               paddr_t *ret);
 
 
 /*
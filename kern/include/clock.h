@@ -59,6 +59,19 @@ void timerclock(void);
  */
 void gettime(struct timespec *ret);
 
+/*
+ * cpu_cycles() returns a count of cpu cycles on the current cpu, for
+ * timing short intervals. Each cpu has its own count, so values from
+ * different cpus are only roughly comparable. Machine-dependent.
+ */
+uint64_t cpu_cycles(void);
+
+/*
+ * cpu_cyclestime() converts a number of cpu cycles to the time they
+ * take. Machine-dependent.
+ */
+void cpu_cyclestime(uint64_t cycles, struct timespec *ret);
+
 /*
  * arithmetic on times
  *
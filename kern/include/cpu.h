@@ -35,6 +35,8 @@
 #include <threadlist.h>
 #include <machine/vm.h>  /* for TLBSHOOTDOWN_MAX */
 
+struct workqueue;	/* from <workqueue.h> */
+
 extern unsigned num_cpus;
 
 /*
@@ -60,8 +62,11 @@ struct cpu {
 	 */
 	struct thread *c_curthread;	/* Current thread on cpu */
 	struct threadlist c_zombies;	/* List of exited threads */
+	struct threadlist c_threadpool;	/* Recycled threads with stacks */
 	unsigned c_hardclocks;		/* Counter of hardclock() calls */
 	unsigned c_spinlocks;		/* Counter of spinlocks held */
+	struct workqueue *c_workqueue;	/* Deferred work (workqueue.h) */
+	LOCKDEP_ACTOR(c_lockdep);	/* Spinlocks held, for lockdep */
 
 	/*
 	 * Accessed by other cpus.
@@ -156,6 +161,8 @@ void cpu_halt(void);
  * ipi_send sends an IPI to one CPU.
  * ipi_broadcast sends an IPI to all CPUs except the current one.
  * ipi_tlbshootdown is like ipi_send but carries TLB shootdown data.
+ * ipi_tlbshootdown_broadcast sends a shootdown to all CPUs except the
+ * current one.
  *
  * interprocessor_interrupt is called on the target CPU when an IPI is
  * received.
@@ -170,6 +177,7 @@ void cpu_halt(void);
 void ipi_send(struct cpu *target, int code);
 void ipi_broadcast(int code);
 void ipi_tlbshootdown(struct cpu *target, const struct tlbshootdown *mapping);
+void ipi_tlbshootdown_broadcast(const struct tlbshootdown *mapping);
 
 void interprocessor_interrupt(void);
 
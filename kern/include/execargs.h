@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _EXECARGS_H_
+#define _EXECARGS_H_
+
+/*
+ * Program arguments on their way from one address space to another,
+ * for execv and spawn.
+ *
+ * The strings are copied in one pass, packed end to end into whole
+ * pages, and copied out a page at a time, already laid out the way
+ * the new program's stack wants them. Alongside them is the argv
+ * array, also in pages, holding the offset of each string until
+ * copyout turns those into user addresses. The pages come from a
+ * small pool kept in execargs.c, so there's no kmalloc per string,
+ * and (under dumbvm, which never frees pages) no leak per exec.
+ *
+ *    execargs_copyin   - copy the NULL-terminated argv array at UARGV,
+ *                        and the strings it points to, into the kernel.
+ *                        Fails with E2BIG if they take more than
+ *                        ARG_MAX bytes in all, counting the pointers.
+ *    execargs_copyout  - lay the arguments out at the top of the
+ *                        current address space's stack, which starts
+ *                        at *STACKPTR: argv, then the strings. Moves
+ *                        *STACKPTR down past them and returns the user
+ *                        address of argv in *UARGV. Only call it once.
+ *    execargs_cleanup  - give the pages back.
+ *
+ * cleanup may be called after copyin fails.
+ */
+
+#include <limits.h>
+#include <vm.h>
+
+/* Pages ARG_MAX bytes can need. */
+#define EA_MAXPAGES (ARG_MAX / PAGE_SIZE + 1)
+
+struct execargs {
+	int ea_argc;
+	size_t ea_strsize;			/* Bytes of strings, NULs too */
+	unsigned ea_nstrpages;
+	unsigned ea_nptrpages;
+	vaddr_t ea_strpages[EA_MAXPAGES];	/* The strings, end to end */
+	vaddr_t ea_ptrpages[EA_MAXPAGES];	/* argv, as offsets */
+};
+
+int execargs_copyin(struct execargs *ea, userptr_t uargv);
+int execargs_copyout(struct execargs *ea, vaddr_t *stackptr, userptr_t *uargv);
+void execargs_cleanup(struct execargs *ea);
+
+#endif /* _EXECARGS_H_ */
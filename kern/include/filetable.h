@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _FILETABLE_H_
+#define _FILETABLE_H_
+
+/*
+ * Per-process file descriptor table.
+ *
+ * The table starts out empty and grows (by doubling, up to OPEN_MAX
+ * slots) when a descriptor past the end is needed. Slots in use are
+ * marked in a bitmap, so finding the lowest free descriptor looks at
+ * one word per 32 descriptors, and usually only the first word not
+ * known to be full.
+ *
+ * The table holds one reference to each open file in it (see
+ * fdesc_incref/fdesc_decref).
+ *
+ * Functions:
+ *    filetable_create  - make an empty table. Returns NULL on error.
+ *    filetable_destroy - drop every file still in the table and free it.
+ *    filetable_copy    - fill the empty table DST with the files in SRC,
+ *                        at the same descriptors, taking a reference to
+ *                        each. (For fork.)
+ *    filetable_get     - look up descriptor FD. Returns EBADF if there's
+ *                        nothing there; otherwise a reference to the
+ *                        file that the caller must drop.
+ *    filetable_place   - put FILE at the lowest free descriptor and
+ *                        return it in *FD. Fails with EMFILE.
+ *    filetable_placeat - put FILE at descriptor FD. Whatever was there
+ *                        before is handed back in *OLDFILE (or NULL) for
+ *                        the caller to drop. Fails with EBADF if FD is
+ *                        out of range.
+ *    filetable_remove  - empty descriptor FD and hand back what was
+ *                        there. Fails with EBADF.
+ *
+ * place and placeat take over the caller's reference to FILE, but
+ * only if they succeed.
+ *
+ * The table is locked unless the current process has only one
+ * thread, in which case nothing else can be using it. So a table
+ * must belong to curproc, or be one nothing else can see yet (like
+ * the child's table in fork) or any more (in proc_destroy).
+ */
+
+struct fdesc;		/* from <kern/fdesc.h> */
+struct lock;		/* from <synch.h> */
+
+struct filetable {
+	struct lock *ft_lock;		/* Taken if multithreaded */
+	unsigned ft_size;		/* Number of slots; multiple of 32 */
+	unsigned ft_lowfree;		/* No free slots below this */
+	struct fdesc **ft_files;	/* Open files, by descriptor */
+	uint32_t *ft_inuse;		/* Bitmap of slots in use */
+};
+
+struct filetable *filetable_create(void);
+void filetable_destroy(struct filetable *ft);
+int filetable_copy(struct filetable *src, struct filetable *dst);
+int filetable_get(struct filetable *ft, int fd, struct fdesc **ret);
+int filetable_place(struct filetable *ft, struct fdesc *file, int *fd);
+int filetable_placeat(struct filetable *ft, struct fdesc *file, int fd,
+		      struct fdesc **oldfile);
+int filetable_remove(struct filetable *ft, int fd, struct fdesc **ret);
+
+#endif /* _FILETABLE_H_ */
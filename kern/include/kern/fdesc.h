@@ -1,23 +1,58 @@
 /*
  * File description structs
- * File table will be an array of MAX_SIZE file descriptions within struct thread
+ * The file table (see filetable.h) holds pointers to these.
  *
+ * An fdesc is one open of a file: the vnode, the open flags and the
+ * seek position. It is shared by every descriptor (and every file
+ * table) it has been copied into by dup2 or fork, so they all see
+ * the same offset, as POSIX wants; refnum counts them. fdesc_create
+ * gives the caller the first reference, fdesc_incref takes another,
+ * and fdesc_decref drops one, closing the file when the last one goes.
  *
+ * The offset and refnum are protected by a spinlock, not a sleep
+ * lock, so read and write never sleep to get at them. (MIPS32 has no
+ * 64-bit load-linked/store-conditional, so a 64-bit off_t can't be
+ * updated with a plain atomic op.) The I/O itself is done without the
+ * lock: fdesc_advance hands each reader or writer its own range of
+ * the file up front, so concurrent transfers through the same fdesc
+ * don't overlap, and fdesc_retreat gives back what a short transfer
+ * didn't use, if nobody has moved on past it.
  *
+ * Files that can't seek (the console) have no offset; advance and
+ * retreat don't touch it.
  */
+#ifndef _KERN_FDESC_H_
+#define _KERN_FDESC_H_
+
 #include <types.h>
-#include <vnode.h>
-#include <synch.h>
+#include <spinlock.h>
+
+struct vnode;
 
 struct fdesc {
 	char *name;
 	int openflags;
-	off_t ofst;
-	int refnum;
+	bool seekable;
 	struct vnode *vn;
-	struct lock *lk;
+	struct spinlock lock;	/* protects ofst and refnum */
+	off_t ofst;
+	unsigned refnum;
 };
 
-int fdesc_init(struct fdesc *, char *, struct vnode *, int);
+/* Takes over the caller's reference to VN. Returns NULL on error. */
+struct fdesc *fdesc_create(const char *, struct vnode *, int);
+
+void fdesc_incref(struct fdesc *);
+
+void fdesc_decref(struct fdesc *);
+
+/* Claim LEN bytes at the current offset; returns where they start. */
+off_t fdesc_advance(struct fdesc *, size_t);
+
+/* Of LEN bytes claimed at POS, only DONE were transferred. */
+void fdesc_retreat(struct fdesc *, off_t, size_t, size_t);
+
+/* lseek; EOF is the file size, for SEEK_END. */
+int fdesc_seek(struct fdesc *, off_t, int, off_t, off_t *);
 
-void fdesc_destroy(struct fdesc *);
+#endif /* _KERN_FDESC_H_ */
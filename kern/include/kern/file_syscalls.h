@@ -10,7 +10,21 @@ ssize_t sys_read(int, userptr_t, size_t, int *);
 
 ssize_t sys_write(int, const_userptr_t, size_t, int *);
 
-int sys_dup2(int, int);
+ssize_t sys_pread(int, userptr_t, size_t, off_t, int *);
+
+ssize_t sys_pwrite(int, const_userptr_t, size_t, off_t, int *);
+
+ssize_t sys_readv(int, const_userptr_t, int, int *);
+
+ssize_t sys_writev(int, const_userptr_t, int, int *);
+
+ssize_t sys_copy_file_range(int, int, size_t, int *);
+
+int sys_dup2(int, int, int *);
+
+int sys_pipe(userptr_t, int *);
+
+int sys_fsync(int);
 
 int sys_lseek(int, off_t, const_userptr_t, off_t *);
 
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _KERN_POLL_H_
+#define _KERN_POLL_H_
+
+/*
+ * Definitions for poll() and select().
+ *
+ * poll() takes an array of struct pollfd. For each one it reports in
+ * revents which of the conditions asked about in events hold, plus
+ * POLLERR, POLLHUP, and POLLNVAL, which are always reported and
+ * needn't be asked for. It returns the number of entries with any
+ * revents, waiting up to the timeout (in milliseconds; INFTIM for no
+ * limit, 0 for not at all) until there's at least one.
+ *
+ * select() does the same for descriptors given as bitmaps (fd_set),
+ * with the timeout as a struct timeval; a descriptor set in the read
+ * set is checked for POLLIN, and in the write set for POLLOUT.
+ * Nothing is ever reported in the exception set.
+ *
+ * Regular files are always ready. The console is readable when a
+ * character has been typed; a read of one byte will then not block.
+ */
+
+#include <kern/limits.h>
+
+#define POLLIN		0x0001	/* Can read without blocking */
+#define POLLPRI		0x0002	/* Urgent data (never happens) */
+#define POLLOUT		0x0004	/* Can write without blocking */
+#define POLLERR		0x0008	/* Error condition */
+#define POLLHUP		0x0010	/* Hung up (the other end is gone) */
+#define POLLNVAL	0x0020	/* Not an open descriptor */
+
+#define POLLRDNORM	POLLIN
+#define POLLWRNORM	POLLOUT
+
+/* Timeout for waiting forever. */
+#define INFTIM		(-1)
+
+struct pollfd {
+	int fd;				/* Descriptor; ignored if negative */
+	short events;			/* Conditions asked about */
+	short revents;			/* Conditions found */
+};
+
+/*
+ * Descriptor sets for select(), one bit per descriptor.
+ */
+#define __FD_SETSIZE	__OPEN_MAX
+#define __NFDBITS	32
+
+struct __fd_set {
+	__u32 fds_bits[(__FD_SETSIZE + __NFDBITS - 1) / __NFDBITS];
+};
+
+#endif /* _KERN_POLL_H_ */
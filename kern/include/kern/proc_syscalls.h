@@ -7,8 +7,12 @@ pid_t sys_getpid(void);
 
 pid_t sys_fork(struct trapframe *, int *);
 
-int sys_execv(const_userptr_t, userptr_t *);
+int sys_execv(const_userptr_t, userptr_t);
 
-pid_t sys_waitpid(pid_t, userptr_t, int);
+int sys_waitpid(pid_t, userptr_t, int, int *);
 
-void sys_exit(int);
+int sys_wait4(pid_t, userptr_t, int, userptr_t, int *);
+
+int sys_getrusage(int, userptr_t);
+
+__DEAD void sys__exit(int);
@@ -30,6 +30,8 @@
 #ifndef _KERN_RESOURCE_H_
 #define _KERN_RESOURCE_H_
 
+#include <kern/time.h>	/* for struct timeval */
+
 /*
  * Definitions for resource usage and limits.
  *
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _KERN_RING_H_
+#define _KERN_RING_H_
+
+/*
+ * Submission and completion rings for ring_enter().
+ *
+ * A program puts requests (struct ring_sqe) in the submission queue
+ * and advances r_sqtail; ring_enter takes them from r_sqhead on,
+ * advancing it, and each one gets a completion (struct ring_cqe) at
+ * r_cqtail in the completion queue, which the program reaps from
+ * r_cqhead on. Both queues have r_entries slots, a power of two;
+ * heads and tails count up forever and are used modulo r_entries.
+ * The kernel only ever writes r_sqhead, r_cqtail, and the completion
+ * queue; the program owns the rest.
+ *
+ * The rings are in the program's own memory, so filling them and
+ * reaping them takes no system calls; one ring_enter can then carry
+ * a whole batch of I/O.
+ *
+ * ring_enter never takes more requests than there are completion
+ * slots free for, counting ones still in progress, so the completion
+ * queue can't overflow; reap completions to make room.
+ */
+
+#define RING_OP_NOP    0	/* Nothing; completes with 0 */
+#define RING_OP_READ   1	/* read, or pread if sqe_off isn't -1 */
+#define RING_OP_WRITE  2	/* write, or pwrite if sqe_off isn't -1 */
+#define RING_OP_OPEN   3	/* open(sqe_buf, sqe_flags); gives the fd */
+#define RING_OP_CLOSE  4	/* close(sqe_fd) */
+#define RING_OP_FSYNC  5	/* fsync(sqe_fd) */
+
+/* Flags for ring_enter. */
+#define RING_ENTER_ASYNC  1	/* Return without waiting for the I/O */
+
+/* Largest r_entries. */
+#define RING_MAXENTRIES  256
+
+struct ring_sqe {
+	int sqe_op;			/* RING_OP_* */
+	int sqe_fd;			/* READ, WRITE, CLOSE, FSYNC */
+	off_t sqe_off;			/* READ, WRITE: position, or -1 */
+#ifdef _KERNEL
+	userptr_t sqe_buf;		/* READ, WRITE: data; OPEN: path */
+#else
+	void *sqe_buf;			/* READ, WRITE: data; OPEN: path */
+#endif
+	size_t sqe_len;			/* READ, WRITE */
+	int sqe_flags;			/* OPEN */
+	unsigned sqe_data;		/* Copied to the completion */
+};
+
+struct ring_cqe {
+	unsigned cqe_data;		/* sqe_data of the request */
+	int cqe_res;			/* Result if >= 0, else -errno */
+};
+
+struct ring {
+	unsigned r_entries;		/* Slots in each queue */
+	unsigned r_sqhead;		/* Next request to take (kernel) */
+	unsigned r_sqtail;		/* Next free request slot */
+	unsigned r_cqhead;		/* Next completion to reap */
+	unsigned r_cqtail;		/* Next free completion slot (kernel) */
+#ifdef _KERNEL
+	userptr_t r_sq;			/* Submission queue */
+	userptr_t r_cq;			/* Completion queue */
+#else
+	struct ring_sqe *r_sq;		/* Submission queue */
+	struct ring_cqe *r_cq;		/* Completion queue */
+#endif
+};
+
+#endif /* _KERN_RING_H_ */
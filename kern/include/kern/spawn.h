@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _KERN_SPAWN_H_
+#define _KERN_SPAWN_H_
+
+/*
+ * File actions for spawn(), applied in order to the child's copy of
+ * the parent's descriptors before the new program starts. This is the
+ * part of posix_spawn's file actions a shell needs for redirection.
+ *
+ *    SPAWN_OPEN  - open sa_path with sa_flags (and sa_mode) at sa_fd,
+ *                  closing whatever was there.
+ *    SPAWN_DUP2  - make sa_newfd a copy of sa_fd, as
+ *                  dup2(sa_fd, sa_newfd).
+ *    SPAWN_CLOSE - close sa_fd.
+ */
+
+#define SPAWN_OPEN   1
+#define SPAWN_DUP2   2
+#define SPAWN_CLOSE  3
+
+/* Most file actions one spawn can take. */
+#define SPAWN_MAXACTIONS 16
+
+struct spawn_action {
+	int sa_op;			/* SPAWN_OPEN etc. */
+	int sa_fd;			/* Descriptor acted on */
+	int sa_newfd;			/* For SPAWN_DUP2 */
+	int sa_flags;			/* For SPAWN_OPEN */
+	int sa_mode;			/* For SPAWN_OPEN */
+#ifdef _KERNEL
+	const_userptr_t sa_path;	/* For SPAWN_OPEN */
+#else
+	const char *sa_path;		/* For SPAWN_OPEN */
+#endif
+};
+
+#endif /* _KERN_SPAWN_H_ */
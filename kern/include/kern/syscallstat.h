@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _KERN_SYSCALLSTAT_H_
+#define _KERN_SYSCALLSTAT_H_
+
+/*
+ * System call statistics, as returned by syscallstat().
+ *
+ * For each system call number the kernel counts calls, calls that
+ * failed, and a histogram of how long the calls that returned took,
+ * in cpu cycles: ss_lat[i] counts calls that took at least 2^i and
+ * less than 2^(i+1) cycles (ss_lat[0] also has those that took 0),
+ * and the last bucket has everything longer. Calls are counted on the
+ * way in, so a call that doesn't return (_exit, a successful execv)
+ * is in ss_calls but not in the histogram.
+ *
+ * The counts are kept per cpu; pass SYSCALLSTAT_ALLCPUS to get the
+ * sum over all of them.
+ */
+
+/* Calls numbered at or above this aren't counted. */
+#define SYSCALLSTAT_NCALLS	160
+
+#define SYSCALLSTAT_NBUCKETS	32
+
+#define SYSCALLSTAT_ALLCPUS	(-1)
+
+struct syscallstat {
+	__u64 ss_calls;				/* Calls made */
+	__u64 ss_errors;			/* Calls that failed */
+	__u32 ss_lat[SYSCALLSTAT_NBUCKETS];	/* Latency, log2 cycles */
+};
+
+#endif /* _KERN_SYSCALLSTAT_H_ */
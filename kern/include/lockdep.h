@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _LOCKDEP_H_
+#define _LOCKDEP_H_
+
+/*
+ * Lock order validator. Enable with "options lockdep" in the kernel
+ * config.
+ *
+ * Locks are grouped into classes by name: all the locks called
+ * "fdesc" are one class. Every time a lock is acquired, each lock the
+ * acquirer already holds gives an ordering edge from its class to the
+ * new one. The first time a given edge is seen, the validator checks
+ * that the reverse order isn't already known (directly or through
+ * other classes); if it is, the two orders could deadlock, and we
+ * panic with the offending chain even though no deadlock happened.
+ *
+ * Learned edges are kept in a hash table that is read without
+ * locking, so once the kernel's lock orders have been seen an
+ * acquire costs one hash lookup per lock already held. Only new edges
+ * take the global lock. That keeps the overhead low enough to leave
+ * on under load, unlike hangman, which takes a global lock on every
+ * acquire but in exchange catches deadlocks among same-named locks.
+ *
+ * Spinlocks are tracked per cpu and sleep locks per thread; the two
+ * are separate domains. Edges between locks of the same class are
+ * ignored, since they can't be told apart by name. Spinlocks are all
+ * one class ("spinlock") unless named with spinlock_setname.
+ */
+
+#include "opt-lockdep.h"
+
+#if OPT_LOCKDEP
+
+/* Most locks one actor (thread or cpu) can hold at once. */
+#define LOCKDEP_MAXHELD 16
+
+struct lockdep_class;		/* Opaque */
+
+struct lockdep_actor {
+	struct lockdep_class *a_held[LOCKDEP_MAXHELD];
+	unsigned a_nheld;
+};
+
+struct lockdep_lockable {
+	const char *l_name;
+	struct lockdep_class *l_class;	/* Looked up on first use */
+};
+
+void lockdep_acquire(struct lockdep_actor *a, struct lockdep_lockable *l);
+void lockdep_release(struct lockdep_actor *a, struct lockdep_lockable *l);
+
+#define LOCKDEP_ACTOR(sym)	struct lockdep_actor sym
+#define LOCKDEP_LOCKABLE(sym)	struct lockdep_lockable sym
+
+#define LOCKDEP_ACTORINIT(a)	    ((a)->a_nheld = 0)
+#define LOCKDEP_LOCKABLEINIT(l, n)  ((l)->l_name = (n), (l)->l_class = NULL)
+#define LOCKDEP_SETNAME(l, n)	    LOCKDEP_LOCKABLEINIT(l, n)
+
+/* Note the trailing comma; this goes in the middle of SPINLOCK_INITIALIZER. */
+#define LOCKDEP_LOCKABLE_INITIALIZER(name)	{ name, NULL },
+
+#define LOCKDEP_ACQUIRE(a, l)	lockdep_acquire(a, l)
+#define LOCKDEP_RELEASE(a, l)	lockdep_release(a, l)
+
+#else
+
+#define LOCKDEP_ACTOR(sym)
+#define LOCKDEP_LOCKABLE(sym)
+
+#define LOCKDEP_ACTORINIT(a)
+#define LOCKDEP_LOCKABLEINIT(l, n)
+#define LOCKDEP_SETNAME(l, n)
+
+#define LOCKDEP_LOCKABLE_INITIALIZER(name)
+
+#define LOCKDEP_ACQUIRE(a, l)
+#define LOCKDEP_RELEASE(a, l)
+
+#endif
+
+#endif /* _LOCKDEP_H_ */
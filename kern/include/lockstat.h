@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _LOCKSTAT_H_
+#define _LOCKSTAT_H_
+
+/*
+ * Lock contention statistics. Enable with "options lockstat" in the
+ * kernel config.
+ *
+ * Each spinlock, lock, CV, and rwlock carries a lockstat record that
+ * counts acquisitions, how many of those had to wait, the total time
+ * spent waiting, and the longest time the lock was held. Times are in
+ * cpu cycles (see cpu_cycles() in clock.h).
+ *
+ * The record is updated only while the lock it describes is held, so
+ * it needs no locking of its own. Records join the global list (for
+ * lockstat_dump) the first time their lock is acquired, so statically
+ * initialized spinlocks work too; a record leaves the list when its
+ * lock is cleaned up, and its counts go with it. Initializing a lock
+ * again without cleaning it up also takes its record off the list,
+ * but memory holding a lock mustn't be freed or reused without the
+ * cleanup.
+ *
+ * What counts as what:
+ *    spinlock - acquisitions; contended if the ticket wasn't up.
+ *    lock     - acquisitions; contended if it had to spin or sleep.
+ *    cv       - each cv_wait is an acquisition and is contended; the
+ *               wait time is the time spent asleep. No hold time.
+ *    rwlock   - write acquisitions and reads that had to take the
+ *               slow path. Fast-path reads are not counted, since
+ *               counting them would put back the shared write the
+ *               per-cpu reader counts exist to avoid. Hold time is
+ *               for writers only.
+ */
+
+#include "opt-lockstat.h"
+
+#if OPT_LOCKSTAT
+
+#include <clock.h>	/* for cpu_cycles */
+
+struct lockstat {
+	const char *ls_kind;		/* "spinlock", "lock", etc. */
+	const char *ls_name;		/* Name of the lock */
+	struct lockstat *ls_prev;	/* Links on global list */
+	struct lockstat *ls_next;
+	bool ls_registered;		/* On the global list */
+	uint64_t ls_acquires;		/* Acquisitions */
+	uint64_t ls_contended;		/* Acquisitions that had to wait */
+	uint64_t ls_waitcycles;		/* Total cycles spent waiting */
+	uint64_t ls_maxhold;		/* Longest hold, in cycles */
+	uint64_t ls_holdstart;		/* When the current holder got it */
+};
+
+void lockstat_init(struct lockstat *ls, const char *kind, const char *name);
+void lockstat_cleanup(struct lockstat *ls);
+void lockstat_acquired(struct lockstat *ls, uint64_t waitstart);
+void lockstat_released(struct lockstat *ls);
+void lockstat_dump(unsigned max);
+
+#define LOCKSTAT(sym)		struct lockstat sym
+
+/* Note the trailing comma; this goes in the middle of SPINLOCK_INITIALIZER. */
+#define LOCKSTAT_INITIALIZER(name)	{ "spinlock", name, NULL, NULL, \
+					  false, 0, 0, 0, 0, 0 },
+
+#define LOCKSTAT_INIT(ls, kind, name)	lockstat_init(ls, kind, name)
+#define LOCKSTAT_SETNAME(ls, name)	((ls)->ls_name = (name))
+#define LOCKSTAT_CLEANUP(ls)		lockstat_cleanup(ls)
+
+/*
+ * Waiting is timed with a local variable declared with
+ * LOCKSTAT_WAITVAR. It stays 0 unless LOCKSTAT_STARTWAIT is reached,
+ * which is how lockstat_acquired tells contended acquisitions apart.
+ */
+#define LOCKSTAT_WAITVAR(var)		uint64_t var = 0
+#define LOCKSTAT_STARTWAIT(var)		((var) = (var) ? (var) : cpu_cycles())
+#define LOCKSTAT_ACQUIRED(ls, var)	lockstat_acquired(ls, var)
+#define LOCKSTAT_RELEASED(ls)		lockstat_released(ls)
+
+#else
+
+#define LOCKSTAT(sym)
+#define LOCKSTAT_INITIALIZER(name)
+
+#define LOCKSTAT_INIT(ls, kind, name)
+#define LOCKSTAT_SETNAME(ls, name)
+#define LOCKSTAT_CLEANUP(ls)
+
+#define LOCKSTAT_WAITVAR(var)
+#define LOCKSTAT_STARTWAIT(var)
+#define LOCKSTAT_ACQUIRED(ls, var)
+#define LOCKSTAT_RELEASED(ls)
+
+#endif
+
+#endif /* _LOCKSTAT_H_ */
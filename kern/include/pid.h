@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _PID_H_
+#define _PID_H_
+
+/*
+ * Process ids.
+ *
+ *    pid_alloc  - give PROC a pid and enter it in the pid table, as a
+ *                 child of PARENT (NULL if nobody will wait for it).
+ *                 Fails with ENPROC if all PID_MAX - PID_MIN + 1 are
+ *                 in use.
+ *    pid_free   - take PROC out of the pid table and release its pid.
+ *                 For a process that never ran.
+ *    pid_exit   - PROC has exited with STATUS. Leaves the status for
+ *                 the parent and wakes it if it's waiting, or releases
+ *                 the pid at once if there's no parent. PROC's own
+ *                 children lose their parent. After this PROC has no
+ *                 pid and can be destroyed.
+ *    pid_wait   - collect the status of an exited child of the current
+ *                 process: child PID, or any child if PID is WAIT_ANY.
+ *                 Sleeps until there is one unless OPTIONS has
+ *                 WNOHANG, in which case *RET is 0 if there's none
+ *                 yet. Fails with ESRCH if there's no such pid and
+ *                 ECHILD if it isn't our child (or we have none).
+ *                 The child's resource usage is added to ours for
+ *                 its children, and handed back in *USAGE unless
+ *                 that's NULL.
+ *    pid_lookup - find the process with pid PID, or NULL. Nothing
+ *                 stops the process going away afterwards; callers
+ *                 need their own arrangement for that.
+ *
+ * Pids are handed out in increasing order, wrapping around at PID_MAX,
+ * so a pid that was just freed isn't used again until the rest of the
+ * pid space has gone by. That keeps a stale pid held by user code from
+ * quickly coming to mean some unrelated new process.
+ *
+ * A pid stays in use from pid_alloc until its status is collected,
+ * but only a small record of it does; the process itself is freed
+ * when it exits.
+ *
+ * The kernel process has pid 0 and isn't in the table.
+ */
+
+struct proc;
+struct usage;
+
+void pid_bootstrap(void);
+int pid_alloc(struct proc *proc, struct proc *parent);
+void pid_free(struct proc *proc);
+void pid_exit(struct proc *proc, int status);
+int pid_wait(pid_t pid, int options, int *status, struct usage *usage,
+	     pid_t *ret);
+struct proc *pid_lookup(pid_t pid);
+
+#endif /* _PID_H_ */
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _POLL_H_
+#define _POLL_H_
+
+/*
+ * Kernel side of poll() and select().
+ *
+ * Anything a thread can block on while reading or writing (a device,
+ * a pipe, a semaphore) keeps a pollq, which is where pollers wait for
+ * it to change. A poller has a pollset. It asks each object it's
+ * interested in for its state with VOP_POLL, passing the pollset;
+ * the object hooks the pollset onto its pollq (pollq_add) *before*
+ * looking at its state, so a change that happens after the look
+ * can't be missed. If nothing is ready the poller sleeps in
+ * pollset_wait until some object it's hooked onto calls pollq_wakeup,
+ * then looks again, this time passing NULL since it's already hooked.
+ *
+ * pollq_wakeup only takes spinlocks, so it can be called from an
+ * interrupt handler.
+ *
+ *    pollq_init      - initialize an empty pollq.
+ *    pollq_cleanup   - clean up a pollq. Nothing may be hooked onto
+ *                      it, which holds as long as the object it
+ *                      belongs to can't go away while being polled.
+ *    pollq_add       - hook PS onto PQ. Allocates; on failure the
+ *                      error is left in PS and reported by
+ *                      pollset_error.
+ *    pollq_wakeup    - wake everything hooked onto PQ.
+ *
+ *    pollset_init    - initialize a pollset. May fail with ENOMEM.
+ *    pollset_cleanup - unhook PS from everything and clean it up.
+ *    pollset_error   - the first error from pollq_add, or 0.
+ *    pollset_timeout - make pollset_wait return after TICKS
+ *                      hardclocks from now even if nothing happens.
+ *    pollset_wait    - sleep until a pollq PS is hooked onto is woken
+ *                      or the timeout passes. Returns true if it's
+ *                      the latter. A wakeup that came after the last
+ *                      pollset_wait returned makes it return at once;
+ *                      ones it has returned for are forgotten, since
+ *                      the caller looks again after each return.
+ *
+ * Objects that never block, like regular files, can use vopready_poll
+ * (see vnode.h) and need no pollq.
+ */
+
+#include <spinlock.h>
+#include <workqueue.h>
+
+struct pollent;		/* private */
+
+struct pollq {
+	struct spinlock pq_lock;
+	struct pollent *pq_ents;	/* Pollsets hooked on */
+};
+
+struct pollset {
+	struct spinlock ps_lock;
+	struct wchan *ps_wchan;		/* Where the poller sleeps */
+	bool ps_woken;			/* A pollq woke us */
+	bool ps_expired;		/* The timeout passed */
+	int ps_err;			/* From pollq_add */
+	struct pollent *ps_ents;	/* Pollqs we're hooked onto */
+	struct work ps_timer;		/* For pollset_timeout */
+};
+
+void pollq_init(struct pollq *pq);
+void pollq_cleanup(struct pollq *pq);
+void pollq_add(struct pollq *pq, struct pollset *ps);
+void pollq_wakeup(struct pollq *pq);
+
+int pollset_init(struct pollset *ps);
+void pollset_cleanup(struct pollset *ps);
+int pollset_error(struct pollset *ps);
+void pollset_timeout(struct pollset *ps, unsigned ticks);
+bool pollset_wait(struct pollset *ps);
+
+#endif /* _POLL_H_ */
@@ -38,23 +38,39 @@
 
 #include <spinlock.h>
 #include <synch.h>
-
-#define MAX_PROCESSES 32
+#include <workqueue.h>
+#include <usage.h>
 
 struct addrspace;
+struct filetable;
+struct pidrec;
+struct ringctx;
 struct thread;
 struct vnode;
+struct wchan;
+
+/*
+ * Record of a user thread created with threadfork, kept until it is
+ * joined (or the process goes away) so its exit status can be
+ * collected. Protected by the process's p_thlock.
+ */
+struct uthread {
+	int ut_tid;			/* Thread id within the process */
+	bool ut_exited;			/* Has called threadexit */
+	bool ut_joining;		/* Someone is in threadjoin on it */
+	int ut_status;			/* Status passed to threadexit */
+	struct addrspace *ut_as;	/* Held while the thread runs */
+	struct uthread *ut_next;
+};
 
 /*
  * Process structure.
  *
- * Note that we only count the number of threads in each process.
- * (And, unless you implement multithreaded user processes, this
- * number will not exceed 1 except in kproc.) If you want to know
- * exactly which threads are in the process, e.g. for debugging, add
- * an array and a sleeplock to protect it. (You can't use a spinlock
- * to protect an array because arrays need to be able to call
- * kmalloc.)
+ * Note that we only count the number of threads in each process. A
+ * user process has more than one if it uses threadfork; the threads
+ * share the address space and the file table. Records for those
+ * threads (for threadjoin) are kept on p_uthreads; the thread that
+ * started the process has thread id 0 and no record.
  *
  * You will most likely be adding stuff to this structure, so you may
  * find you need a sleeplock in here for other reasons as well.
@@ -66,17 +82,38 @@ struct proc {
 	char *p_name;			/* Name of this process */
 	struct spinlock p_lock;		/* Lock for this structure */
 	unsigned p_numthreads;		/* Number of threads in this process */
-	struct lock *p_mutex; /* mutex lock */
 
-	
+	/* User threads */
+	struct lock *p_thlock;		/* Lock for p_uthreads, p_nexttid */
+	struct cv *p_thcv;		/* Signalled when a thread exits */
+	struct uthread *p_uthreads;	/* Threads not yet joined */
+	int p_nexttid;			/* Next thread id to hand out */
+
 	/* VM */
 	struct addrspace *p_addrspace;	/* virtual address space */
 
 	/* VFS */
 	struct vnode *p_cwd;		/* current working directory */
+	struct filetable *p_ftable;	/* open files, shared by all threads */
 
 	/* add more material here as needed */
-	unsigned p_pid;
+	pid_t p_pid;			/* Process id; see pid.h */
+	struct pidrec *p_pidrec;	/* Our record in the pid table */
+	struct pidrec *p_children;	/* Children still running */
+	struct pidrec *p_zombies;	/* Children exited, not yet waited for */
+	struct wchan *p_waitchan;	/* Where waitpid sleeps */
+	int p_exitstatus;		/* For the parent, when we're done */
+	bool p_exiting;			/* Ending; set once, under p_lock */
+
+	/* Resource usage (see usage.h), under p_lock */
+	struct usage p_usage;		/* Threads that have left */
+	struct usage p_cusage;		/* Children waited for */
+
+	/* Async ring_enter requests; see ring.h */
+	struct ringctx *p_ring;
+
+	/* Deferred teardown; see proc_destroy_deferred */
+	struct work p_destroywork;
 };
 
 /* This is the process structure for the kernel and for kernel-only threads. */
@@ -85,8 +122,8 @@ extern struct proc *kproc;
 /* Call once during system startup to allocate data structures. */
 void proc_bootstrap(void);
 
-/* Create a fresh process for use by runprogram(). */
-struct proc *proc_create_runprogram(const char *name);
+/* Create a fresh process for runprogram() or spawn; PARENT may be NULL. */
+struct proc *proc_create_runprogram(const char *name, struct proc *parent);
 
 /* Create a fresh process for use by sys_fork(). */
 struct proc * proc_create(const char *);
@@ -94,11 +131,20 @@ struct proc * proc_create(const char *);
 /* Destroy a process. */
 void proc_destroy(struct proc *proc);
 
+/* Destroy a process later, from a workqueue thread. */
+void proc_destroy_deferred(struct proc *proc);
+
 /* Attach a thread to a process. Must not already have a process. */
 int proc_addthread(struct proc *proc, struct thread *t);
 
-/* Detach a thread from its process. */
-void proc_remthread(struct thread *t);
+/* Detach a thread from its process. Returns true if it was the last one. */
+bool proc_remthread(struct thread *t);
+
+/* The last thread has left; leave the exit status and destroy the rest. */
+void proc_exit(struct proc *proc);
+
+/* End PROC with STATUS unless already ending; other threads follow. */
+void proc_setexiting(struct proc *proc, int status);
 
 /* Fetch the address space of the current process. */
 struct addrspace *proc_getas(void);
@@ -106,11 +152,7 @@ struct addrspace *proc_getas(void);
 /* Change the address space of the current process, and return the old one. */
 struct addrspace *proc_setas(struct addrspace *);
 
-int pid_allocate(struct proc*);
-
 int open_console_files(void);
 
-void proc_startup(void);
-
 void child_entry(void *, unsigned long);
 #endif /* _PROC_H_ */
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _RING_H_
+#define _RING_H_
+
+/*
+ * Kernel side of ring_enter. The rings themselves are described in
+ * <kern/ring.h>.
+ *
+ * Each process that uses ring_enter gets a ringctx, made the first
+ * time. It holds the requests handed off with RING_ENTER_ASYNC, which
+ * are done by a worker thread that belongs to the process (so it can
+ * get at the process's memory and files) and exits when there's
+ * nothing left to do. It also serializes posting completions, which
+ * can come from the worker and from any thread in ring_enter.
+ *
+ *    ring_drain   - wait until PROC has no async requests left and
+ *                   its worker has left it. execv calls this before
+ *                   it throws out the old memory they refer to.
+ *    ring_destroy - free a ringctx. Called by proc_destroy.
+ */
+
+struct proc;
+struct ringctx;
+
+void ring_drain(struct proc *proc);
+void ring_destroy(struct ringctx *ctx);
+
+#endif /* _RING_H_ */
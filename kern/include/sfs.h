@@ -56,6 +56,7 @@ struct sfs_vnode {
 	struct sfs_dinode sv_i;		/* copy of on-disk inode */
 	uint32_t sv_ino;                /* inode number */
 	bool sv_dirty;                  /* true if sv_i modified */
+	struct rwlock *sv_rwlock;       /* file contents; see sfs_read */
 };
 
 /*
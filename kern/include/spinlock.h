@@ -37,6 +37,8 @@
 
 #include <cdefs.h>
 #include <hangman.h>
+#include <lockstat.h>
+#include <lockdep.h>
 
 /* Inlining support - for making sure an out-of-line copy gets built */
 #ifndef SPINLOCK_INLINE
@@ -58,18 +60,21 @@
 struct spinlock {
 	volatile spinlock_data_t splk_lock; /* Memory word where we spin. */
 	struct cpu *splk_holder;	    /* CPU holding this lock. */
+	LOCKSTAT(splk_lockstat);	    /* Contention statistics. */
+	LOCKDEP_LOCKABLE(splk_lockdep);	    /* Lock order validator hook. */
 	HANGMAN_LOCKABLE(splk_hangman);     /* Deadlock detector hook. */
 };
 
 /*
  * Initializer for cases where a spinlock needs to be static or global.
+ * The _NAMED form also gives it a name, like spinlock_setname.
  */
-#ifdef OPT_HANGMAN
-#define SPINLOCK_INITIALIZER	{ SPINLOCK_DATA_INITIALIZER, NULL, \
+#define SPINLOCK_INITIALIZER_NAMED(name) \
+				{ SPINLOCK_DATA_INITIALIZER, NULL, \
+				  LOCKSTAT_INITIALIZER(name) \
+				  LOCKDEP_LOCKABLE_INITIALIZER(name) \
 				  HANGMAN_LOCKABLE_INITIALIZER }
-#else
-#define SPINLOCK_INITIALIZER	{ SPINLOCK_DATA_INITIALIZER, NULL }
-#endif
+#define SPINLOCK_INITIALIZER	SPINLOCK_INITIALIZER_NAMED("spinlock")
 
 /*
  * Spinlock functions.
@@ -81,6 +86,11 @@ struct spinlock {
  * release	Release the lock. May re-enable interrupts.
  *
  * do_i_hold	Check if the current CPU holds the lock.
+ *
+ * setname	Give the lock a name for debugging output (hangman and
+ *		lockstat) and lock classes (lockdep). The string is not
+ *		copied. Spinlocks are otherwise all just called
+ *		"spinlock".
  */
 
 void spinlock_init(struct spinlock *lk);
@@ -91,5 +101,7 @@ void spinlock_release(struct spinlock *lk);
 
 bool spinlock_do_i_hold(struct spinlock *lk);
 
+void spinlock_setname(struct spinlock *lk, const char *name);
+
 
 #endif /* _SPINLOCK_H_ */
@@ -75,6 +75,8 @@ void V(struct semaphore *);
 struct lock {
         char *lk_name;
         HANGMAN_LOCKABLE(lk_hangman);   /* Deadlock detector hook. */
+        LOCKSTAT(lk_lockstat);          /* Contention statistics. */
+        LOCKDEP_LOCKABLE(lk_lockdep);   /* Lock order validator hook. */
         struct wchan *lk_wchan;
 	      volatile struct thread *lk_thread;
 	      struct spinlock lk_spinlock;
@@ -117,6 +119,7 @@ bool lock_do_i_hold(struct lock *);
 struct cv {
         char *cv_name;
         struct wchan *cv_wchan;
+        LOCKSTAT(cv_lockstat);          /* Wait statistics. */
 };
 
 struct cv *cv_create(const char *name);
@@ -146,18 +149,46 @@ void cv_broadcast(struct cv *cv, struct lock *lock);
  * when the lock is destroyed, no thread should be holding it.
  *
  * The name field is for easier debugging. A copy of the name is
- * (should be) made internally.
+ * made internally.
+ *
+ * Readers are counted per cpu: a reader that finds no writer around
+ * only bumps its own cpu's counter, which has a cache line to itself,
+ * so readers on different cpus never write to the same line or take
+ * a lock. (They do all read rw_wpending, which only writers write.) A writer raises
+ * rw_wpending, which sends later readers to the slow path, and then
+ * waits for the sum of the counters to drain to zero. A reader may
+ * release on a different cpu than it acquired on, so individual
+ * counters can go negative; only the sum means anything.
+ *
+ * Fairness:
+ *    - Writers are preferred. Once a writer is waiting, new readers
+ *      block instead of joining the readers already in.
+ *    - Writers are served one at a time, in wchan order.
+ *    - When a writer releases the lock, all the readers that were
+ *      waiting at that moment are let in as a batch before the next
+ *      writer may start (rw_handoff counts the batch down). So
+ *      neither side can starve the other: readers and writers
+ *      alternate whenever both are waiting.
+ *
+ * The lock is not recursive, and a thread holding it for reading may
+ * not ask for it for writing (that deadlocks against itself).
  */
 
+struct rwlock_readers;		/* Private to synch.c */
+
 struct rwlock {
         char *rwlock_name;
-        volatile int read_count;
-        volatile int num_writers;
-        struct lock *rw_lock;
-        struct cv *r_cv;
-        struct cv *w_cv;
-        // add what you need here
-        // (don't forget to mark things volatile as needed)
+        struct rwlock_readers *rw_readers; /* Per-cpu counts (MAXCPUS) */
+        volatile bool rw_wpending;	/* Writers present; readers go slow */
+        struct spinlock rw_lock;	/* Protects everything below */
+        struct wchan *rw_rwchan;	/* Blocked readers */
+        struct wchan *rw_wwchan;	/* Writers waiting their turn */
+        struct wchan *rw_drainchan;	/* Writer waiting for readers */
+        struct thread *rw_writer;	/* Writer holding/draining, or NULL */
+        unsigned rw_nwriters;		/* Writers holding or waiting */
+        unsigned rw_nrwaiting;		/* Readers blocked on rw_rwchan */
+        unsigned rw_handoff;		/* Readers in the batch not yet in */
+        LOCKSTAT(rw_lockstat);		/* Contention statistics */
 };
 
 struct rwlock * rwlock_create(const char *);
@@ -172,7 +203,7 @@ void rwlock_destroy(struct rwlock *);
  *                           hold the write lock at one time.
  *    rwlock_release_write - Free the write lock.
  *
- * These operations must be atomic. You get to write them.
+ * These operations are atomic.
  */
 
 void rwlock_acquire_read(struct rwlock *);
@@ -35,6 +35,7 @@
 
 #include <cdefs.h> /* for __DEAD */
 struct trapframe; /* from <machine/trapframe.h> */
+struct proc; /* from <proc.h> */
 
 /*
  * The system call dispatcher.
@@ -49,6 +50,12 @@ void syscall(struct trapframe *tf);
 /* Helper for fork(). You write this. */
 void enter_forked_process(struct trapframe *tf);
 
+/* Set up the futex wait queues. */
+void futex_bootstrap(void);
+
+/* Wake all of PROC's futex waiters; it's ending. */
+void futex_wakeproc(struct proc *proc);
+
 /* Enter user mode. Does not return. */
 __DEAD void enter_new_process(int argc, userptr_t argv, userptr_t env,
 		       vaddr_t stackptr, vaddr_t entrypoint);
@@ -60,5 +67,19 @@ __DEAD void enter_new_process(int argc, userptr_t argv, userptr_t env,
 
 int sys_reboot(int code);
 int sys___time(userptr_t user_seconds, userptr_t user_nanoseconds);
+int sys_futex_wait(userptr_t uaddr, int val);
+int sys_futex_wake(userptr_t uaddr, int count, int *retval);
+int sys___threadfork(struct trapframe *tf, userptr_t entry, userptr_t arg,
+		     userptr_t stackptr, int *retval);
+__DEAD void sys_threadexit(int status);
+int sys_threadjoin(int tid, userptr_t status);
+int sys_spawn(const_userptr_t path, userptr_t argv, const_userptr_t actions,
+	      int nactions, int *retval);
+int sys_syscallstat(int callno, int cpu, userptr_t buf);
+int sys_ring_enter(userptr_t ring, unsigned to_submit, unsigned min_complete,
+		   int flags, int *retval);
+int sys_poll(userptr_t fds, unsigned nfds, int timeout, int *retval);
+int sys_select(int nfds, userptr_t readfds, userptr_t writefds,
+	       userptr_t exceptfds, userptr_t timeout, int *retval);
 
 #endif /* _SYSCALL_H_ */
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _SYSCALLSTAT_H_
+#define _SYSCALLSTAT_H_
+
+/*
+ * Per-cpu system call counters. The record layout, and what is
+ * counted, are in <kern/syscallstat.h>.
+ *
+ *    syscallstat_create - set up the counters for cpu C. Called by
+ *                         thread_start_cpus once all cpus are up.
+ *    syscallstat_enter  - count a call to CALLNO. Returns the cycle
+ *                         count to pass to syscallstat_exit.
+ *    syscallstat_exit   - CALLNO, started at START, is returning ERR.
+ *    syscallstat_get    - fetch the counts for CALLNO on cpu CPU, or
+ *                         summed over all cpus with SYSCALLSTAT_ALLCPUS.
+ *    syscallstat_dump   - print a summary of all calls made, or the
+ *                         whole histogram for one.
+ *
+ * Each cpu updates only its own counters, at splhigh, so counting
+ * takes no locks and causes no cache traffic between cpus. Readers
+ * don't lock either; the sums can be a call or two out of step with
+ * each other.
+ */
+
+#include <kern/syscallstat.h>
+
+struct cpu;
+
+void syscallstat_create(struct cpu *c);
+uint64_t syscallstat_enter(int callno);
+void syscallstat_exit(int callno, int err, uint64_t start);
+int syscallstat_get(int callno, int cpu, struct syscallstat *ret);
+void syscallstat_dump(int callno);
+
+#endif /* _SYSCALLSTAT_H_ */
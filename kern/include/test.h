@@ -52,11 +52,13 @@ int arraytest(int, char **);
 int arraytest2(int, char **);
 int bitmaptest(int, char **);
 int threadlisttest(int, char **);
+int pidtest(int, char **);
 
 /* thread tests */
 int threadtest(int, char **);
 int threadtest2(int, char **);
 int threadtest3(int, char **);
+int workqueuetest(int, char **);
 int semtest(int, char **);
 int locktest(int, char **);
 int locktest2(int, char **);
@@ -74,6 +76,12 @@ int rwtest3(int, char **);
 int rwtest4(int, char **);
 int rwtest5(int, char **);
 
+/* synchronization benchmarks */
+int lockbench(int, char **);
+int spinlockbench(int, char **);
+int rwlockbench(int, char **);
+int wakebench(int, char **);
+
 /* semaphore unit tests */
 int semu1(int, char **);
 int semu2(int, char **);
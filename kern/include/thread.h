@@ -39,8 +39,7 @@
 #include <array.h>
 #include <spinlock.h>
 #include <threadlist.h>
-#include <kern/fdesc.h>
-#include <limits.h>
+#include <usage.h>
 
 struct cpu;
 
@@ -95,9 +94,10 @@ struct thread {
 	struct switchframe *t_context;	/* Saved register context (on stack) */
 	struct cpu *t_cpu;		/* CPU thread runs on */
 	struct proc *t_proc;		/* Process thread belongs to */
-	struct fdesc *t_ftable[OPEN_MAX];
-	unsigned t_pid;
+	int t_tid;			/* User thread id within t_proc */
+	bool t_bound;			/* Never migrated off t_cpu */
 	HANGMAN_ACTOR(t_hangman);	/* Deadlock detector hook */
+	LOCKDEP_ACTOR(t_lockdep);	/* Locks held, for lockdep */
 
 	/*
 	 * Interrupt state fields.
@@ -116,6 +116,10 @@ struct thread {
 	int t_curspl;			/* Current spl*() state */
 	int t_iplhigh_count;		/* # of times IPL has been raised */
 
+	/* Resource usage; see usage.h */
+	struct usage t_usage;		/* Not yet added to t_proc's */
+	uint64_t t_usagestamp;		/* Cycle count when last charged */
+
 	/*
 	 * Public fields
 	 */
@@ -133,9 +137,6 @@ struct thread {
 DECLARRAY(thread, THREADINLINE);
 DEFARRAY(thread, THREADINLINE);
 
-/* Call to initialize file table */
-void t_ftable_init(struct thread *, void *, void *);
-
 /* Call once during system startup to allocate data structures. */
 void thread_bootstrap(void);
 
@@ -162,6 +163,15 @@ int thread_fork(const char *name, struct proc *proc,
                 void (*func)(void *, unsigned long),
                 void *data1, unsigned long data2);
 
+/*
+ * Like thread_fork, for a kernel thread in the current process that
+ * runs only on cpu C: it starts there, and the scheduler never
+ * migrates it elsewhere. For per-cpu service threads.
+ */
+int thread_fork_bound(const char *name, struct cpu *c,
+		      void (*func)(void *, unsigned long),
+		      void *data1, unsigned long data2);
+
 /*
  * Cause the current thread to exit.
  * Interrupts need not be disabled.
@@ -138,5 +138,15 @@ int uiomovezeros(size_t len, struct uio *uio);
 void uio_kinit(struct iovec *, struct uio *,
 	       void *kbuf, size_t len, off_t pos, enum uio_rw rw);
 
+/*
+ * Same, but for I/O straight to or from a user buffer in the current
+ * process's address space. No copy of the buffer is made here; the
+ * one copy happens when uiomove calls copyin or copyout, which also
+ * checks the address, so a bad pointer shows up as EFAULT from the
+ * operation.
+ */
+void uio_uinit(struct iovec *, struct uio *,
+	       userptr_t ubuf, size_t len, off_t pos, enum uio_rw rw);
+
 
 #endif /* _UIO_H_ */
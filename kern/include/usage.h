@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _USAGE_H_
+#define _USAGE_H_
+
+/*
+ * Resource usage accounting, for getrusage() and wait4().
+ *
+ * Each thread counts its own usage in t_usage, which only it touches,
+ * so counting takes no locks. Time is counted in cpu cycles: the
+ * thread keeps the cycle count at its last change between user mode,
+ * the kernel and not running (t_usagestamp), and the cycles since
+ * then are charged to user or system time at the next change. Time
+ * spent switched out isn't charged to anyone.
+ *
+ * When a thread leaves its process its counts are added to the
+ * process's p_usage. When a process exits its own counts and those
+ * of the children it waited for are left with its exit status, and
+ * the parent adds them to its p_cusage when it collects the status.
+ *
+ *    usage_charge   - charge T's cycles since its stamp to user time
+ *                     if USER, otherwise to system time, and restamp.
+ *                     Called on the way into the kernel from user mode
+ *                     (USER), on the way back out, and on switching
+ *                     out.
+ *    usage_stamp    - restamp T without charging it. Called when T
+ *                     is switched back in.
+ *    usage_add      - add FROM's counts into TO.
+ *    usage_self     - the usage of the current process so far: the
+ *                     threads that have left it and the calling
+ *                     thread. Other threads still running aren't
+ *                     counted until they leave.
+ *    usage_children - the usage of the current process's children
+ *                     that have been waited for.
+ *    usage_export   - convert to the user-visible struct rusage.
+ */
+
+struct proc;
+struct thread;
+struct rusage;
+
+struct usage {
+	uint64_t u_utime;		/* Cycles in user mode */
+	uint64_t u_stime;		/* Cycles in the kernel */
+	uint32_t u_minflt;		/* Faults handled without I/O */
+	uint32_t u_majflt;		/* Faults that needed I/O */
+	uint32_t u_inblock;		/* Filesystem blocks read */
+	uint32_t u_oublock;		/* Filesystem blocks written */
+	uint32_t u_nvcsw;		/* Gave up the cpu (sleep, yield) */
+	uint32_t u_nivcsw;		/* Had it taken away (preempted) */
+};
+
+void usage_charge(struct thread *t, bool user);
+void usage_stamp(struct thread *t);
+void usage_add(struct usage *to, const struct usage *from);
+void usage_self(struct usage *ret);
+void usage_children(struct usage *ret);
+void usage_export(const struct usage *u, struct rusage *ret);
+
+#endif /* _USAGE_H_ */
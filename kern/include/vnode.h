@@ -33,6 +33,7 @@
 #include <spinlock.h>
 struct uio;
 struct stat;
+struct pollset;
 
 
 /*
@@ -120,6 +121,13 @@ struct vnode {
  *    vop_fsync       - Force any dirty buffers associated with this file
  *                      to stable storage.
  *
+ *    vop_poll        - Return which of the POLL* conditions in EVENTS
+ *                      (see kern/poll.h) hold now, plus POLLERR or
+ *                      POLLHUP if they do. If PS isn't NULL, first
+ *                      hook it onto whatever pollq is woken when the
+ *                      answer changes (see poll.h). Objects that never
+ *                      block can use vopready_poll.
+ *
  *    vop_mmap        - Map file into memory. If you implement this
  *                      feature, you're responsible for choosing the
  *                      arguments for this operation.
@@ -193,6 +201,7 @@ struct vnode_ops {
 	int (*vop_gettype)(struct vnode *object, mode_t *result);
 	bool (*vop_isseekable)(struct vnode *object);
 	int (*vop_fsync)(struct vnode *object);
+	int (*vop_poll)(struct vnode *object, int events, struct pollset *ps);
 	int (*vop_mmap)(struct vnode *file /* add stuff */);
 	int (*vop_truncate)(struct vnode *file, off_t len);
 	int (*vop_namefile)(struct vnode *file, struct uio *uio);
@@ -237,6 +246,7 @@ struct vnode_ops {
 #define VOP_GETTYPE(vn, result)         (__VOP(vn, gettype)(vn, result))
 #define VOP_ISSEEKABLE(vn)              (__VOP(vn, isseekable)(vn))
 #define VOP_FSYNC(vn)                   (__VOP(vn, fsync)(vn))
+#define VOP_POLL(vn, events, ps)        (__VOP(vn, poll)(vn, events, ps))
 #define VOP_MMAP(vn /*add stuff */)     (__VOP(vn, mmap)(vn /*add stuff */))
 #define VOP_TRUNCATE(vn, pos)           (__VOP(vn, truncate)(vn, pos))
 #define VOP_NAMEFILE(vn, uio)           (__VOP(vn, namefile)(vn, uio))
@@ -312,5 +322,10 @@ int vopfail_lookup_notdir(struct vnode *vn, char *path, struct vnode **result);
 int vopfail_lookparent_notdir(struct vnode *vn, char *path,
 			      struct vnode **result, char *buf, size_t len);
 
+/*
+ * Common stub for vop_poll on objects that are always ready.
+ */
+int vopready_poll(struct vnode *vn, int events, struct pollset *ps);
+
 
 #endif /* _VNODE_H_ */
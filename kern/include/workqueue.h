@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _WORKQUEUE_H_
+#define _WORKQUEUE_H_
+
+/*
+ * Deferred work.
+ *
+ * Each cpu has a workqueue serviced by its own kernel worker thread,
+ * started from thread_start_cpus. Work items are queued on the
+ * current cpu's queue and run later, in thread context, by that
+ * worker. This is for expensive cleanup that doesn't need to happen
+ * before the caller can go on (address space teardown, reaping and
+ * the like) and for anything that needs to be started from interrupt
+ * context but can't run there.
+ *
+ * Queueing only takes spinlocks, so it is safe from interrupt
+ * handlers. Flushing and cancelling may sleep and may not be called
+ * from interrupts.
+ *
+ * The work structure belongs to the caller and is normally embedded
+ * in whatever object it operates on. It must not be freed or
+ * reinitialized while it is pending, and must be cleaned up with
+ * work_cleanup before it is freed. The function may free the
+ * structure containing it; nothing touches the work item after its
+ * function has been called.
+ */
+
+#include <types.h>
+#include <spinlock.h>
+
+struct cpu;		/* from <cpu.h> */
+struct workqueue;	/* Opaque */
+
+/* States of a work item; workqueue-internal. */
+typedef enum {
+	WORK_IDLE,	/* not queued (may be running) */
+	WORK_PENDING,	/* on a queue, waiting for the worker */
+	WORK_DELAYED,	/* waiting for its delay to expire */
+} workstate_t;
+
+struct work {
+	struct spinlock w_lock;		/* Serializes queueing W */
+	struct work *w_next;		/* Link on queue */
+	void (*w_func)(void *data1, unsigned long data2);
+	void *w_data1;			/* Arguments for w_func */
+	unsigned long w_data2;
+	struct workqueue *w_wq;		/* Queue last queued on */
+	volatile workstate_t w_state;	/* Protected by w_wq's lock */
+	unsigned w_ticks;		/* Hardclocks left, if delayed */
+};
+
+/*
+ * Initialize a work item to call FUNC(DATA1, DATA2) when run.
+ */
+void work_init(struct work *w, void (*func)(void *, unsigned long),
+	       void *data1, unsigned long data2);
+
+/*
+ * Clean up a work item that is neither pending nor delayed, before
+ * freeing it. Its function may call this on it while running.
+ */
+void work_cleanup(struct work *w);
+
+/*
+ * Operations:
+ *    work_queue         - Queue W on the current cpu's workqueue.
+ *                         Returns false (and does nothing) if W was
+ *                         already pending.
+ *    work_queue_delayed - Same, but the work is held for at least
+ *                         TICKS hardclocks before being run.
+ *    work_cancel        - Take W off its queue if it hasn't started
+ *                         running yet. Returns true if it was
+ *                         pending. Does not wait if W is running.
+ *    work_flush         - Wait until W is neither pending nor
+ *                         running. Delayed work is waited for too.
+ *    workqueue_flush    - Wait until all work queued (not delayed)
+ *                         on any cpu before the call has been run.
+ */
+bool work_queue(struct work *w);
+bool work_queue_delayed(struct work *w, unsigned ticks);
+bool work_cancel(struct work *w);
+void work_flush(struct work *w);
+void workqueue_flush(void);
+
+/*
+ * Create the workqueue and worker thread for cpu C. Called by
+ * thread_start_cpus once all cpus are up.
+ */
+void workqueue_create(struct cpu *c);
+
+/* Age delayed work on the current cpu. Called from hardclock(). */
+void workqueue_hardclock(void);
+
+#endif /* _WORKQUEUE_H_ */
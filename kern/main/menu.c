@@ -39,11 +39,15 @@
 #include <synch.h>
 #include <thread.h>
 #include <proc.h>
+#include <kern/fdesc.h>
+#include <filetable.h>
 #include <vfs.h>
 #include <sfs.h>
 #include <syscall.h>
 #include <test.h>
 #include <prompt.h>
+#include <lockstat.h>
+#include <syscallstat.h>
 #include "opt-sfs.h"
 #include "opt-net.h"
 #include "opt-synchprobs.h"
@@ -63,82 +67,51 @@
 
 /*
  * Open console files
+ *
+ * Each of stdin, stdout, and stderr gets its own open of con:. If
+ * one fails, the ones already in the file table are closed when the
+ * process is destroyed.
  */
 int
 open_console_files() {
 
+	static const struct {
+		const char *name;
+		int flags;
+	} con[3] = {
+		{ "stdin", O_RDONLY },
+		{ "stdout", O_WRONLY },
+		{ "stderr", O_WRONLY },
+	};
+
 	int retval = 0;
-	char *buf = kmalloc(sizeof(char *));
-	struct vnode *in;
-	struct vnode *out;
-	struct vnode *err;
-	struct fdesc *fd_in = kmalloc(sizeof(struct fdesc));
-	struct fdesc *fd_out = kmalloc(sizeof(struct fdesc));
-	struct fdesc *fd_err = kmalloc(sizeof(struct fdesc));
-
-	mode_t m = 0664;
-
-	strcpy(buf, "con:");
-	retval = vfs_open(buf, O_RDONLY, m, &in);
-	if (retval) {
-		return retval;
-	}
-
-	strcpy(buf, "stdin");
-	retval = fdesc_init(fd_in, buf, in, O_RDONLY);
-	if (retval) {
-		return retval;
-	}
-	curthread->t_ftable[0] = fd_in;
-
-
-	strcpy(buf, "con:");
-	retval = vfs_open(buf, O_WRONLY, m, &out);
-	if (retval) {
-		kfree(buf);
-		kfree(fd_in);
-		kfree(fd_out);
-		kfree(fd_err);
-		return retval;
-	}
-
-	strcpy(buf, "stdout");
-	retval = fdesc_init(fd_out, buf, out, O_WRONLY);
-	if (retval) {
-		kfree(buf);
-		kfree(fd_in);
-		kfree(fd_out);
-		kfree(fd_err);
-		return retval;
-	}
-	curthread->t_ftable[1] = fd_out;
-
-
-	strcpy(buf, "con:");
-	retval = vfs_open(buf, O_WRONLY, m, &err);
-	if (retval) {
-		kfree(buf);
-		kfree(fd_in);
-		kfree(fd_out);
-		kfree(fd_err);
-		return retval;
-	}
-
-	strcpy(buf, "stderr");
-	retval = fdesc_init(fd_err, buf, err, O_WRONLY);
-	if (retval) {
-		kfree(buf);
-		kfree(fd_in);
-		kfree(fd_out);
-		kfree(fd_err);
-		return retval;
-	}
-	curthread->t_ftable[2] = fd_err;
-
-	kfree(buf);
-	kfree(fd_in);
-	kfree(fd_out);
-	kfree(fd_err);
+	char buf[8];
+	struct vnode *vn;
+	struct fdesc *fd;
+	struct fdesc *old;
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		// vfs_open may scribble on the path
+		strcpy(buf, "con:");
+		retval = vfs_open(buf, con[i].flags, 0664, &vn);
+		if (retval) {
+			return retval;
+		}
+
+		fd = fdesc_create(con[i].name, vn, con[i].flags);
+		if (fd == NULL) {
+			vfs_close(vn);
+			return ENOMEM;
+		}
+
+		retval = filetable_placeat(curproc->p_ftable, fd, i, &old);
+		if (retval) {
+			fdesc_decref(fd);
+			return retval;
+		}
+		KASSERT(old == NULL);
+	}
 
 	return 0;
 
@@ -209,7 +182,7 @@ common_prog(int nargs, char **args)
 	unsigned tc;
 
 	/* Create a process for the new program to run in. */
-	proc = proc_create_runprogram(args[0] /* name */);
+	proc = proc_create_runprogram(args[0] /* name */, NULL);
 	if (proc == NULL) {
 		return ENOMEM;
 	}
@@ -228,8 +201,8 @@ common_prog(int nargs, char **args)
 	}
 
 	/*
-	 * The new process will be destroyed when the program exits...
-	 * once you write the code for handling that.
+	 * The new process is destroyed when the program exits. It has
+	 * no parent, so nothing keeps its exit status.
 	 */
 
 	// Wait for all threads to finish cleanup, otherwise khu be a bit behind,
@@ -604,6 +577,46 @@ cmd_kheapdump(int nargs, char **args)
 	return 0;
 }
 
+static
+int
+cmd_syscallstat(int nargs, char **args)
+{
+	int callno = -1;
+
+	if (nargs == 2) {
+		callno = atoi(args[1]);
+	}
+	if (nargs > 2 || (nargs == 2 && callno < 0)) {
+		kprintf("Usage: scstat [callno]\n");
+		return EINVAL;
+	}
+
+	syscallstat_dump(callno);
+
+	return 0;
+}
+
+#if OPT_LOCKSTAT
+static
+int
+cmd_lockstat(int nargs, char **args)
+{
+	int n = 10;
+
+	if (nargs == 2) {
+		n = atoi(args[1]);
+	}
+	if (nargs > 2 || n <= 0) {
+		kprintf("Usage: lockstat [count]\n");
+		return EINVAL;
+	}
+
+	lockstat_dump(n);
+
+	return 0;
+}
+#endif
+
 ////////////////////////////////////////
 //
 // Menus.
@@ -666,6 +679,7 @@ static const char *testmenu[] = {
 	"[at2] Large array test              ",
 	"[bt]  Bitmap test                   ",
 	"[tlt] Threadlist test               ",
+	"[pidt] Pid allocator test           ",
 	"[km1] Kernel malloc test            ",
 	"[km2] kmalloc stress test           ",
 	"[km3] Large kmalloc test            ",
@@ -674,6 +688,7 @@ static const char *testmenu[] = {
 	"[tt1] Thread test 1                 ",
 	"[tt2] Thread test 2                 ",
 	"[tt3] Thread test 3                 ",
+	"[wqt] Workqueue test                ",
 #if OPT_NET
 	"[net] Network test                  ",
 #endif
@@ -683,6 +698,10 @@ static const char *testmenu[] = {
 	"[lt3]  Lock test 3           (1*)   ",
 	"[lt4]  Lock test 4           (1*)   ",
 	"[lt5]  Lock test 5           (1*)   ",
+	"[ltb]  Lock contention benchmark    ",
+	"[slb]  Spinlock contention benchmark",
+	"[rwb]  RW lock read-mostly benchmark",
+	"[wkb]  Wakeup storm benchmark       ",
 	"[cvt1] CV test 1             (1)    ",
 	"[cvt2] CV test 2             (1)    ",
 	"[cvt3] CV test 3             (1*)   ",
@@ -755,6 +774,7 @@ static const char *mainmenu[] = {
 	"[khu] Kernel heap usage             ",
 	"[khgen] Next kernel heap generation ",
 	"[khdump] Dump kernel heap           ",
+	"[scstat] System call stats          ",
 	"[q] Quit and shut down              ",
 	NULL
 };
@@ -810,12 +830,17 @@ static struct {
 	{ "khu",        cmd_kheapused },
 	{ "khgen",      cmd_kheapgeneration },
 	{ "khdump",     cmd_kheapdump },
+	{ "scstat",	cmd_syscallstat },
+#if OPT_LOCKSTAT
+	{ "lockstat",	cmd_lockstat },
+#endif
 
 	/* base system tests */
 	{ "at",		arraytest },
 	{ "at2",	arraytest2 },
 	{ "bt",		bitmaptest },
 	{ "tlt",	threadlisttest },
+	{ "pidt",	pidtest },
 	{ "km1",	kmalloctest },
 	{ "km2",	kmallocstress },
 	{ "km3",	kmalloctest3 },
@@ -827,6 +852,7 @@ static struct {
 	{ "tt1",	threadtest },
 	{ "tt2",	threadtest2 },
 	{ "tt3",	threadtest3 },
+	{ "wqt",	workqueuetest },
 
 	/* synchronization assignment tests */
 	{ "sem1",	semtest },
@@ -835,6 +861,10 @@ static struct {
 	{ "lt3",	locktest3 },
 	{ "lt4", 	locktest4 },
 	{ "lt5", 	locktest5 },
+	{ "ltb",	lockbench },
+	{ "slb",	spinlockbench },
+	{ "rwb",	rwlockbench },
+	{ "wkb",	wakebench },
 	{ "cvt1",	cvtest },
 	{ "cvt2",	cvtest2 },
 	{ "cvt3",	cvtest3 },
@@ -1002,8 +1032,6 @@ menu(char *args)
 {
 	char buf[64];
 
-	proc_startup();
-
 	menu_execute(args, 1);
 	
 	while (1) {
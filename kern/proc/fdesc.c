@@ -2,46 +2,137 @@
  * Functionality for file decriptors
  *
  */
-#include <kern/stattypes.h>
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/seek.h>
 #include <kern/fdesc.h>
-#include <synch.h>
+#include <spinlock.h>
 #include <vnode.h>
-#include <types.h>
+#include <vfs.h>
 #include <lib.h>
 
-int
-fdesc_init(struct fdesc *fd, char *name, struct vnode *vn, int flags) {
-	
+struct fdesc *
+fdesc_create(const char *name, struct vnode *vn, int flags) {
+
+	struct fdesc *fd;
+
+	KASSERT(vn != NULL);
+
+	fd = kmalloc(sizeof(*fd));
+	if (fd == NULL) {
+		return NULL;
+	}
+
 	fd->name = kstrdup(name);
 	if (fd->name == NULL) {
-		return -1;
+		kfree(fd);
+		return NULL;
 	}
 
 	fd->openflags = flags;
-
+	fd->seekable = VOP_ISSEEKABLE(vn);
 	fd->vn = vn;
-	if (fd->vn == NULL) {
-		return -1;
+	spinlock_init(&fd->lock);
+	fd->ofst = 0;
+	fd->refnum = 1;
+
+	return fd;
+}
+
+void
+fdesc_incref(struct fdesc *fd) {
+
+	spinlock_acquire(&fd->lock);
+	fd->refnum++;
+	spinlock_release(&fd->lock);
+}
+
+void
+fdesc_decref(struct fdesc *fd) {
+
+	unsigned refnum;
+
+	spinlock_acquire(&fd->lock);
+	KASSERT(fd->refnum > 0);
+	refnum = --fd->refnum;
+	spinlock_release(&fd->lock);
+
+	if (refnum == 0) {
+		vfs_close(fd->vn);
+		spinlock_cleanup(&fd->lock);
+		kfree(fd->name);
+		kfree(fd);
 	}
+}
 
-	fd->ofst = 0;
+off_t
+fdesc_advance(struct fdesc *fd, size_t len) {
 
-	fd->refnum = 0;
+	off_t pos;
 
-	fd->lk = lock_create(fd->name);
-	if (fd->lk == NULL) {
-		return -1;
+	if (!fd->seekable) {
+		return 0;
 	}
 
-	return 0;
+	spinlock_acquire(&fd->lock);
+	pos = fd->ofst;
+	fd->ofst += len;
+	spinlock_release(&fd->lock);
+
+	return pos;
 }
 
 void
-fdesc_destroy(struct fdesc *fd) {
-	
-	kfree(fd->name);
+fdesc_retreat(struct fdesc *fd, off_t pos, size_t len, size_t done) {
+
+	KASSERT(done <= len);
 
-	lock_destroy(fd->lk);
+	if (!fd->seekable || done == len) {
+		return;
+	}
+
+	// If someone else has claimed space after ours, or seeked, leave it
+	spinlock_acquire(&fd->lock);
+	if (fd->ofst == pos + (off_t)len) {
+		fd->ofst = pos + done;
+	}
+	spinlock_release(&fd->lock);
+}
+
+int
+fdesc_seek(struct fdesc *fd, off_t pos, int whence, off_t eof, off_t *ret) {
 
-	kfree(fd);
+	off_t cursor;
+
+	if (!fd->seekable) {
+		return ESPIPE;
+	}
+
+	spinlock_acquire(&fd->lock);
+
+	switch (whence) {
+	    case SEEK_SET:
+		cursor = pos;
+		break;
+	    case SEEK_CUR:
+		cursor = fd->ofst + pos;
+		break;
+	    case SEEK_END:
+		cursor = eof + pos;
+		break;
+	    default:
+		spinlock_release(&fd->lock);
+		return EINVAL;
+	}
+
+	if (cursor < 0) {
+		spinlock_release(&fd->lock);
+		return EINVAL;
+	}
+
+	fd->ofst = cursor;
+	spinlock_release(&fd->lock);
+
+	*ret = cursor;
+	return 0;
 }
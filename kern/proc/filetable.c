@@ -0,0 +1,362 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * File descriptor tables. The interface is documented in filetable.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <limits.h>
+#include <synch.h>
+#include <proc.h>
+#include <current.h>
+#include <kern/fdesc.h>
+#include <filetable.h>
+
+/* Size of a new table's first allocation; a multiple of 32. */
+#define FT_MINSIZE	32
+
+#define FT_WORD(fd)	((unsigned)(fd) / 32)
+#define FT_BIT(fd)	((uint32_t)1 << ((unsigned)(fd) % 32))
+
+#if OPEN_MAX % FT_MINSIZE != 0
+#error "OPEN_MAX must be a multiple of FT_MINSIZE"
+#endif
+
+/*
+ * Take the table's lock, unless curproc is single-threaded. Returns
+ * whether it was taken, to pass to filetable_unlock.
+ *
+ * p_numthreads can't go from 1 to more while we're in here, since
+ * the only thread that could add one is us. If it reads as more than
+ * 1 when it isn't any more, we lock for nothing, which is harmless.
+ */
+static
+bool
+filetable_lock(struct filetable *ft)
+{
+	if (curproc->p_numthreads == 1) {
+		return false;
+	}
+	lock_acquire(ft->ft_lock);
+	return true;
+}
+
+static
+void
+filetable_unlock(struct filetable *ft, bool locked)
+{
+	if (locked) {
+		lock_release(ft->ft_lock);
+	}
+}
+
+/*
+ * Index of the lowest clear bit in WORD, which must have one.
+ */
+static
+unsigned
+ffz(uint32_t word)
+{
+	unsigned bit = 0;
+
+	KASSERT(word != 0xffffffff);
+
+	word = ~word;
+	if ((word & 0xffff) == 0) {
+		word >>= 16;
+		bit += 16;
+	}
+	if ((word & 0xff) == 0) {
+		word >>= 8;
+		bit += 8;
+	}
+	if ((word & 0xf) == 0) {
+		word >>= 4;
+		bit += 4;
+	}
+	if ((word & 0x3) == 0) {
+		word >>= 2;
+		bit += 2;
+	}
+	if ((word & 0x1) == 0) {
+		bit += 1;
+	}
+	return bit;
+}
+
+/*
+ * Make the table at least MINSIZE slots, doubling it as many times as
+ * needed. The table must be locked (or private).
+ */
+static
+int
+filetable_grow(struct filetable *ft, unsigned minsize)
+{
+	struct fdesc **files;
+	uint32_t *inuse;
+	unsigned size;
+
+	KASSERT(minsize <= OPEN_MAX);
+	KASSERT(minsize > ft->ft_size);
+
+	size = ft->ft_size > 0 ? ft->ft_size : FT_MINSIZE;
+	while (size < minsize) {
+		size *= 2;
+	}
+	if (size > OPEN_MAX) {
+		size = OPEN_MAX;
+	}
+
+	files = kmalloc(size * sizeof(files[0]));
+	if (files == NULL) {
+		return ENOMEM;
+	}
+	inuse = kmalloc(FT_WORD(size) * sizeof(inuse[0]));
+	if (inuse == NULL) {
+		kfree(files);
+		return ENOMEM;
+	}
+
+	memset(files, 0, size * sizeof(files[0]));
+	memset(inuse, 0, FT_WORD(size) * sizeof(inuse[0]));
+	if (ft->ft_size > 0) {
+		memcpy(files, ft->ft_files,
+		       ft->ft_size * sizeof(files[0]));
+		memcpy(inuse, ft->ft_inuse,
+		       FT_WORD(ft->ft_size) * sizeof(inuse[0]));
+		kfree(ft->ft_files);
+		kfree(ft->ft_inuse);
+	}
+
+	ft->ft_files = files;
+	ft->ft_inuse = inuse;
+	ft->ft_size = size;
+	return 0;
+}
+
+struct filetable *
+filetable_create(void)
+{
+	struct filetable *ft;
+
+	ft = kmalloc(sizeof(*ft));
+	if (ft == NULL) {
+		return NULL;
+	}
+	ft->ft_lock = lock_create("filetable");
+	if (ft->ft_lock == NULL) {
+		kfree(ft);
+		return NULL;
+	}
+	ft->ft_size = 0;
+	ft->ft_lowfree = 0;
+	ft->ft_files = NULL;
+	ft->ft_inuse = NULL;
+	return ft;
+}
+
+void
+filetable_destroy(struct filetable *ft)
+{
+	unsigned i, fd;
+	uint32_t word;
+
+	/* Nobody else can see the table now; no need to lock. */
+	for (i = 0; i < FT_WORD(ft->ft_size); i++) {
+		for (word = ft->ft_inuse[i]; word != 0; word &= word - 1) {
+			fd = i * 32 + ffz(~word);
+			fdesc_decref(ft->ft_files[fd]);
+		}
+	}
+
+	if (ft->ft_size > 0) {
+		kfree(ft->ft_files);
+		kfree(ft->ft_inuse);
+	}
+	lock_destroy(ft->ft_lock);
+	kfree(ft);
+}
+
+int
+filetable_copy(struct filetable *src, struct filetable *dst)
+{
+	unsigned i, fd;
+	uint32_t word;
+	bool locked;
+	int result;
+
+	KASSERT(dst->ft_size == 0);
+
+	locked = filetable_lock(src);
+	if (src->ft_size == 0) {
+		filetable_unlock(src, locked);
+		return 0;
+	}
+
+	result = filetable_grow(dst, src->ft_size);
+	if (result) {
+		filetable_unlock(src, locked);
+		return result;
+	}
+	KASSERT(dst->ft_size == src->ft_size);
+
+	memcpy(dst->ft_files, src->ft_files,
+	       src->ft_size * sizeof(src->ft_files[0]));
+	memcpy(dst->ft_inuse, src->ft_inuse,
+	       FT_WORD(src->ft_size) * sizeof(src->ft_inuse[0]));
+	dst->ft_lowfree = src->ft_lowfree;
+
+	for (i = 0; i < FT_WORD(src->ft_size); i++) {
+		for (word = src->ft_inuse[i]; word != 0; word &= word - 1) {
+			fd = i * 32 + ffz(~word);
+			fdesc_incref(src->ft_files[fd]);
+		}
+	}
+
+	filetable_unlock(src, locked);
+	return 0;
+}
+
+int
+filetable_get(struct filetable *ft, int fd, struct fdesc **ret)
+{
+	bool locked;
+
+	if (fd < 0) {
+		return EBADF;
+	}
+
+	locked = filetable_lock(ft);
+	if ((unsigned)fd >= ft->ft_size ||
+	    (ft->ft_inuse[FT_WORD(fd)] & FT_BIT(fd)) == 0) {
+		filetable_unlock(ft, locked);
+		return EBADF;
+	}
+	*ret = ft->ft_files[fd];
+	fdesc_incref(*ret);
+	filetable_unlock(ft, locked);
+	return 0;
+}
+
+int
+filetable_place(struct filetable *ft, struct fdesc *file, int *fd)
+{
+	unsigned i, n;
+	bool locked;
+	int result;
+
+	locked = filetable_lock(ft);
+
+	for (i = FT_WORD(ft->ft_lowfree); i < FT_WORD(ft->ft_size); i++) {
+		if (ft->ft_inuse[i] != 0xffffffff) {
+			break;
+		}
+	}
+	if (i == FT_WORD(ft->ft_size)) {
+		if (ft->ft_size == OPEN_MAX) {
+			filetable_unlock(ft, locked);
+			return EMFILE;
+		}
+		result = filetable_grow(ft, ft->ft_size + 1);
+		if (result) {
+			filetable_unlock(ft, locked);
+			return result;
+		}
+	}
+
+	n = i * 32 + ffz(ft->ft_inuse[i]);
+	KASSERT(n < ft->ft_size);
+	KASSERT(ft->ft_files[n] == NULL);
+	ft->ft_inuse[i] |= FT_BIT(n);
+	ft->ft_files[n] = file;
+	/* N was the lowest free slot. */
+	ft->ft_lowfree = n + 1;
+
+	filetable_unlock(ft, locked);
+	*fd = n;
+	return 0;
+}
+
+int
+filetable_placeat(struct filetable *ft, struct fdesc *file, int fd,
+		  struct fdesc **oldfile)
+{
+	bool locked;
+	int result;
+
+	if (fd < 0 || fd >= OPEN_MAX) {
+		return EBADF;
+	}
+
+	locked = filetable_lock(ft);
+	if ((unsigned)fd >= ft->ft_size) {
+		result = filetable_grow(ft, fd + 1);
+		if (result) {
+			filetable_unlock(ft, locked);
+			return result;
+		}
+	}
+
+	*oldfile = ft->ft_files[fd];
+	ft->ft_inuse[FT_WORD(fd)] |= FT_BIT(fd);
+	ft->ft_files[fd] = file;
+
+	filetable_unlock(ft, locked);
+	return 0;
+}
+
+int
+filetable_remove(struct filetable *ft, int fd, struct fdesc **ret)
+{
+	bool locked;
+
+	if (fd < 0) {
+		return EBADF;
+	}
+
+	locked = filetable_lock(ft);
+	if ((unsigned)fd >= ft->ft_size ||
+	    (ft->ft_inuse[FT_WORD(fd)] & FT_BIT(fd)) == 0) {
+		filetable_unlock(ft, locked);
+		return EBADF;
+	}
+
+	*ret = ft->ft_files[fd];
+	ft->ft_files[fd] = NULL;
+	ft->ft_inuse[FT_WORD(fd)] &= ~FT_BIT(fd);
+	if ((unsigned)fd < ft->ft_lowfree) {
+		ft->ft_lowfree = fd;
+	}
+
+	filetable_unlock(ft, locked);
+	return 0;
+}
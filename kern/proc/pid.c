@@ -0,0 +1,404 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Process id allocation and lookup.
+ * The interface is documented in pid.h.
+ *
+ * In-use pids are kept in a bitmap. Allocation searches it from just
+ * after the last pid handed out, skipping full words 32 pids at a
+ * time, so the search is short unless the pid space is nearly full.
+ * Each pid has a record, found through a hash table, that outlives
+ * its process: when the process exits, the record keeps the exit
+ * status, and the rest of the process is freed. A record whose process
+ * has a parent is on one of two lists in the parent, p_children while
+ * the process runs and p_zombies once it has exited, so waitpid never
+ * has to look further than the caller's own children. The record also
+ * keeps the exited process's resource usage, for wait4 and for the
+ * parent's RUSAGE_CHILDREN. All of this is protected by pid_lock,
+ * which is never held for long.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <limits.h>
+#include <spinlock.h>
+#include <wchan.h>
+#include <kern/wait.h>
+#include <current.h>
+#include <proc.h>
+#include <pid.h>
+
+#define PID_NWORDS	((PID_MAX + 1 + 31) / 32)
+
+/* Size of the hash table; a power of two. */
+#define PID_HASHSIZE	256
+#define PID_HASH(pid)	((unsigned)(pid) & (PID_HASHSIZE - 1))
+
+struct pidrec {
+	pid_t pr_pid;
+	struct proc *pr_proc;		/* NULL once it has exited */
+	struct proc *pr_parent;		/* NULL if nobody will wait */
+	int pr_status;			/* Exit status, once exited */
+	struct usage pr_usage;		/* Resource usage, once exited */
+	struct pidrec *pr_hashnext;	/* Hash chain */
+	struct pidrec *pr_sibnext;	/* Parent's p_children or p_zombies */
+	struct pidrec **pr_sibprev;
+};
+
+static struct spinlock pid_lock = SPINLOCK_INITIALIZER_NAMED("pid");
+static uint32_t pid_inuse[PID_NWORDS];
+static unsigned pid_nfree;
+static pid_t pid_next;
+static struct pidrec *pid_hash[PID_HASHSIZE];
+
+void
+pid_bootstrap(void)
+{
+	pid_t pid;
+
+	/* Mark the ones below PID_MIN, and the slack past PID_MAX. */
+	for (pid = 0; pid < PID_MIN; pid++) {
+		pid_inuse[pid / 32] |= (uint32_t)1 << (pid % 32);
+	}
+	for (pid = PID_MAX + 1; pid < PID_NWORDS * 32; pid++) {
+		pid_inuse[pid / 32] |= (uint32_t)1 << (pid % 32);
+	}
+	pid_nfree = PID_MAX - PID_MIN + 1;
+	pid_next = PID_MIN;
+}
+
+/*
+ * Find a free pid at or after pid_next, wrapping around. There must
+ * be one. pid_lock must be held.
+ */
+static
+pid_t
+pid_find(void)
+{
+	unsigned word, n;
+	uint32_t bits;
+	pid_t pid;
+
+	KASSERT(spinlock_do_i_hold(&pid_lock));
+	KASSERT(pid_nfree > 0);
+
+	word = pid_next / 32;
+	/* Don't count the ones before pid_next in its own word. */
+	bits = pid_inuse[word] | (((uint32_t)1 << (pid_next % 32)) - 1);
+
+	for (n = 0; n <= PID_NWORDS; n++) {
+		if (bits != 0xffffffff) {
+			pid = word * 32;
+			while (bits & 1) {
+				bits >>= 1;
+				pid++;
+			}
+			return pid;
+		}
+		word = (word + 1) % PID_NWORDS;
+		bits = pid_inuse[word];
+	}
+	panic("pid_find: no free pid but pid_nfree is %u\n", pid_nfree);
+}
+
+/*
+ * Put PR on the front of a list of siblings, or take it off.
+ */
+static
+void
+pidrec_link(struct pidrec **head, struct pidrec *pr)
+{
+	pr->pr_sibnext = *head;
+	if (*head != NULL) {
+		(*head)->pr_sibprev = &pr->pr_sibnext;
+	}
+	pr->pr_sibprev = head;
+	*head = pr;
+}
+
+static
+void
+pidrec_unlink(struct pidrec *pr)
+{
+	*pr->pr_sibprev = pr->pr_sibnext;
+	if (pr->pr_sibnext != NULL) {
+		pr->pr_sibnext->pr_sibprev = pr->pr_sibprev;
+	}
+	pr->pr_sibnext = NULL;
+	pr->pr_sibprev = NULL;
+}
+
+/*
+ * Find the record for PID. pid_lock must be held.
+ */
+static
+struct pidrec *
+pidrec_lookup(pid_t pid)
+{
+	struct pidrec *pr;
+
+	KASSERT(spinlock_do_i_hold(&pid_lock));
+
+	for (pr = pid_hash[PID_HASH(pid)]; pr != NULL; pr = pr->pr_hashnext) {
+		if (pr->pr_pid == pid) {
+			break;
+		}
+	}
+	return pr;
+}
+
+/*
+ * Take PR out of the hash table and give back its pid. The caller
+ * frees PR, after letting go of pid_lock.
+ */
+static
+void
+pidrec_release(struct pidrec *pr)
+{
+	struct pidrec **pp;
+	pid_t pid = pr->pr_pid;
+
+	KASSERT(spinlock_do_i_hold(&pid_lock));
+	KASSERT(pid >= PID_MIN && pid <= PID_MAX);
+
+	for (pp = &pid_hash[PID_HASH(pid)]; *pp != pr;
+	     pp = &(*pp)->pr_hashnext) {
+		KASSERT(*pp != NULL);
+	}
+	*pp = pr->pr_hashnext;
+	pr->pr_hashnext = NULL;
+
+	KASSERT(pid_inuse[pid / 32] & ((uint32_t)1 << (pid % 32)));
+	pid_inuse[pid / 32] &= ~((uint32_t)1 << (pid % 32));
+	pid_nfree++;
+}
+
+int
+pid_alloc(struct proc *proc, struct proc *parent)
+{
+	struct pidrec *pr;
+	pid_t pid;
+	unsigned h;
+
+	pr = kmalloc(sizeof(*pr));
+	if (pr == NULL) {
+		return ENOMEM;
+	}
+
+	spinlock_acquire(&pid_lock);
+	if (pid_nfree == 0) {
+		spinlock_release(&pid_lock);
+		kfree(pr);
+		return ENPROC;
+	}
+
+	pid = pid_find();
+	KASSERT(pid >= PID_MIN && pid <= PID_MAX);
+	pid_inuse[pid / 32] |= (uint32_t)1 << (pid % 32);
+	pid_nfree--;
+	pid_next = (pid == PID_MAX) ? PID_MIN : pid + 1;
+
+	pr->pr_pid = pid;
+	pr->pr_proc = proc;
+	pr->pr_parent = parent;
+	pr->pr_status = 0;
+	h = PID_HASH(pid);
+	pr->pr_hashnext = pid_hash[h];
+	pid_hash[h] = pr;
+	if (parent != NULL) {
+		pidrec_link(&parent->p_children, pr);
+	}
+	else {
+		pr->pr_sibnext = NULL;
+		pr->pr_sibprev = NULL;
+	}
+
+	proc->p_pid = pid;
+	proc->p_pidrec = pr;
+
+	spinlock_release(&pid_lock);
+	return 0;
+}
+
+void
+pid_free(struct proc *proc)
+{
+	struct pidrec *pr = proc->p_pidrec;
+
+	KASSERT(pr != NULL);
+
+	spinlock_acquire(&pid_lock);
+	KASSERT(pr->pr_proc == proc);
+	if (pr->pr_parent != NULL) {
+		pidrec_unlink(pr);
+	}
+	pidrec_release(pr);
+	spinlock_release(&pid_lock);
+
+	kfree(pr);
+	proc->p_pidrec = NULL;
+	proc->p_pid = 0;
+}
+
+void
+pid_exit(struct proc *proc, int status)
+{
+	struct pidrec *pr = proc->p_pidrec;
+	struct pidrec *dead, *c;
+	struct proc *parent;
+
+	KASSERT(pr != NULL);
+
+	spinlock_acquire(&pid_lock);
+	KASSERT(pr->pr_proc == proc);
+
+	/* Our children are on their own now. */
+	while (proc->p_children != NULL) {
+		c = proc->p_children;
+		pidrec_unlink(c);
+		c->pr_parent = NULL;
+	}
+
+	/* And nobody will collect the ones that already exited. */
+	dead = proc->p_zombies;
+	proc->p_zombies = NULL;
+	for (c = dead; c != NULL; c = c->pr_sibnext) {
+		pidrec_release(c);
+	}
+
+	/* No threads are left to change these, so no need for p_lock */
+	pr->pr_usage = proc->p_usage;
+	usage_add(&pr->pr_usage, &proc->p_cusage);
+
+	pr->pr_proc = NULL;
+	pr->pr_status = status;
+	parent = pr->pr_parent;
+	if (parent != NULL) {
+		pidrec_unlink(pr);
+		pidrec_link(&parent->p_zombies, pr);
+		wchan_wakeall(parent->p_waitchan, &pid_lock);
+	}
+	else {
+		pidrec_release(pr);
+		pr->pr_sibnext = dead;
+		dead = pr;
+	}
+	spinlock_release(&pid_lock);
+
+	while (dead != NULL) {
+		c = dead;
+		dead = c->pr_sibnext;
+		kfree(c);
+	}
+
+	proc->p_pidrec = NULL;
+	proc->p_pid = 0;
+}
+
+int
+pid_wait(pid_t pid, int options, int *status, struct usage *usage,
+	 pid_t *ret)
+{
+	struct proc *proc = curproc;
+	struct pidrec *pr;
+
+	if (pid != WAIT_ANY && (pid < PID_MIN || pid > PID_MAX)) {
+		return ESRCH;
+	}
+
+	spinlock_acquire(&pid_lock);
+	while (1) {
+		if (pid == WAIT_ANY) {
+			pr = proc->p_zombies;
+			if (pr != NULL) {
+				break;
+			}
+			if (proc->p_children == NULL) {
+				spinlock_release(&pid_lock);
+				return ECHILD;
+			}
+		}
+		else {
+			pr = pidrec_lookup(pid);
+			if (pr == NULL) {
+				spinlock_release(&pid_lock);
+				return ESRCH;
+			}
+			if (pr->pr_parent != proc) {
+				spinlock_release(&pid_lock);
+				return ECHILD;
+			}
+			if (pr->pr_proc == NULL) {
+				break;
+			}
+		}
+
+		if (options & WNOHANG) {
+			spinlock_release(&pid_lock);
+			*ret = 0;
+			return 0;
+		}
+		wchan_sleep(proc->p_waitchan, &pid_lock);
+	}
+
+	pidrec_unlink(pr);
+	pidrec_release(pr);
+	spinlock_release(&pid_lock);
+
+	spinlock_acquire(&proc->p_lock);
+	usage_add(&proc->p_cusage, &pr->pr_usage);
+	spinlock_release(&proc->p_lock);
+
+	*status = pr->pr_status;
+	if (usage != NULL) {
+		*usage = pr->pr_usage;
+	}
+	*ret = pr->pr_pid;
+	kfree(pr);
+	return 0;
+}
+
+struct proc *
+pid_lookup(pid_t pid)
+{
+	struct pidrec *pr;
+	struct proc *proc;
+
+	if (pid < PID_MIN || pid > PID_MAX) {
+		return NULL;
+	}
+
+	spinlock_acquire(&pid_lock);
+	pr = pidrec_lookup(pid);
+	proc = pr != NULL ? pr->pr_proc : NULL;
+	spinlock_release(&pid_lock);
+	return proc;
+}
@@ -43,58 +43,36 @@
  */
 
 #include <types.h>
+#include <kern/wait.h>
 #include <spl.h>
 #include <proc.h>
 #include <current.h>
+#include <wchan.h>
 #include <addrspace.h>
 #include <vnode.h>
-
-struct proc *proc_list[MAX_PROCESSES];
-struct lock *lk_proc_list;
+#include <filetable.h>
+#include <pid.h>
+#include <ring.h>
+#include <syscall.h>
 
 /*
- * Allocate a PID
+ * The process for the kernel; this holds all the kernel-only threads.
  */
-int
-pid_allocate(struct proc *proc) {
-
-
-	lock_acquire(lk_proc_list);
-
-	for (int i = 1; i <= MAX_PROCESSES; i++) {
-		if (proc_list[i] != NULL) {
-			proc->p_pid = i;
-			lock_release(lk_proc_list);
-			return 0;
-		}
-	}
-
-	// PID allocation failed
-	lock_release(lk_proc_list);
-	return -1;
-
-}
-
+struct proc *kproc;
 
+/*
+ * Workqueue entry point for proc_destroy_deferred.
+ */
+static
 void
-proc_startup() {
-
-	lk_proc_list = lock_create("proc_list_lk");
-	if (lk_proc_list == NULL) {
-		panic("proc_list_lk creation failed!");
-	}
-
-	memset(proc_list, 0, sizeof(proc_list));
+proc_destroy_work(void *data1, unsigned long data2)
+{
+	struct proc *proc = data1;
 
+	(void)data2;
+	proc_destroy(proc);
 }
 
-
-
-/*
- * The process for the kernel; this holds all the kernel-only threads.
- */
-struct proc *kproc;
-
 /*
  * Create a proc structure.
  */
@@ -113,14 +91,51 @@ proc_create(const char *name)
 		return NULL;
 	}
 
-	//proc->p_mutex = lock_create(name);
-	//if (proc->p_mutex == NULL) {
-	//	kfree(proc);
-	//	return NULL;
-	//}
+	proc->p_thlock = lock_create(name);
+	if (proc->p_thlock == NULL) {
+		kfree(proc->p_name);
+		kfree(proc);
+		return NULL;
+	}
+	proc->p_thcv = cv_create(name);
+	if (proc->p_thcv == NULL) {
+		lock_destroy(proc->p_thlock);
+		kfree(proc->p_name);
+		kfree(proc);
+		return NULL;
+	}
+	proc->p_waitchan = wchan_create(name);
+	if (proc->p_waitchan == NULL) {
+		cv_destroy(proc->p_thcv);
+		lock_destroy(proc->p_thlock);
+		kfree(proc->p_name);
+		kfree(proc);
+		return NULL;
+	}
+	proc->p_ftable = filetable_create();
+	if (proc->p_ftable == NULL) {
+		wchan_destroy(proc->p_waitchan);
+		cv_destroy(proc->p_thcv);
+		lock_destroy(proc->p_thlock);
+		kfree(proc->p_name);
+		kfree(proc);
+		return NULL;
+	}
 
 	proc->p_numthreads = 0;
 	spinlock_init(&proc->p_lock);
+	proc->p_pid = 0;
+	proc->p_pidrec = NULL;
+	proc->p_children = NULL;
+	proc->p_zombies = NULL;
+	proc->p_exitstatus = _MKWAIT_EXIT(0);
+	proc->p_exiting = false;
+	bzero(&proc->p_usage, sizeof(proc->p_usage));
+	bzero(&proc->p_cusage, sizeof(proc->p_cusage));
+
+	/* User threads */
+	proc->p_uthreads = NULL;
+	proc->p_nexttid = 1;
 
 	/* VM fields */
 	proc->p_addrspace = NULL;
@@ -128,14 +143,20 @@ proc_create(const char *name)
 	/* VFS fields */
 	proc->p_cwd = NULL;
 
+	proc->p_ring = NULL;
+
+	/* Queued by proc_destroy_deferred */
+	work_init(&proc->p_destroywork, proc_destroy_work, proc, 0);
+
 	return proc;
 }
 
 /*
  * Destroy a proc structure.
  *
- * Note: nothing currently calls this. Your wait/exit code will
- * probably want to do so.
+ * This is for a process that never ran, or (through proc_exit) one
+ * that has exited; either way its pid record has been dealt with
+ * separately, so nothing here has to wait for the parent.
  */
 void
 proc_destroy(struct proc *proc)
@@ -158,6 +179,8 @@ proc_destroy(struct proc *proc)
 	 */
 
 	/* VFS fields */
+	filetable_destroy(proc->p_ftable);
+	proc->p_ftable = NULL;
 	if (proc->p_cwd) {
 		VOP_DECREF(proc->p_cwd);
 		proc->p_cwd = NULL;
@@ -208,25 +231,119 @@ proc_destroy(struct proc *proc)
 			as = proc->p_addrspace;
 			proc->p_addrspace = NULL;
 		}
-		as_destroy(as);
+		/* Threads that ran in it may still hold references. */
+		as_decref(as);
+	}
+
+	/* Records of threads nobody joined */
+	while (proc->p_uthreads != NULL) {
+		struct uthread *ut = proc->p_uthreads;
+
+		proc->p_uthreads = ut->ut_next;
+		kfree(ut);
+	}
+
+	if (proc->p_ring != NULL) {
+		ring_destroy(proc->p_ring);
+		proc->p_ring = NULL;
+	}
+
+	if (proc->p_pidrec != NULL) {
+		pid_free(proc);
 	}
+	KASSERT(proc->p_children == NULL);
+	KASSERT(proc->p_zombies == NULL);
 
 	KASSERT(proc->p_numthreads == 0);
+	work_cleanup(&proc->p_destroywork);
 	spinlock_cleanup(&proc->p_lock);
-	lock_destroy(proc->p_mutex);
-	
-	proc_list[proc->p_pid] = NULL;
+	wchan_destroy(proc->p_waitchan);
+	cv_destroy(proc->p_thcv);
+	lock_destroy(proc->p_thlock);
 
 	kfree(proc->p_name);
 	kfree(proc);
 }
 
+/*
+ * Hand a finished process to the current cpu's workqueue to be
+ * destroyed. Tearing down the address space and dropping the cwd
+ * vnode can be slow; this lets an exiting process get out of the way
+ * (and its parent get its status) without waiting for that.
+ *
+ * The same rules apply as for proc_destroy: the caller must have the
+ * only reference and the process must have no threads left. It must
+ * also not be curproc, since the teardown happens on another thread.
+ */
+void
+proc_destroy_deferred(struct proc *proc)
+{
+	KASSERT(proc != NULL);
+	KASSERT(proc != kproc);
+	KASSERT(proc != curproc);
+	KASSERT(proc->p_numthreads == 0);
+
+	work_queue(&proc->p_destroywork);
+}
+
+/*
+ * Called from thread_exit when the last thread of PROC has left it.
+ *
+ * The exit status goes into PROC's pid record, where the parent can
+ * collect it, and the rest of the process is destroyed now rather
+ * than when the parent gets around to waiting.
+ */
+void
+proc_exit(struct proc *proc)
+{
+	KASSERT(proc->p_numthreads == 0);
+
+	if (proc->p_pidrec != NULL) {
+		pid_exit(proc, proc->p_exitstatus);
+	}
+	proc_destroy_deferred(proc);
+}
+
+/*
+ * Start ending PROC, from _exit or a fatal fault in one of its
+ * threads. The first caller's STATUS is the one the parent sees; the
+ * calling thread goes on to exit itself, and the other threads end
+ * when they next head back to user mode (see mips_trap). Threads
+ * asleep in threadjoin or on a futex are woken so they get there;
+ * a thread asleep elsewhere goes when its sleep ends.
+ */
+void
+proc_setexiting(struct proc *proc, int status)
+{
+	bool first;
+
+	spinlock_acquire(&proc->p_lock);
+	first = !proc->p_exiting;
+	if (first) {
+		proc->p_exiting = true;
+		proc->p_exitstatus = status;
+	}
+	spinlock_release(&proc->p_lock);
+
+	if (!first) {
+		return;
+	}
+
+	lock_acquire(proc->p_thlock);
+	cv_broadcast(proc->p_thcv, proc->p_thlock);
+	lock_release(proc->p_thlock);
+
+	futex_wakeproc(proc);
+}
+
 /*
  * Create the process structure for the kernel.
  */
 void
 proc_bootstrap(void)
 {
+	pid_bootstrap();
+
 	kproc = proc_create("[kernel]");
 	if (kproc == NULL) {
 		panic("proc_create for kproc failed\n");
@@ -237,10 +354,11 @@ proc_bootstrap(void)
  * Create a fresh proc for use by runprogram.
  *
  * It will have no address space and will inherit the current
- * process's (that is, the kernel menu's) current directory.
+ * process's (the kernel menu's, or spawn's caller's) current
+ * directory. PARENT is the process that will wait for it, if any.
  */
 struct proc *
-proc_create_runprogram(const char *name)
+proc_create_runprogram(const char *name, struct proc *parent)
 {
 	struct proc *newproc;
 
@@ -249,6 +367,11 @@ proc_create_runprogram(const char *name)
 		return NULL;
 	}
 
+	if (pid_alloc(newproc, parent)) {
+		proc_destroy(newproc);
+		return NULL;
+	}
+
 	/* VM fields */
 
 	newproc->p_addrspace = NULL;
@@ -305,33 +428,47 @@ proc_addthread(struct proc *proc, struct thread *t)
  * case it's current, to protect against the as_activate call in
  * the timer interrupt context switch, and any other implicit uses
  * of "curproc".
+ *
+ * Returns true if T was the last thread in the process.
  */
-void
+bool
 proc_remthread(struct thread *t)
 {
 	struct proc *proc;
+	bool last;
 	int spl;
 
 	proc = t->t_proc;
 	KASSERT(proc != NULL);
 
+	/* Hand over T's usage; whatever it does from now on isn't ours */
+	if (t == curthread) {
+		usage_charge(t, false);
+	}
+
 	spinlock_acquire(&proc->p_lock);
 	KASSERT(proc->p_numthreads > 0);
 	proc->p_numthreads--;
+	last = proc->p_numthreads == 0;
+	usage_add(&proc->p_usage, &t->t_usage);
 	spinlock_release(&proc->p_lock);
+	bzero(&t->t_usage, sizeof(t->t_usage));
 
 	spl = splhigh();
 	t->t_proc = NULL;
 	splx(spl);
+
+	return last;
 }
 
 /*
  * Fetch the address space of (the current) process.
  *
- * Caution: address spaces aren't refcounted. If you implement
- * multithreaded processes, make sure to set up a refcount scheme or
- * some other method to make this safe. Otherwise the returned address
- * space might disappear under you.
+ * No reference is taken. That's safe for a thread using the address
+ * space it's running in: the process holds a reference until it is
+ * destroyed, and each thread started with threadfork holds one until
+ * it exits (see thread_syscalls.c). Anything keeping the pointer
+ * beyond that should take its own reference with as_incref.
  */
 struct addrspace *
 proc_getas(void)
@@ -352,6 +489,10 @@ proc_getas(void)
 /*
  * Change the address space of (the current) process. Return the old
  * one for later restoration or disposal.
+ *
+ * The process's reference goes with the pointer: the caller's
+ * reference to NEWAS becomes the process's, and the process's
+ * reference to the old one is handed back to the caller.
  */
 struct addrspace *
 proc_setas(struct addrspace *newas)
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Resource usage accounting.
+ * The interface is documented in usage.h.
+ */
+
+#include <types.h>
+#include <kern/time.h>
+#include <kern/resource.h>
+#include <lib.h>
+#include <spl.h>
+#include <clock.h>
+#include <current.h>
+#include <thread.h>
+#include <proc.h>
+#include <usage.h>
+
+void
+usage_charge(struct thread *t, bool user)
+{
+	uint64_t now;
+	int spl;
+
+	/* At splhigh, so a context switch can't charge the same cycles. */
+	spl = splhigh();
+	now = cpu_cycles();
+	if (now > t->t_usagestamp) {
+		if (user) {
+			t->t_usage.u_utime += now - t->t_usagestamp;
+		}
+		else {
+			t->t_usage.u_stime += now - t->t_usagestamp;
+		}
+	}
+	t->t_usagestamp = now;
+	splx(spl);
+}
+
+void
+usage_stamp(struct thread *t)
+{
+	t->t_usagestamp = cpu_cycles();
+}
+
+void
+usage_add(struct usage *to, const struct usage *from)
+{
+	to->u_utime += from->u_utime;
+	to->u_stime += from->u_stime;
+	to->u_minflt += from->u_minflt;
+	to->u_majflt += from->u_majflt;
+	to->u_inblock += from->u_inblock;
+	to->u_oublock += from->u_oublock;
+	to->u_nvcsw += from->u_nvcsw;
+	to->u_nivcsw += from->u_nivcsw;
+}
+
+void
+usage_self(struct usage *ret)
+{
+	struct proc *proc = curproc;
+
+	/* Bring our own system time up to now. */
+	usage_charge(curthread, false);
+
+	spinlock_acquire(&proc->p_lock);
+	*ret = proc->p_usage;
+	spinlock_release(&proc->p_lock);
+
+	usage_add(ret, &curthread->t_usage);
+}
+
+void
+usage_children(struct usage *ret)
+{
+	struct proc *proc = curproc;
+
+	spinlock_acquire(&proc->p_lock);
+	*ret = proc->p_cusage;
+	spinlock_release(&proc->p_lock);
+}
+
+/*
+ * Convert CYCLES to a timeval, truncating.
+ */
+static
+void
+usage_cyclestv(uint64_t cycles, struct timeval *ret)
+{
+	struct timespec ts;
+
+	cpu_cyclestime(cycles, &ts);
+	ret->tv_sec = ts.tv_sec;
+	ret->tv_usec = ts.tv_nsec / 1000;
+}
+
+void
+usage_export(const struct usage *u, struct rusage *ret)
+{
+	/* Memory sizes, swaps, messages and signals aren't kept. */
+	bzero(ret, sizeof(*ret));
+	usage_cyclestv(u->u_utime, &ret->ru_utime);
+	usage_cyclestv(u->u_stime, &ret->ru_stime);
+	ret->ru_minflt = u->u_minflt;
+	ret->ru_majflt = u->u_majflt;
+	ret->ru_inblock = u->u_inblock;
+	ret->ru_oublock = u->u_oublock;
+	ret->ru_nvcsw = u->u_nvcsw;
+	ret->ru_nivcsw = u->u_nivcsw;
+}
@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Copying program arguments into the kernel and out onto a new
+ * program's stack. See execargs.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <copyinout.h>
+#include <execargs.h>
+
+/* argv entries per page */
+#define PTRSPERPAGE (PAGE_SIZE / sizeof(userptr_t))
+
+/*
+ * Pages not in use by anyone's arguments right now, linked through
+ * their first word. One exec at full ARG_MAX needs at most
+ * EA_MAXPAGES + 1 pages, strings and argv together (the total is
+ * what's limited); enough are kept for two of them at once without
+ * going to alloc_kpages. Beyond that they're given back.
+ */
+#define ARGPOOL_MAX (2 * (EA_MAXPAGES + 1))
+
+static struct spinlock argpool_lock = SPINLOCK_INITIALIZER;
+static vaddr_t argpool_head;
+static unsigned argpool_count;
+
+static
+vaddr_t
+argpage_get(void)
+{
+	vaddr_t page;
+
+	spinlock_acquire(&argpool_lock);
+	page = argpool_head;
+	if (page != 0) {
+		argpool_head = *(vaddr_t *)page;
+		argpool_count--;
+	}
+	spinlock_release(&argpool_lock);
+
+	if (page == 0) {
+		page = alloc_kpages(1);
+	}
+	return page;
+}
+
+static
+void
+argpage_put(vaddr_t page)
+{
+	spinlock_acquire(&argpool_lock);
+	if (argpool_count < ARGPOOL_MAX) {
+		*(vaddr_t *)page = argpool_head;
+		argpool_head = page;
+		argpool_count++;
+		page = 0;
+	}
+	spinlock_release(&argpool_lock);
+
+	if (page != 0) {
+		free_kpages(page);
+	}
+}
+
+/*
+ * Append the user string USTR to the strings, starting a new page
+ * whenever the current one fills up, using at most AVAIL bytes.
+ */
+static
+int
+execargs_addstr(struct execargs *ea, userptr_t ustr, size_t avail)
+{
+	size_t off, space, got, done;
+	char *page;
+	int result;
+
+	for (done = 0; ; done += space) {
+		off = ea->ea_strsize % PAGE_SIZE;
+		if (off == 0 && ea->ea_strsize / PAGE_SIZE == ea->ea_nstrpages) {
+			KASSERT(ea->ea_nstrpages < EA_MAXPAGES);
+			ea->ea_strpages[ea->ea_nstrpages] = argpage_get();
+			if (ea->ea_strpages[ea->ea_nstrpages] == 0) {
+				return ENOMEM;
+			}
+			ea->ea_nstrpages++;
+		}
+		page = (char *)ea->ea_strpages[ea->ea_strsize / PAGE_SIZE];
+
+		space = PAGE_SIZE - off;
+		if (space > avail - done) {
+			space = avail - done;
+		}
+		if (space == 0) {
+			return E2BIG;
+		}
+
+		// A string that runs off the page is continued on the next
+		result = copyinstr(ustr + done, page + off, space, &got);
+		if (result == 0) {
+			ea->ea_strsize += got;
+			return 0;
+		}
+		if (result != ENAMETOOLONG) {
+			return result;
+		}
+		ea->ea_strsize += space;
+	}
+}
+
+int
+execargs_copyin(struct execargs *ea, userptr_t uargv)
+{
+	userptr_t *ptrs;
+	vaddr_t uaddr;
+	size_t used, off, n, j, slot;
+	unsigned i;
+	int result;
+
+	ea->ea_argc = 0;
+	ea->ea_strsize = 0;
+	ea->ea_nstrpages = 0;
+	ea->ea_nptrpages = 0;
+
+	/*
+	 * The user's argv goes straight into our argv pages, as much
+	 * at a time as fits in both the page and what's left of the
+	 * user page it's on (so we don't fault past the end of it).
+	 * Then each pointer is replaced by where its string went.
+	 */
+	for (i = 0; ; ) {
+		slot = i % PTRSPERPAGE;
+		if (slot == 0) {
+			if (ea->ea_nptrpages == EA_MAXPAGES) {
+				return E2BIG;
+			}
+			ea->ea_ptrpages[ea->ea_nptrpages] = argpage_get();
+			if (ea->ea_ptrpages[ea->ea_nptrpages] == 0) {
+				return ENOMEM;
+			}
+			ea->ea_nptrpages++;
+		}
+		ptrs = (userptr_t *)ea->ea_ptrpages[i / PTRSPERPAGE];
+
+		uaddr = (vaddr_t)uargv + i * sizeof(userptr_t);
+		n = (PAGE_SIZE - uaddr % PAGE_SIZE) / sizeof(userptr_t);
+		if (n == 0) {
+			n = 1;
+		}
+		if (n > PTRSPERPAGE - slot) {
+			n = PTRSPERPAGE - slot;
+		}
+		result = copyin((const_userptr_t)uaddr, &ptrs[slot],
+				n * sizeof(userptr_t));
+		if (result) {
+			return result;
+		}
+
+		for (j = slot; j < slot + n; j++, i++) {
+			if (ptrs[j] == NULL) {
+				return 0;
+			}
+
+			// Room for this pointer and the NULL after it
+			used = ea->ea_strsize + (i + 2) * sizeof(userptr_t);
+			if (used > ARG_MAX) {
+				return E2BIG;
+			}
+
+			// Offsets for now; see execargs_copyout
+			off = ea->ea_strsize;
+			result = execargs_addstr(ea, ptrs[j], ARG_MAX - used);
+			if (result) {
+				return result;
+			}
+			ptrs[j] = (userptr_t)off;
+			ea->ea_argc++;
+		}
+	}
+}
+
+int
+execargs_copyout(struct execargs *ea, vaddr_t *stackptr, userptr_t *uargv)
+{
+	userptr_t *ptrs;
+	vaddr_t strbase, argvbase;
+	size_t nptrs, done, len, j;
+	unsigned p;
+	int result;
+
+	// argv goes below the strings, 8-byte aligned for the stack
+	nptrs = ea->ea_argc + 1;
+	strbase = *stackptr - ea->ea_strsize;
+	argvbase = (strbase - nptrs * sizeof(userptr_t)) & ~(vaddr_t)7;
+
+	for (p = 0, done = 0; done < ea->ea_strsize; p++, done += len) {
+		len = ea->ea_strsize - done;
+		if (len > PAGE_SIZE) {
+			len = PAGE_SIZE;
+		}
+		result = copyout((const void *)ea->ea_strpages[p],
+				 (userptr_t)(strbase + done), len);
+		if (result) {
+			return result;
+		}
+	}
+
+	for (p = 0, done = 0; done < nptrs; p++, done += len) {
+		len = nptrs - done;
+		if (len > PTRSPERPAGE) {
+			len = PTRSPERPAGE;
+		}
+		ptrs = (userptr_t *)ea->ea_ptrpages[p];
+		for (j = 0; j < len && done + j < (size_t)ea->ea_argc; j++) {
+			ptrs[j] = (userptr_t)(strbase + (vaddr_t)ptrs[j]);
+		}
+		result = copyout(ptrs,
+				 (userptr_t)(argvbase + done * sizeof(userptr_t)),
+				 len * sizeof(userptr_t));
+		if (result) {
+			return result;
+		}
+	}
+
+	*uargv = (userptr_t)argvbase;
+	*stackptr = argvbase;
+	return 0;
+}
+
+void
+execargs_cleanup(struct execargs *ea)
+{
+	unsigned i;
+
+	for (i = 0; i < ea->ea_nstrpages; i++) {
+		argpage_put(ea->ea_strpages[i]);
+	}
+	for (i = 0; i < ea->ea_nptrpages; i++) {
+		argpage_put(ea->ea_ptrpages[i]);
+	}
+	ea->ea_nstrpages = 0;
+	ea->ea_nptrpages = 0;
+	ea->ea_argc = 0;
+}
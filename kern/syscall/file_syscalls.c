@@ -14,14 +14,17 @@
 #include <proc.h>
 #include <kern/stat.h>
 #include <kern/seek.h>
+#include <kern/fdesc.h>
+#include <filetable.h>
+#include <pipe.h>
 
 
 int
 sys_open(const_userptr_t filename, int flags, int *retval) {
 
 	struct stat st;
-	struct fdesc *fd = kmalloc(sizeof(struct fdesc));
-	struct vnode *vn = kmalloc(sizeof(struct vnode));
+	struct fdesc *fd;
+	struct vnode *vn;
 	const char *safe_filename[NAME_MAX];
 	
 	int result = 0;
@@ -54,58 +57,36 @@ sys_open(const_userptr_t filename, int flags, int *retval) {
 		return result;
 	}
 
-	// Traverse current thread's filetable and check availability
-	for (int i = 3; i <= OPEN_MAX; i++) {
-		if (curthread->t_ftable[i] == NULL) {
-			fd_index = i;
-			break;
-		}
-	}
-	if (fd_index < 0) {
-		return EMFILE;	
-	}
-	
 	// Open file
 	result = vfs_open((char *)safe_filename, flags, 0, &vn);
 	if (result != 0) {
-		// Do I need to close this file? 
-		// At this point, I don't think so as the vfs_open function
-		// cleans up any shenanigans. vfs_close(vn);
-		curthread->t_ftable[fd_index] = NULL;
 		return result;
 	}
 
 	// TODO these error return values need to be aligned with  the required
 	// values from the MAN page
-	result = fdesc_init(fd, (char *)safe_filename, vn, flags);
-	
-	if (result != 0) {
-		return result;
-	}
-
-	// TODO fix the locking, will probably involve flocks or something similar
-	// Enter critical section
-	lock_acquire(fd->lk);
-
-	result =	VOP_STAT(fd->vn, &st);
-
-	if (result != 0) {
-		return result;
+	fd = fdesc_create((char *)safe_filename, vn, flags);
+	if (fd == NULL) {
+		vfs_close(vn);
+		return ENOMEM;
 	}
 
+	// Nobody else can see fd yet, so no need to lock it
 	if (flags & O_APPEND) {
+		result = VOP_STAT(fd->vn, &st);
+		if (result != 0) {
+			fdesc_decref(fd);
+			return result;
+		}
 		fd->ofst = st.st_size;
 	}
-	else {
-		fd->ofst = 0;
-	}
 
-	VOP_INCREF(fd->vn);
-	fd->refnum++;
-
-	// TODO I need to probably implement flocks, because this
-	// locking and unlocking with only a regular lock seems sucky
-	lock_release(fd->lk);
+	// Give it the lowest free descriptor; the table takes our reference
+	result = filetable_place(curproc->p_ftable, fd, &fd_index);
+	if (result != 0) {
+		fdesc_decref(fd);
+		return result;
+	}
 
 	*retval = fd_index;
 
@@ -116,225 +97,476 @@ sys_open(const_userptr_t filename, int flags, int *retval) {
 int
 sys_close(int close_fd) {
 
-	struct fdesc *fd = NULL;
+	struct fdesc *fd;
+	int result;
 
-	if (curthread->t_ftable[close_fd] != NULL) {
-		fd = curthread->t_ftable[close_fd];
-	}
-	else {
-		return EBADF;
+	result = filetable_remove(curproc->p_ftable, close_fd, &fd);
+	if (result != 0) {
+		return result;
 	}
 
-	lock_acquire(fd->lk);
-	
-	VOP_DECREF(fd->vn);
-	fd->refnum--;
-
-	vfs_close(fd->vn);
-
-	fdesc_destroy(fd);
-
-	lock_release(fd->lk);
+	// Closes the file if this was the last descriptor for it
+	fdesc_decref(fd);
 
 	return 0;
 }
 
 
-ssize_t
-sys_read(int read_fd, userptr_t buf, size_t buflen, ssize_t *retval) {
+/*
+ * Look up descriptor FDNUM for reading or writing (RW), and check
+ * that it was opened for that. Returns a reference in *RET.
+ */
+static
+int
+file_get(int fdnum, enum uio_rw rw, struct fdesc **ret) {
 	struct fdesc *fd;
-	struct iovec iov;
-	struct uio u;
 	int result;
-	struct addrspace *as;
-	void *safe_buf = kmalloc(sizeof(size_t));
-
-	as = proc_getas();
 
 	// Check for valid filetable entry
-	if (curthread->t_ftable[read_fd] != NULL) {
-		fd = curthread->t_ftable[read_fd];
-	}
-	else {
-		return EBADF;
+	result = filetable_get(curproc->p_ftable, fdnum, &fd);
+	if (result != 0) {
+		return result;
 	}
-	
 
 	// Check read/write flags
-	if ((fd->openflags & O_ACCMODE) == O_WRONLY) {
+	if ((fd->openflags & O_ACCMODE) ==
+	    (rw == UIO_READ ? O_WRONLY : O_RDONLY)) {
+		fdesc_decref(fd);
 		return EBADF;
 	}
 
-	// Clean buffer pointer
-	result = copyin((userptr_t)buf, safe_buf, buflen);
+	*ret = fd;
+	return 0;
+}
 
-	if (result != 0) {
-		return result;
+/*
+ * Do the transfer described by U on open file FD. U's offset is
+ * filled in here; on return its resid says how much wasn't moved.
+ *
+ * If POS is NULL, the transfer happens at (and moves) the file's
+ * shared seek position. Otherwise it happens at *POS, and the seek
+ * position isn't looked at or touched at all; that's pread/pwrite.
+ */
+static
+int
+file_io(struct fdesc *fd, struct uio *u, const off_t *pos) {
+	struct stat st;
+	size_t len = u->uio_resid;
+	off_t start;
+	int result;
+
+	if (pos != NULL) {
+		// Positional I/O only makes sense on something seekable
+		if (!fd->seekable) {
+			return ESPIPE;
+		}
+		if (*pos < 0) {
+			return EINVAL;
+		}
+		start = *pos;
 	}
+	else {
+		// O_APPEND writes go at the end, wherever that is now.
+		// (Two appenders can still both find the same end.)
+		if (u->uio_rw == UIO_WRITE && (fd->openflags & O_APPEND)) {
+			result = VOP_STAT(fd->vn, &st);
+			if (result == 0) {
+				result = fdesc_seek(fd, 0, SEEK_END,
+						    st.st_size, &start);
+			}
+			if (result != 0 && result != ESPIPE) {
+				return result;
+			}
+		}
 
+		// Claim our part of the file
+		start = fdesc_advance(fd, len);
+	}
+	u->uio_offset = start;
 
-	// Initialize iovec and uio for reading
-	iov.iov_ubase = safe_buf;
-	iov.iov_len = buflen;
-	u.uio_iov = &iov;			/* Data blocks */
-	u.uio_iovcnt = 1;	/* Number of iovecs */
-	u.uio_offset = fd->ofst;	/* Desired offset into object */
-	u.uio_resid = buflen;	/* Remaining amt of data to xfer */
-	u.uio_segflg = UIO_USERSPACE;	/* What kind of pointer we have */
-	u.uio_rw = UIO_READ;	/* Whether op is a read or write */
-	u.uio_space = as;	/* Address space for user pointer */
+	if (u->uio_rw == UIO_READ) {
+		result = VOP_READ(fd->vn, u);
+	}
+	else {
+		result = VOP_WRITE(fd->vn, u);
+	}
 
+	if (pos == NULL) {
+		// Give back whatever we didn't transfer (e.g. past EOF)
+		fdesc_retreat(fd, start, len, len - u->uio_resid);
+	}
 
-	lock_acquire(fd->lk);
+	return result;
+}
 
-	// Read file
-	result = VOP_READ(fd->vn, &u);
+/*
+ * Common code for read, write, readv, writev, pread, and pwrite: do
+ * the transfer described by U on descriptor FDNUM, at POS as for
+ * file_io, and return the number of bytes moved in *RETVAL.
+ */
+static
+int
+file_rw(int fdnum, struct uio *u, const off_t *pos, ssize_t *retval) {
+	struct fdesc *fd;
+	size_t len = u->uio_resid;
+	int result;
 
+	result = file_get(fdnum, u->uio_rw, &fd);
 	if (result != 0) {
-		lock_release(fd->lk);
 		return result;
 	}
 
-	ssize_t num_bytes = 0;
-	ssize_t available_bytes = u.uio_offset - fd->ofst;
-	fd->ofst = u.uio_offset; 
-
-	if (available_bytes > 0) {
-		num_bytes = buflen;
-	}
-	else if (available_bytes == 0) {
-		num_bytes = 0;
-	}
-	else {
-		num_bytes = available_bytes * -1;
+	result = file_io(fd, u, pos);
+	fdesc_decref(fd);
+	if (result != 0) {
+		return result;
 	}
 
-	*retval = num_bytes;
+	*retval = len - u->uio_resid;
+	return 0;
+}
 
-	lock_release(fd->lk);
 
-	kfree(safe_buf);
+ssize_t
+sys_read(int read_fd, userptr_t buf, size_t buflen, ssize_t *retval) {
+	struct iovec iov;
+	struct uio u;
 
-	return 0;
-		
+	// Point the uio straight at the user buffer; uiomove does the
+	// one copy (and checks the address) as the file system goes
+	uio_uinit(&iov, &u, buf, buflen, 0, UIO_READ);
+
+	return file_rw(read_fd, &u, NULL, retval);
 }
 
 
 ssize_t
 sys_write(int write_fd, const_userptr_t buf, size_t buflen, ssize_t *retval) {
-	struct fdesc *fd;
 	struct iovec iov;
 	struct uio u;
-	int result;
-	struct addrspace *as;
-	void *safe_buf = kmalloc(sizeof(size_t));
 
-	as = proc_getas();
+	uio_uinit(&iov, &u, (userptr_t)buf, buflen, 0, UIO_WRITE);
 
-	// Check for valid filetable entry
-	if (curthread->t_ftable[write_fd] != NULL) {
-		fd = curthread->t_ftable[write_fd];
+	return file_rw(write_fd, &u, NULL, retval);
+}
+
+
+/*
+ * pread/pwrite: read or write at POS, leaving the seek position
+ * alone. No lock is taken on the open file at all, so any number of
+ * these can go on at once through one descriptor.
+ */
+ssize_t
+sys_pread(int read_fd, userptr_t buf, size_t buflen, off_t pos,
+	  ssize_t *retval) {
+	struct iovec iov;
+	struct uio u;
+
+	uio_uinit(&iov, &u, buf, buflen, 0, UIO_READ);
+
+	return file_rw(read_fd, &u, &pos, retval);
+}
+
+
+ssize_t
+sys_pwrite(int write_fd, const_userptr_t buf, size_t buflen, off_t pos,
+	   ssize_t *retval) {
+	struct iovec iov;
+	struct uio u;
+
+	uio_uinit(&iov, &u, (userptr_t)buf, buflen, 0, UIO_WRITE);
+
+	return file_rw(write_fd, &u, &pos, retval);
+}
+
+
+/*
+ * Number of iovecs readv and writev keep on the stack; more than
+ * this and they kmalloc the array.
+ */
+#define NSTACKIOV 8
+
+/* Largest total readv and writev can report; the largest ssize_t. */
+#define MAXRWV ((size_t)-1 >> 1)
+
+/*
+ * Common code for readv and writev. The user's iovec array is copied
+ * in once and checked, then the whole thing goes to the file system
+ * as one uio, so it's one VOP_READ or VOP_WRITE however many pieces
+ * there are.
+ */
+static
+int
+file_rwv(int fdnum, const_userptr_t uiov, int iovcnt, enum uio_rw rw,
+	 ssize_t *retval) {
+	struct iovec stackiov[NSTACKIOV];
+	struct iovec *iov;
+	struct uio u;
+	size_t total;
+	int i, result;
+
+	if (iovcnt <= 0 || iovcnt > IOV_MAX) {
+		return EINVAL;
+	}
+
+	if (iovcnt <= NSTACKIOV) {
+		iov = stackiov;
 	}
 	else {
-		return EBADF;
+		iov = kmalloc(iovcnt * sizeof(*iov));
+		if (iov == NULL) {
+			return ENOMEM;
+		}
 	}
-	
 
-	// Check read/write flags
-	if ((fd->openflags & O_ACCMODE) == O_RDONLY) {
-		return EBADF;
+	// The user's struct iovec has the same layout as ours
+	result = copyin(uiov, iov, iovcnt * sizeof(*iov));
+	if (result != 0) {
+		goto out;
 	}
 
-	// TODO this is incorrect, copyout should be used to write to buf
-	// Clean buffer pointer
-	result = copyin((userptr_t)buf, safe_buf, buflen);
+	// The total has to fit in the return value
+	total = 0;
+	for (i = 0; i < iovcnt; i++) {
+		if (iov[i].iov_len > MAXRWV - total) {
+			result = EINVAL;
+			goto out;
+		}
+		total += iov[i].iov_len;
+	}
 
-	if (result != 0) {
-		return result;
+	u.uio_iov = iov;
+	u.uio_iovcnt = iovcnt;
+	u.uio_offset = 0;
+	u.uio_resid = total;
+	u.uio_segflg = UIO_USERSPACE;
+	u.uio_rw = rw;
+	u.uio_space = proc_getas();
+
+	result = file_rw(fdnum, &u, NULL, retval);
+
+ out:
+	if (iov != stackiov) {
+		kfree(iov);
 	}
+	return result;
+}
 
 
-	// Initialize iovec and uio for reading
-	iov.iov_ubase = safe_buf;
-	iov.iov_len = buflen;
-	u.uio_iov = &iov;			/* Data blocks */
-	u.uio_iovcnt = 1;	/* Number of iovecs */
-	u.uio_offset = fd->ofst;	/* Desired offset into object */
-	u.uio_resid = buflen;	/* Remaining amt of data to xfer */
-	u.uio_segflg = UIO_USERSPACE;	/* What kind of pointer we have */
-	u.uio_rw = UIO_WRITE;	/* Whether op is a read or write */
-	u.uio_space = as;	/* Address space for user pointer */
+ssize_t
+sys_readv(int read_fd, const_userptr_t iov, int iovcnt, ssize_t *retval) {
+	return file_rwv(read_fd, iov, iovcnt, UIO_READ, retval);
+}
+
+
+ssize_t
+sys_writev(int write_fd, const_userptr_t iov, int iovcnt, ssize_t *retval) {
+	return file_rwv(write_fd, iov, iovcnt, UIO_WRITE, retval);
+}
 
-	
-	lock_acquire(fd->lk);
 
-	//  Write to file
-	result = VOP_WRITE(fd->vn, &u);
+/*
+ * Size of the buffer copy_file_range copies through. kmalloc gets
+ * anything much bigger from alloc_kpages, which under dumbvm is never
+ * given back, so stay under its largest subpage size. That's two SFS
+ * blocks per VOP call, and no trip to user space in between.
+ */
+#define COPYBUFSIZE 1024
+
+/*
+ * copy_file_range: copy up to LEN bytes from IN_FD's seek position to
+ * OUT_FD's, moving both, without the data ever going to user space.
+ * Returns the number of bytes copied, which is 0 at end of file. If
+ * something fails after some data was copied, that's reported as a
+ * short count, the way read and write do. Data read but not written
+ * by a failed or short write is given back to a seekable input, so
+ * its offset ends up just past what was copied; from a pipe or the
+ * console it can't be, and is lost.
+ */
+ssize_t
+sys_copy_file_range(int in_fd, int out_fd, size_t len, ssize_t *retval) {
+	struct fdesc *in, *out;
+	struct iovec iov;
+	struct uio u;
+	char *buf;
+	size_t total, chunk, got, written;
+	off_t inpos;
+	int result;
 
+	result = file_get(in_fd, UIO_READ, &in);
 	if (result != 0) {
-		lock_release(fd->lk);
+		return result;
+	}
+	result = file_get(out_fd, UIO_WRITE, &out);
+	if (result != 0) {
+		fdesc_decref(in);
 		return result;
 	}
 
-	ssize_t written_bytes = u.uio_offset - fd->ofst;
-	fd->ofst = u.uio_offset; 
+	buf = kmalloc(COPYBUFSIZE);
+	if (buf == NULL) {
+		fdesc_decref(out);
+		fdesc_decref(in);
+		return ENOMEM;
+	}
 
-	written_bytes = u.uio_resid - written_bytes;
+	// The total has to fit in the return value
+	if (len > MAXRWV) {
+		len = MAXRWV;
+	}
 
-	*retval = written_bytes;
+	total = 0;
+	while (total < len) {
+		chunk = len - total;
+		if (chunk > COPYBUFSIZE) {
+			chunk = COPYBUFSIZE;
+		}
 
-	lock_release(fd->lk);
+		uio_kinit(&iov, &u, buf, chunk, 0, UIO_READ);
+		result = file_io(in, &u, NULL);
+		if (result != 0) {
+			break;
+		}
+		got = chunk - u.uio_resid;
+		if (got == 0) {
+			break;
+		}
+		inpos = u.uio_offset - got;
+
+		uio_kinit(&iov, &u, buf, got, 0, UIO_WRITE);
+		result = file_io(out, &u, NULL);
+		written = got - u.uio_resid;
+		total += written;
+		if (result != 0 || written < got) {
+			// Put back what was read but not written
+			fdesc_retreat(in, inpos, got, written);
+			break;
+		}
+	}
 
-	kfree(safe_buf);
+	kfree(buf);
+	fdesc_decref(out);
+	fdesc_decref(in);
+
+	if (total == 0 && result != 0) {
+		return result;
+	}
 
+	*retval = total;
 	return 0;
 }
 
 
 int
-sys_dup2(int oldfid, int newfid) {
+sys_dup2(int oldfid, int newfid, int *retval) {
 	
 	struct fdesc *fd;
+	struct fdesc *oldfd;
+	int result;
 
-	fd = curthread->t_ftable[oldfid];
+	// Takes a reference, which the table takes over below
+	result = filetable_get(curproc->p_ftable, oldfid, &fd);
+	if (result != 0) {
+		return result;
+	}
 
-	if (fd == NULL) {
-		return EBADF;
+	if (oldfid == newfid) {
+		fdesc_decref(fd);
+		*retval = newfid;
+		return 0;
 	}
 
+	// Both descriptors now share fd, and with it the offset
+	result = filetable_placeat(curproc->p_ftable, fd, newfid, &oldfd);
+	if (result != 0) {
+		fdesc_decref(fd);
+		return result;
+	}
 
-	/*
-	 * Arg checking
-	 */
-	if (curthread->t_ftable[oldfid] == NULL) {
-		return EBADF;
+	// Close whatever newfid had open before
+	if (oldfd != NULL) {
+		fdesc_decref(oldfd);
 	}
 
-	if (oldfid > OPEN_MAX || newfid > OPEN_MAX) {
-		return EBADF;
+	*retval = newfid;
+	return 0;
+}
+
+
+int
+sys_pipe(userptr_t fds, int *retval) {
+
+	struct vnode *rvn, *wvn;
+	struct fdesc *rfd, *wfd, *junk;
+	int kfds[2];
+	int result;
+
+	result = pipe_create(&rvn, &wvn);
+	if (result != 0) {
+		return result;
 	}
 
-	if (oldfid < 0 || newfid < 0) {
-		return EBADF;
+	rfd = fdesc_create("pipe", rvn, O_RDONLY);
+	if (rfd == NULL) {
+		vfs_close(rvn);
+		vfs_close(wvn);
+		return ENOMEM;
+	}
+	wfd = fdesc_create("pipe", wvn, O_WRONLY);
+	if (wfd == NULL) {
+		fdesc_decref(rfd);
+		vfs_close(wvn);
+		return ENOMEM;
 	}
 
-	if (oldfid == newfid) {
-		return newfid;
+	// The table takes our references if these succeed
+	result = filetable_place(curproc->p_ftable, rfd, &kfds[0]);
+	if (result != 0) {
+		fdesc_decref(rfd);
+		fdesc_decref(wfd);
+		return result;
+	}
+	result = filetable_place(curproc->p_ftable, wfd, &kfds[1]);
+	if (result != 0) {
+		fdesc_decref(wfd);
+		goto fail;
 	}
 
-	lock_acquire(fd->lk);
+	result = copyout(kfds, fds, sizeof(kfds));
+	if (result != 0) {
+		if (filetable_remove(curproc->p_ftable, kfds[1], &junk) == 0) {
+			fdesc_decref(junk);
+		}
+		goto fail;
+	}
 
-	if (curthread->t_ftable[newfid] != NULL) {
-		sys_close(newfid);
+	*retval = 0;
+	return 0;
+
+ fail:
+	// Another thread may have closed it already; that's fine
+	if (filetable_remove(curproc->p_ftable, kfds[0], &junk) == 0) {
+		fdesc_decref(junk);
 	}
+	return result;
+}
 
-	curthread->t_ftable[newfid] = fd;
 
-	sys_close(oldfid);
+int
+sys_fsync(int fsync_fd) {
 
-	lock_release(fd->lk);
+	struct fdesc *fd;
+	int result;
 
-	return newfid;
+	result = filetable_get(curproc->p_ftable, fsync_fd, &fd);
+	if (result != 0) {
+		return result;
+	}
+
+	result = VOP_FSYNC(fd->vn);
+	fdesc_decref(fd);
+
+	return result;
 }
 
 
@@ -344,59 +576,38 @@ sys_lseek(int seek_fd, off_t pos, const_userptr_t whence, off_t *retval) {
 	int result = 0;
 	struct fdesc *fd;
 	struct stat st;
-	off_t cursor;
 	int safe_whence;
 
-	copyin(whence, &safe_whence, sizeof(int32_t));
-
-	fd = curthread->t_ftable[seek_fd];
-
-	result = VOP_STAT(fd->vn, &st);
-
+	result = copyin(whence, &safe_whence, sizeof(int32_t));
 	if (result != 0) {
 		return result;
 	}
 
-	if (fd == NULL) {
-		return EBADF;
-	}
-
-	if (seek_fd < 0 || seek_fd > OPEN_MAX) {
-		return EBADF;
+	result = filetable_get(curproc->p_ftable, seek_fd, &fd);
+	if (result != 0) {
+		return result;
 	}
 
-	if (!VOP_ISSEEKABLE(fd->vn)) {
+	if (!fd->seekable) {
+		fdesc_decref(fd);
 		return ESPIPE;
 	}
-	
-	lock_acquire(fd->lk);
-
-	cursor = fd->ofst;
 
-	switch (safe_whence) {
-		case SEEK_SET:
-	cursor = pos;
-			break;
-		case SEEK_CUR:
-	cursor = fd->ofst + pos;
-			break;
-		case SEEK_END:
-	cursor = st.st_size + pos;
-			break;
-		default:
-			return EINVAL;
+	// Only SEEK_END needs the size
+	st.st_size = 0;
+	if (safe_whence == SEEK_END) {
+		result = VOP_STAT(fd->vn, &st);
+		if (result != 0) {
+			fdesc_decref(fd);
+			return result;
+		}
 	}
 
-	if (cursor < 0) {
-		return EINVAL;
-	}
-	else {
-		*retval = cursor;
-	}
+	result = fdesc_seek(fd, pos, safe_whence, st.st_size, retval);
 
-	lock_release(fd->lk);
+	fdesc_decref(fd);
 
-	return 0;
+	return result;
 }
 
 
@@ -404,54 +615,38 @@ int
 sys_chdir(const_userptr_t  pathname) {
 	
 	int result = 0;
-	char *safe_pathname = kmalloc(sizeof(const_userptr_t));
+	char *safe_pathname;
 
-	result = copyinstr(pathname, (void *)safe_pathname, sizeof(safe_pathname), NULL);
+	// The path itself does need copying in; vfs_chdir wants a kernel string
+	safe_pathname = kmalloc(PATH_MAX);
+	if (safe_pathname == NULL) {
+		return ENOMEM;
+	}
+
+	result = copyinstr(pathname, safe_pathname, PATH_MAX, NULL);
 
 	if (result != 0) {
+		kfree(safe_pathname);
 		return result;
 	}
 
 	result = vfs_chdir(safe_pathname);
-	
-	if (result != 0) {
-		return result;
-	}
 
 	kfree(safe_pathname);
-	return 0;
+	return result;
 }
 
 
 int
 sys_getcwd(userptr_t buf, size_t buflen, int *retval) {
 	
-	void *safe_buf = kmalloc(sizeof(size_t));
 	int result = 0;
 
 	struct iovec iov;
 	struct uio u;
-	struct addrspace *as;
-
-	as = proc_getas();
-	
-	// Clean buffer pointer
-	result = copyin((userptr_t)buf, safe_buf, buflen);
-
-	if (result != 0) {
-		return result;
-	}
 
-	// Initialize iovec and uio for reading
-	iov.iov_ubase = safe_buf;
-	iov.iov_len = buflen;
-	u.uio_iov = &iov;			/* Data blocks */
-	u.uio_iovcnt = 1;	/* Number of iovecs */
-	u.uio_offset = 0;	/* Desired offset into object */
-	u.uio_resid = buflen;	/* Remaining amt of data to xfer */
-	u.uio_segflg = UIO_USERSPACE;	/* What kind of pointer we have */
-	u.uio_rw = UIO_READ;	/* Whether op is a read or write */
-	u.uio_space = as;	/* Address space for user pointer */
+	// Straight into the user buffer, as for read
+	uio_uinit(&iov, &u, buf, buflen, 0, UIO_READ);
 
 	result = vfs_getcwd(&u);
 
@@ -459,13 +654,6 @@ sys_getcwd(userptr_t buf, size_t buflen, int *retval) {
 		return result;
 	}
 
-	int num_bytes = u.uio_offset;
-
-	if (num_bytes < 0) {
-		return EFAULT;
-	}
-
-	kfree(safe_buf);
-	*retval = num_bytes;
+	*retval = buflen - u.uio_resid;
 	return 0;
 }
@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Futexes: sleeping and waking on a word of user memory.
+ *
+ * Userlevel locks and semaphores (see futex.h in userland) do their
+ * uncontended work with atomic instructions on a word in their own
+ * memory and only call in here to sleep when they have to wait, or to
+ * wake waiters. So there's no state in the kernel for a futex nobody
+ * is waiting on.
+ *
+ * Waiters are keyed by the physical address of the word, not the
+ * virtual one, so the same memory reached through different address
+ * spaces is the same futex. The key is hashed into a fixed table of
+ * wait queues; each queue has its own lock, and the check of the
+ * user's word in futex_wait is done under that lock, so a wake can't
+ * slip in between the check and going to sleep.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <synch.h>
+#include <proc.h>
+#include <current.h>
+#include <addrspace.h>
+#include <copyinout.h>
+#include <syscall.h>
+
+/* Number of wait queues; a power of two. */
+#define FUTEX_NBUCKETS 64
+
+struct futex_waiter {
+	paddr_t fw_key;
+	struct proc *fw_proc;		/* For futex_wakeproc */
+	bool fw_woken;
+	struct futex_waiter *fw_next;
+};
+
+struct futex_bucket {
+	struct lock *fb_lock;
+	struct cv *fb_cv;
+	struct futex_waiter *fb_waiters;	/* FIFO */
+};
+
+static struct futex_bucket futex_buckets[FUTEX_NBUCKETS];
+
+void
+futex_bootstrap(void)
+{
+	unsigned i;
+
+	for (i=0; i<FUTEX_NBUCKETS; i++) {
+		futex_buckets[i].fb_lock = lock_create("futex");
+		futex_buckets[i].fb_cv = cv_create("futex");
+		if (futex_buckets[i].fb_lock == NULL ||
+		    futex_buckets[i].fb_cv == NULL) {
+			panic("futex_bootstrap: Out of memory\n");
+		}
+		futex_buckets[i].fb_waiters = NULL;
+	}
+}
+
+/*
+ * Get the key for the user word at UADDR.
+ */
+static
+int
+futex_key(userptr_t uaddr, paddr_t *key)
+{
+	struct addrspace *as;
+
+	if (((vaddr_t)uaddr & (sizeof(int) - 1)) != 0) {
+		return EINVAL;
+	}
+
+	as = proc_getas();
+	if (as == NULL) {
+		return EFAULT;
+	}
+	return as_translate(as, (vaddr_t)uaddr, key);
+}
+
+static
+struct futex_bucket *
+futex_bucket(paddr_t key)
+{
+	/* The low two bits are always zero. */
+	return &futex_buckets[(key >> 2) % FUTEX_NBUCKETS];
+}
+
+/*
+ * futex_wait: if the word at UADDR still contains VAL, sleep until
+ * woken by futex_wake. Returns EAGAIN without sleeping if it doesn't.
+ * Wakeups are not spurious, but callers should recheck their
+ * condition anyway.
+ */
+int
+sys_futex_wait(userptr_t uaddr, int val)
+{
+	struct futex_bucket *fb;
+	struct futex_waiter me, **wp;
+	paddr_t key;
+	int cur, result;
+
+	result = futex_key(uaddr, &key);
+	if (result) {
+		return result;
+	}
+	fb = futex_bucket(key);
+
+	lock_acquire(fb->fb_lock);
+
+	result = copyin((const_userptr_t)uaddr, &cur, sizeof(cur));
+	if (result) {
+		lock_release(fb->fb_lock);
+		return result;
+	}
+	if (cur != val) {
+		lock_release(fb->fb_lock);
+		return EAGAIN;
+	}
+	/*
+	 * Don't go to sleep if the process is ending; this is checked
+	 * under the bucket lock so futex_wakeproc can't miss us.
+	 */
+	if (curproc->p_exiting) {
+		lock_release(fb->fb_lock);
+		return EINTR;
+	}
+
+	me.fw_key = key;
+	me.fw_proc = curproc;
+	me.fw_woken = false;
+	me.fw_next = NULL;
+	for (wp = &fb->fb_waiters; *wp != NULL; wp = &(*wp)->fw_next) {
+		/* nothing */
+	}
+	*wp = &me;
+
+	/* futex_wake takes us off the list before setting fw_woken. */
+	while (!me.fw_woken) {
+		cv_wait(fb->fb_cv, fb->fb_lock);
+	}
+
+	lock_release(fb->fb_lock);
+	return 0;
+}
+
+/*
+ * futex_wake: wake up to COUNT threads waiting on the word at UADDR,
+ * oldest first. Returns the number woken.
+ */
+int
+sys_futex_wake(userptr_t uaddr, int count, int *retval)
+{
+	struct futex_bucket *fb;
+	struct futex_waiter *w, **wp;
+	paddr_t key;
+	int result, n;
+
+	if (count < 0) {
+		return EINVAL;
+	}
+
+	result = futex_key(uaddr, &key);
+	if (result) {
+		return result;
+	}
+	fb = futex_bucket(key);
+
+	n = 0;
+	lock_acquire(fb->fb_lock);
+	wp = &fb->fb_waiters;
+	while (n < count && (w = *wp) != NULL) {
+		if (w->fw_key != key) {
+			wp = &w->fw_next;
+			continue;
+		}
+		*wp = w->fw_next;
+		w->fw_woken = true;
+		n++;
+	}
+	if (n > 0) {
+		/* The bucket may have other futexes' waiters; they recheck. */
+		cv_broadcast(fb->fb_cv, fb->fb_lock);
+	}
+	lock_release(fb->fb_lock);
+
+	*retval = n;
+	return 0;
+}
+
+/*
+ * Wake every thread of PROC waiting on any futex, because PROC is
+ * ending (see proc_setexiting). Called after p_exiting is set.
+ */
+void
+futex_wakeproc(struct proc *proc)
+{
+	struct futex_bucket *fb;
+	struct futex_waiter *w, **wp;
+	unsigned i;
+	bool any;
+
+	for (i=0; i<FUTEX_NBUCKETS; i++) {
+		fb = &futex_buckets[i];
+		any = false;
+		lock_acquire(fb->fb_lock);
+		wp = &fb->fb_waiters;
+		while ((w = *wp) != NULL) {
+			if (w->fw_proc != proc) {
+				wp = &w->fw_next;
+				continue;
+			}
+			*wp = w->fw_next;
+			w->fw_woken = true;
+			any = true;
+		}
+		if (any) {
+			cv_broadcast(fb->fb_cv, fb->fb_lock);
+		}
+		lock_release(fb->fb_lock);
+	}
+}
@@ -0,0 +1,373 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * poll() and select(). The definitions are in <kern/poll.h>; the
+ * waiting is done with a pollset (see poll.h) and VOP_POLL.
+ *
+ * Both take a reference to each open file they look at for the whole
+ * call, so a file closed by another thread meanwhile (and the pollq
+ * we may be hooked onto) can't go away under us.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/poll.h>
+#include <kern/time.h>
+#include <lib.h>
+#include <clock.h>
+#include <current.h>
+#include <proc.h>
+#include <copyinout.h>
+#include <vnode.h>
+#include <filetable.h>
+#include <kern/fdesc.h>
+#include <poll.h>
+#include <syscall.h>
+
+/* Longest select() timeout honored, in seconds; about a day. */
+#define POLL_MAXSECS	(24*60*60)
+
+/*
+ * One descriptor being polled. At most __OPEN_MAX of these are
+ * allocated at once, so keep it small.
+ */
+struct pollitem {
+	struct fdesc *pi_file;		/* NULL if not looked at */
+	int pi_fd;
+	short pi_events;
+	short pi_revents;
+};
+
+/*
+ * Look at each item once; return how many have something to report.
+ * Items with no file keep whatever revents they were given.
+ */
+static
+unsigned
+poll_scan(struct pollitem *items, unsigned n, struct pollset *ps)
+{
+	unsigned i, count = 0;
+	int want;
+
+	for (i=0; i<n; i++) {
+		if (items[i].pi_file != NULL) {
+			want = items[i].pi_events | POLLERR | POLLHUP;
+			items[i].pi_revents = want &
+				VOP_POLL(items[i].pi_file->vn,
+					 items[i].pi_events, ps);
+		}
+		if (items[i].pi_revents != 0) {
+			count++;
+		}
+	}
+	return count;
+}
+
+/*
+ * Wait up to TICKS hardclocks (forever if negative) until at least
+ * one item has something to report.
+ */
+static
+int
+poll_wait(struct pollitem *items, unsigned n, int ticks, unsigned *count)
+{
+	struct pollset ps;
+	bool expired;
+	int result;
+
+	if (ticks == 0) {
+		*count = poll_scan(items, n, NULL);
+		return 0;
+	}
+
+	result = pollset_init(&ps);
+	if (result) {
+		return result;
+	}
+
+	*count = poll_scan(items, n, &ps);
+	result = pollset_error(&ps);
+	if (*count == 0 && result == 0) {
+		if (ticks > 0) {
+			pollset_timeout(&ps, ticks);
+		}
+		do {
+			expired = pollset_wait(&ps);
+			*count = poll_scan(items, n, NULL);
+		} while (*count == 0 && !expired);
+	}
+
+	pollset_cleanup(&ps);
+	return result;
+}
+
+/*
+ * Drop the file references taken for ITEMS.
+ */
+static
+void
+poll_release(struct pollitem *items, unsigned n)
+{
+	unsigned i;
+
+	for (i=0; i<n; i++) {
+		if (items[i].pi_file != NULL) {
+			fdesc_decref(items[i].pi_file);
+		}
+	}
+}
+
+/*
+ * Convert a timeout to hardclocks, rounding up.
+ */
+static
+int
+poll_msticks(int ms)
+{
+	if (ms < 0) {
+		return -1;
+	}
+	return (ms + (1000 / HZ) - 1) / (1000 / HZ);
+}
+
+int
+sys_poll(userptr_t ufds, unsigned nfds, int timeout, int *retval)
+{
+	struct pollfd pfd;
+	struct pollitem *items;
+	unsigned i, count;
+	int result;
+
+	if (nfds > __OPEN_MAX) {
+		return EINVAL;
+	}
+
+	items = kmalloc(nfds * sizeof(*items));
+	if (items == NULL) {
+		return ENOMEM;
+	}
+
+	for (i=0; i<nfds; i++) {
+		items[i].pi_file = NULL;
+	}
+	for (i=0; i<nfds; i++) {
+		result = copyin(ufds + i * sizeof(pfd), &pfd, sizeof(pfd));
+		if (result) {
+			goto out;
+		}
+		items[i].pi_fd = pfd.fd;
+		items[i].pi_events = pfd.events;
+		items[i].pi_revents = 0;
+		if (pfd.fd < 0) {
+			continue;
+		}
+		if (filetable_get(curproc->p_ftable, pfd.fd,
+				  &items[i].pi_file)) {
+			items[i].pi_file = NULL;
+			items[i].pi_revents = POLLNVAL;
+		}
+	}
+
+	result = poll_wait(items, nfds, poll_msticks(timeout), &count);
+	if (result) {
+		goto out;
+	}
+
+	for (i=0; i<nfds; i++) {
+		pfd.fd = items[i].pi_fd;
+		pfd.events = items[i].pi_events;
+		pfd.revents = items[i].pi_revents;
+		result = copyout(&pfd, ufds + i * sizeof(pfd), sizeof(pfd));
+		if (result) {
+			goto out;
+		}
+	}
+	*retval = count;
+
+ out:
+	poll_release(items, nfds);
+	kfree(items);
+	return result;
+}
+
+/*
+ * Copy in the first NWORDS words of a descriptor set, or clear them
+ * if there's no set.
+ */
+static
+int
+select_getset(userptr_t uset, struct __fd_set *set, unsigned nwords)
+{
+	bzero(set, sizeof(*set));
+	if (uset == NULL) {
+		return 0;
+	}
+	return copyin(uset, set, nwords * sizeof(set->fds_bits[0]));
+}
+
+static
+int
+select_putset(userptr_t uset, struct __fd_set *set, unsigned nwords)
+{
+	if (uset == NULL) {
+		return 0;
+	}
+	return copyout(set, uset, nwords * sizeof(set->fds_bits[0]));
+}
+
+#define FDBIT(set, fd) \
+	((set)->fds_bits[(fd) / __NFDBITS] & (1U << ((fd) % __NFDBITS)))
+#define FDSET(set, fd) \
+	((set)->fds_bits[(fd) / __NFDBITS] |= (1U << ((fd) % __NFDBITS)))
+
+int
+sys_select(int nfds, userptr_t ureadfds, userptr_t uwritefds,
+	   userptr_t uexceptfds, userptr_t utimeout, int *retval)
+{
+	struct __fd_set rset, wset, xset;
+	struct timeval tv;
+	struct pollitem *items;
+	unsigned nwords, n, i, count;
+	int fd, ticks, result;
+
+	if (nfds < 0 || nfds > __FD_SETSIZE) {
+		return EINVAL;
+	}
+	nwords = (nfds + __NFDBITS - 1) / __NFDBITS;
+
+	ticks = -1;
+	if (utimeout != NULL) {
+		result = copyin(utimeout, &tv, sizeof(tv));
+		if (result) {
+			return result;
+		}
+		if (tv.tv_sec < 0 || tv.tv_usec < 0 || tv.tv_usec >= 1000000) {
+			return EINVAL;
+		}
+		if (tv.tv_sec > POLL_MAXSECS) {
+			tv.tv_sec = POLL_MAXSECS;
+		}
+		ticks = tv.tv_sec * HZ +
+			(tv.tv_usec + (1000000 / HZ) - 1) / (1000000 / HZ);
+	}
+
+	result = select_getset(ureadfds, &rset, nwords);
+	if (result) {
+		return result;
+	}
+	result = select_getset(uwritefds, &wset, nwords);
+	if (result) {
+		return result;
+	}
+	result = select_getset(uexceptfds, &xset, nwords);
+	if (result) {
+		return result;
+	}
+
+	items = kmalloc(nfds * sizeof(*items));
+	if (items == NULL) {
+		return ENOMEM;
+	}
+
+	n = 0;
+	for (fd=0; fd<nfds; fd++) {
+		if (!FDBIT(&rset, fd) && !FDBIT(&wset, fd) &&
+		    !FDBIT(&xset, fd)) {
+			continue;
+		}
+		result = filetable_get(curproc->p_ftable, fd,
+				       &items[n].pi_file);
+		if (result) {
+			goto out;
+		}
+		items[n].pi_fd = fd;
+		items[n].pi_events = 0;
+		items[n].pi_revents = 0;
+		if (FDBIT(&rset, fd)) {
+			items[n].pi_events |= POLLIN;
+		}
+		if (FDBIT(&wset, fd)) {
+			items[n].pi_events |= POLLOUT;
+		}
+		if (items[n].pi_events == 0) {
+			/* Only in the exception set; just checked */
+			fdesc_decref(items[n].pi_file);
+			continue;
+		}
+		n++;
+	}
+
+	result = poll_wait(items, n, ticks, &count);
+	if (result) {
+		goto out;
+	}
+
+	/*
+	 * An error or hangup counts as ready for whichever of reading
+	 * and writing was asked about, so the read or write that
+	 * follows reports it.
+	 */
+	bzero(&rset, sizeof(rset));
+	bzero(&wset, sizeof(wset));
+	bzero(&xset, sizeof(xset));
+	count = 0;
+	for (i=0; i<n; i++) {
+		if (items[i].pi_revents & (POLLERR | POLLHUP)) {
+			items[i].pi_revents |= items[i].pi_events;
+		}
+		if (items[i].pi_revents & items[i].pi_events & POLLIN) {
+			FDSET(&rset, items[i].pi_fd);
+			count++;
+		}
+		if (items[i].pi_revents & items[i].pi_events & POLLOUT) {
+			FDSET(&wset, items[i].pi_fd);
+			count++;
+		}
+	}
+
+	result = select_putset(ureadfds, &rset, nwords);
+	if (result) {
+		goto out;
+	}
+	result = select_putset(uwritefds, &wset, nwords);
+	if (result) {
+		goto out;
+	}
+	result = select_putset(uexceptfds, &xset, nwords);
+	if (result) {
+		goto out;
+	}
+	*retval = count;
+
+ out:
+	poll_release(items, n);
+	kfree(items);
+	return result;
+}
@@ -2,82 +2,327 @@
 #include <thread.h>
 #include <current.h>
 #include <proc.h>
+#include <pid.h>
+#include <filetable.h>
+#include <kern/errno.h>
+#include <kern/resource.h>
 #include <mips/trapframe.h>
 #include <addrspace.h>
 #include <types.h>
+#include <kern/fcntl.h>
+#include <limits.h>
+#include <lib.h>
+#include <copyinout.h>
+#include <vfs.h>
+#include <workqueue.h>
+#include <execargs.h>
+#include <ring.h>
+#include <syscall.h>
 
+/*
+ * First thing the child of fork runs: return 0 from fork, in a copy
+ * of the parent's trapframe. TF was allocated by sys_fork; we free it.
+ */
 void child_entry(void *tf, unsigned long data2) {
+	struct trapframe tf_new;
+
 	(void)data2;
-	struct trapframe *tf_old = tf;
-	struct trapframe *tf_new;
+
+	// Copy the trapframe onto our own stack, which it must be on
+	tf_new = *(struct trapframe *)tf;
+	kfree(tf);
 
 	// Child returns 0
-	tf_old->tf_v0 = 0;
-	tf_old->tf_a3 = 0;
+	tf_new.tf_v0 = 0;
+	tf_new.tf_a3 = 0;
 
 	// Advance PC
-	tf_old->tf_epc += 4;
-
-	// Copy trapframe from kernel stack
-	memcpy(&tf_new, (struct trapframe *)tf, sizeof(struct trapframe));
+	tf_new.tf_epc += 4;
 
 	as_activate();
 
-	kfree(tf);
-	kfree(tf_old);
-
-	mips_usermode(tf_new);
-
+	mips_usermode(&tf_new);
 }
 
 pid_t sys_getpid() {
-	return curthread->t_pid;
+	return curproc->p_pid;
 }
 
 
 pid_t sys_fork(struct trapframe *tf, int *retval) {
 	struct addrspace *new_as;
 	struct proc *new_p;
-	struct trapframe *new_tf = kmalloc(sizeof(struct trapframe));
+	struct trapframe *new_tf;
+	pid_t pid;
 
 	int result = 0;
 
 	// Create new process
 	new_p = proc_create(curthread->t_name);
+	if (new_p == NULL) {
+		return ENOMEM;
+	}
+
+	// Allocate pid; we're its parent
+	result = pid_alloc(new_p, curproc);
+	if (result) {
+		proc_destroy(new_p);
+		return result;
+	}
 
-	// Allocate pid
-	result = pid_allocate(new_p);
+	// Share the parent's open files
+	result = filetable_copy(curproc->p_ftable, new_p->p_ftable);
 	if (result) {
+		proc_destroy(new_p);
 		return result;
 	}
 
 	// Copy calling process' trapframe and address space
-	result = as_copy(curthread->t_proc->p_addrspace, &new_as);
+	result = as_copy(proc_getas(), &new_as);
 	if (result) {
+		proc_destroy(new_p);
 		return result;
 	}
+	new_p->p_addrspace = new_as;
 
+	new_tf = kmalloc(sizeof(struct trapframe));
+	if (new_tf == NULL) {
+		proc_destroy(new_p);
+		return ENOMEM;
+	}
 	memcpy(new_tf, tf, sizeof(struct trapframe));
 
-	new_p->p_addrspace = new_as;
+	// Once it's running, the child may exit and be gone at any time
+	pid = new_p->p_pid;
 
-	// Fork thread
-	thread_fork(curproc->p_name, new_p,
+	// Fork thread; child_entry frees new_tf
+	result = thread_fork(curproc->p_name, new_p,
                 child_entry,
                 new_tf, 0);
+	if (result) {
+		kfree(new_tf);
+		proc_destroy(new_p);
+		return result;
+	}
 
-
-	*retval = new_p->p_pid;
-	kfree(new_tf);
+	*retval = pid;
 	return 0;
 
 }
 
 
-int sys_execv();
+/*
+ * An address space execv has replaced, on its way to the workqueue.
+ */
+struct execv_oldas {
+	struct work eo_work;
+	struct addrspace *eo_as;
+};
+
+static
+void
+execv_oldas_free(void *data1, unsigned long data2) {
+	struct execv_oldas *eo = data1;
+
+	(void)data2;
+	as_decref(eo->eo_as);
+	work_cleanup(&eo->eo_work);
+	kfree(eo);
+}
+
+/*
+ * execv: replace the program running in this process.
+ *
+ * The arguments are copied in before anything else happens (see
+ * execargs.h), and the new address space is built and loaded beside
+ * the old one, so any failure can still go back to the old program.
+ * Once the new one is ready, the old one isn't needed; tearing it
+ * down is left to the workqueue, so it goes on while the new program
+ * gets started instead of in front of it.
+ *
+ * A process with more than one thread can't exec; it fails with
+ * EBUSY until the others have exited.
+ */
+int sys_execv(const_userptr_t upath, userptr_t uargv) {
+	struct execargs args;
+	struct execv_oldas *eo;
+	struct addrspace *newas, *oldas;
+	struct vnode *vn;
+	vaddr_t entrypoint, stackptr;
+	userptr_t argv;
+	char *path;
+	int argc, result;
+
+	path = kmalloc(PATH_MAX);
+	if (path == NULL) {
+		return ENOMEM;
+	}
+	result = copyinstr(upath, path, PATH_MAX, NULL);
+	if (result) {
+		kfree(path);
+		return result;
+	}
+
+	result = execargs_copyin(&args, uargv);
+	if (result) {
+		goto fail_args;
+	}
+
+	result = vfs_open(path, O_RDONLY, 0, &vn);
+	if (result) {
+		goto fail_args;
+	}
+
+	// Async ring I/O may still be using the old program's memory
+	ring_drain(curproc);
+
+	// Other threads would go on running the old program's code in
+	// the new image. Once we're the only thread, no more can start.
+	if (curproc->p_numthreads > 1) {
+		result = EBUSY;
+		goto fail_vn;
+	}
+
+	// Get this now, so nothing can fail once the old program is gone
+	eo = kmalloc(sizeof(*eo));
+	if (eo == NULL) {
+		result = ENOMEM;
+		goto fail_vn;
+	}
+
+	newas = as_create();
+	if (newas == NULL) {
+		result = ENOMEM;
+		goto fail_eo;
+	}
+	oldas = proc_setas(newas);
+	as_activate();
+
+	result = load_elf(vn, &entrypoint);
+	if (result) {
+		goto fail_as;
+	}
+	result = as_define_stack(newas, &stackptr);
+	if (result) {
+		goto fail_as;
+	}
+	result = execargs_copyout(&args, &stackptr, &argv);
+	if (result) {
+		goto fail_as;
+	}
+
+	// No going back now
+	vfs_close(vn);
+	argc = args.ea_argc;
+	execargs_cleanup(&args);
+	kfree(path);
+
+	eo->eo_as = oldas;
+	work_init(&eo->eo_work, execv_oldas_free, eo, 0);
+	work_queue(&eo->eo_work);
+
+	enter_new_process(argc, argv, NULL, stackptr, entrypoint);
+
+ fail_as:
+	proc_setas(oldas);
+	as_activate();
+	as_decref(newas);
+ fail_eo:
+	kfree(eo);
+ fail_vn:
+	vfs_close(vn);
+ fail_args:
+	execargs_cleanup(&args);
+	kfree(path);
+	return result;
+}
+
+
+/*
+ * waitpid: collect the exit status of child PID (or of any child, if
+ * PID is WAIT_ANY), sleeping until it exits unless OPTIONS has
+ * WNOHANG. See pid_wait.
+ */
+int sys_waitpid(pid_t pid, userptr_t status, int options, int *retval) {
+	return sys_wait4(pid, status, options, NULL, retval);
+}
 
 
-pid_t sys_waitpid();
+/*
+ * wait4: waitpid, and also hand back the child's resource usage
+ * (including that of the children it waited for) if RUSAGE isn't
+ * NULL.
+ */
+int sys_wait4(pid_t pid, userptr_t status, int options, userptr_t rusage,
+	      int *retval) {
+	struct usage usage;
+	struct rusage kusage;
+	pid_t child;
+	int kstatus, result;
 
+	if (options & ~WNOHANG) {
+		return EINVAL;
+	}
+
+	result = pid_wait(pid, options, &kstatus, &usage, &child);
+	if (result) {
+		return result;
+	}
 
-void sys_exit();
+	// The status is gone from the kernel now, whether this works or not
+	if (child != 0 && status != NULL) {
+		result = copyout(&kstatus, status, sizeof(kstatus));
+		if (result) {
+			return result;
+		}
+	}
+	if (child != 0 && rusage != NULL) {
+		usage_export(&usage, &kusage);
+		result = copyout(&kusage, rusage, sizeof(kusage));
+		if (result) {
+			return result;
+		}
+	}
+
+	*retval = child;
+	return 0;
+}
+
+
+/*
+ * getrusage: the resource usage of the calling process (RUSAGE_SELF)
+ * or of its children that have been waited for (RUSAGE_CHILDREN).
+ * See usage.h for what's counted.
+ */
+int sys_getrusage(int who, userptr_t rusage) {
+	struct usage usage;
+	struct rusage kusage;
+
+	switch (who) {
+	    case RUSAGE_SELF:
+		usage_self(&usage);
+		break;
+	    case RUSAGE_CHILDREN:
+		usage_children(&usage);
+		break;
+	    default:
+		return EINVAL;
+	}
+
+	usage_export(&usage, &kusage);
+	return copyout(&kusage, rusage, sizeof(kusage));
+}
+
+
+/*
+ * _exit: end the process with exit code CODE.
+ *
+ * The other threads end when they next head back to user mode (see
+ * proc_setexiting); the process, and its status, go when the last of
+ * them does (see thread_exit). If another thread got there first,
+ * its status stands.
+ */
+__DEAD void sys__exit(int code) {
+	proc_setexiting(curproc, _MKWAIT_EXIT(code));
+	sys_threadexit(0);
+}
@@ -0,0 +1,547 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * ring_enter: batched I/O through submission and completion rings.
+ * The rings are described in <kern/ring.h>, the kernel side in ring.h.
+ *
+ * The rings live in the process's ordinary memory and are read and
+ * written with copyin and copyout. (With dumbvm there's no way to map
+ * a page into both the kernel and a process; copying a few words per
+ * batch is cheap next to the traps the batch saves.)
+ *
+ * Requests are taken RING_CHUNK at a time, into a kernel buffer small
+ * enough for the stack or a small kmalloc. A synchronous ring_enter
+ * does each chunk itself; with RING_ENTER_ASYNC the chunks are queued
+ * for the process's worker thread instead. Each request is done by
+ * calling the system call it stands for, so it behaves exactly as the
+ * plain call would, in the same process.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/ring.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <synch.h>
+#include <thread.h>
+#include <current.h>
+#include <proc.h>
+#include <copyinout.h>
+#include <kern/file_syscalls.h>
+#include <syscall.h>
+#include <ring.h>
+
+/* Requests taken from the ring at once. */
+#define RING_CHUNK	8
+
+/*
+ * A chunk of requests waiting for the worker.
+ */
+struct ringbatch {
+	struct ringbatch *rb_next;
+	userptr_t rb_ring;		/* Where the completions go */
+	unsigned rb_n;
+	struct ring_sqe rb_sqes[RING_CHUNK];
+};
+
+struct ringctx {
+	struct lock *rc_lock;
+	struct cv *rc_cv;		/* Completions posted; worker done */
+	struct ringbatch *rc_head;	/* Queued for the worker */
+	struct ringbatch *rc_tail;
+	unsigned rc_inflight;		/* Taken but not yet completed */
+	bool rc_running;		/* There's a worker */
+};
+
+/*
+ * Get PROC's ringctx, making it if it's the first time.
+ */
+static
+struct ringctx *
+ring_getctx(struct proc *proc)
+{
+	struct ringctx *ctx, *dup = NULL;
+
+	spinlock_acquire(&proc->p_lock);
+	ctx = proc->p_ring;
+	spinlock_release(&proc->p_lock);
+	if (ctx != NULL) {
+		return ctx;
+	}
+
+	ctx = kmalloc(sizeof(*ctx));
+	if (ctx == NULL) {
+		return NULL;
+	}
+	ctx->rc_lock = lock_create("ring");
+	if (ctx->rc_lock == NULL) {
+		kfree(ctx);
+		return NULL;
+	}
+	ctx->rc_cv = cv_create("ring");
+	if (ctx->rc_cv == NULL) {
+		lock_destroy(ctx->rc_lock);
+		kfree(ctx);
+		return NULL;
+	}
+	ctx->rc_head = ctx->rc_tail = NULL;
+	ctx->rc_inflight = 0;
+	ctx->rc_running = false;
+
+	/* Another thread may have beaten us to it. */
+	spinlock_acquire(&proc->p_lock);
+	if (proc->p_ring == NULL) {
+		proc->p_ring = ctx;
+	}
+	else {
+		dup = ctx;
+		ctx = proc->p_ring;
+	}
+	spinlock_release(&proc->p_lock);
+	if (dup != NULL) {
+		ring_destroy(dup);
+	}
+	return ctx;
+}
+
+void
+ring_destroy(struct ringctx *ctx)
+{
+	KASSERT(!ctx->rc_running);
+	KASSERT(ctx->rc_head == NULL);
+
+	cv_destroy(ctx->rc_cv);
+	lock_destroy(ctx->rc_lock);
+	kfree(ctx);
+}
+
+void
+ring_drain(struct proc *proc)
+{
+	struct ringctx *ctx;
+
+	spinlock_acquire(&proc->p_lock);
+	ctx = proc->p_ring;
+	spinlock_release(&proc->p_lock);
+	if (ctx == NULL) {
+		return;
+	}
+
+	lock_acquire(ctx->rc_lock);
+	while (ctx->rc_running) {
+		cv_wait(ctx->rc_cv, ctx->rc_lock);
+	}
+	lock_release(ctx->rc_lock);
+}
+
+/*
+ * Fetch and check the ring header.
+ */
+static
+int
+ring_gethdr(userptr_t uring, struct ring *r)
+{
+	int result;
+
+	result = copyin(uring, r, sizeof(*r));
+	if (result) {
+		return result;
+	}
+	if (r->r_entries == 0 || r->r_entries > RING_MAXENTRIES ||
+	    (r->r_entries & (r->r_entries - 1)) != 0) {
+		return EINVAL;
+	}
+	return 0;
+}
+
+/*
+ * Take up to MAX requests from the ring into SQES, and count them as
+ * in flight. Returns how many in *N. rc_lock must be held.
+ */
+static
+int
+ring_take(struct ringctx *ctx, userptr_t uring, struct ring_sqe *sqes,
+	  unsigned max, unsigned *n)
+{
+	struct ring r;
+	unsigned used, idx, first, i;
+	userptr_t head;
+	int result;
+
+	KASSERT(lock_do_i_hold(ctx->rc_lock));
+
+	result = ring_gethdr(uring, &r);
+	if (result) {
+		return result;
+	}
+
+	/* Leave a completion slot for everything we take. */
+	used = r.r_cqtail - r.r_cqhead + ctx->rc_inflight;
+	if (used >= r.r_entries) {
+		*n = 0;
+		return 0;
+	}
+	if (max > r.r_entries - used) {
+		max = r.r_entries - used;
+	}
+	if (max > r.r_sqtail - r.r_sqhead) {
+		max = r.r_sqtail - r.r_sqhead;
+	}
+
+	/* At most two pieces, if it wraps around. */
+	for (i = 0; i < max; i += first) {
+		idx = (r.r_sqhead + i) & (r.r_entries - 1);
+		head = (userptr_t)((struct ring_sqe *)r.r_sq + idx);
+		first = r.r_entries - idx;
+		if (first > max - i) {
+			first = max - i;
+		}
+		result = copyin(head, &sqes[i], first * sizeof(sqes[0]));
+		if (result) {
+			return result;
+		}
+	}
+
+	r.r_sqhead += max;
+	head = (userptr_t)&((struct ring *)uring)->r_sqhead;
+	result = copyout(&r.r_sqhead, head, sizeof(r.r_sqhead));
+	if (result) {
+		return result;
+	}
+
+	ctx->rc_inflight += max;
+	*n = max;
+	return 0;
+}
+
+/*
+ * Post N completions to the ring, and wake anyone waiting for them.
+ * If the ring has gone bad they are lost, but they're no longer in
+ * flight either way.
+ */
+static
+void
+ring_post(struct ringctx *ctx, userptr_t uring, const struct ring_cqe *cqes,
+	  unsigned n)
+{
+	struct ring r;
+	unsigned idx, first, i;
+	userptr_t tail;
+	int result;
+
+	lock_acquire(ctx->rc_lock);
+	KASSERT(ctx->rc_inflight >= n);
+	ctx->rc_inflight -= n;
+
+	result = ring_gethdr(uring, &r);
+	for (i = 0; result == 0 && i < n; i += first) {
+		idx = (r.r_cqtail + i) & (r.r_entries - 1);
+		tail = (userptr_t)((struct ring_cqe *)r.r_cq + idx);
+		first = r.r_entries - idx;
+		if (first > n - i) {
+			first = n - i;
+		}
+		result = copyout(&cqes[i], tail, first * sizeof(cqes[0]));
+	}
+	if (result == 0) {
+		r.r_cqtail += n;
+		tail = (userptr_t)&((struct ring *)uring)->r_cqtail;
+		copyout(&r.r_cqtail, tail, sizeof(r.r_cqtail));
+	}
+
+	cv_broadcast(ctx->rc_cv, ctx->rc_lock);
+	lock_release(ctx->rc_lock);
+}
+
+/*
+ * Do one request, by way of the system call it stands for.
+ */
+static
+void
+ring_do(const struct ring_sqe *sqe, struct ring_cqe *cqe)
+{
+	int ret = 0;
+	int err;
+
+	switch (sqe->sqe_op) {
+	    case RING_OP_NOP:
+		err = 0;
+		break;
+	    case RING_OP_READ:
+		if (sqe->sqe_off == -1) {
+			err = sys_read(sqe->sqe_fd, sqe->sqe_buf,
+				       sqe->sqe_len, &ret);
+		}
+		else {
+			err = sys_pread(sqe->sqe_fd, sqe->sqe_buf,
+					sqe->sqe_len, sqe->sqe_off, &ret);
+		}
+		break;
+	    case RING_OP_WRITE:
+		if (sqe->sqe_off == -1) {
+			err = sys_write(sqe->sqe_fd, sqe->sqe_buf,
+					sqe->sqe_len, &ret);
+		}
+		else {
+			err = sys_pwrite(sqe->sqe_fd, sqe->sqe_buf,
+					 sqe->sqe_len, sqe->sqe_off, &ret);
+		}
+		break;
+	    case RING_OP_OPEN:
+		err = sys_open(sqe->sqe_buf, sqe->sqe_flags, &ret);
+		break;
+	    case RING_OP_CLOSE:
+		err = sys_close(sqe->sqe_fd);
+		break;
+	    case RING_OP_FSYNC:
+		err = sys_fsync(sqe->sqe_fd);
+		break;
+	    default:
+		err = EINVAL;
+		break;
+	}
+
+	cqe->cqe_data = sqe->sqe_data;
+	cqe->cqe_res = err ? -err : ret;
+}
+
+/*
+ * Do N requests and post their completions.
+ */
+static
+void
+ring_run(struct ringctx *ctx, userptr_t uring, const struct ring_sqe *sqes,
+	 unsigned n)
+{
+	struct ring_cqe cqes[RING_CHUNK];
+	unsigned i;
+
+	KASSERT(n <= RING_CHUNK);
+
+	for (i=0; i<n; i++) {
+		ring_do(&sqes[i], &cqes[i]);
+	}
+	ring_post(ctx, uring, cqes, n);
+}
+
+/*
+ * Complete N requests with EINTR without doing them, because the
+ * process is ending.
+ */
+static
+void
+ring_cancel(struct ringctx *ctx, userptr_t uring,
+	    const struct ring_sqe *sqes, unsigned n)
+{
+	struct ring_cqe cqes[RING_CHUNK];
+	unsigned i;
+
+	KASSERT(n <= RING_CHUNK);
+
+	for (i=0; i<n; i++) {
+		cqes[i].cqe_data = sqes[i].sqe_data;
+		cqes[i].cqe_res = -EINTR;
+	}
+	ring_post(ctx, uring, cqes, n);
+}
+
+/*
+ * The worker: a thread in the process that does queued batches until
+ * there are none left, then exits. Once the process starts exiting
+ * (see proc_setexiting) the rest are cancelled instead, so _exit
+ * isn't held up by them and nothing is written afterwards.
+ */
+static
+void
+ring_worker(void *data1, unsigned long data2)
+{
+	struct ringctx *ctx = data1;
+	struct proc *proc = curproc;
+	struct ringbatch *rb;
+	bool last;
+
+	(void)data2;
+
+	lock_acquire(ctx->rc_lock);
+	while (ctx->rc_head != NULL) {
+		rb = ctx->rc_head;
+		ctx->rc_head = rb->rb_next;
+		if (ctx->rc_head == NULL) {
+			ctx->rc_tail = NULL;
+		}
+		lock_release(ctx->rc_lock);
+
+		if (proc->p_exiting) {
+			ring_cancel(ctx, rb->rb_ring, rb->rb_sqes, rb->rb_n);
+		}
+		else {
+			ring_run(ctx, rb->rb_ring, rb->rb_sqes, rb->rb_n);
+		}
+		kfree(rb);
+
+		lock_acquire(ctx->rc_lock);
+	}
+	ctx->rc_running = false;
+
+	/*
+	 * Move over to the kernel process before saying we're done, as
+	 * spawn's child does on failure, so that once ring_drain sees
+	 * rc_running clear we're no longer counted in p_numthreads.
+	 * If we were the last thread, the process (and CTX) ends once
+	 * we let go of the lock.
+	 */
+	last = proc_remthread(curthread);
+	proc_addthread(kproc, curthread);
+	cv_broadcast(ctx->rc_cv, ctx->rc_lock);
+	lock_release(ctx->rc_lock);
+
+	if (last) {
+		proc_exit(proc);
+	}
+}
+
+/*
+ * Queue up to RING_CHUNK requests for the worker, starting it if need
+ * be. Returns how many were taken in *N. rc_lock must be held.
+ */
+static
+int
+ring_queue(struct ringctx *ctx, userptr_t uring, unsigned max, unsigned *n)
+{
+	struct ringbatch *rb;
+	int result;
+
+	KASSERT(lock_do_i_hold(ctx->rc_lock));
+
+	rb = kmalloc(sizeof(*rb));
+	if (rb == NULL) {
+		return ENOMEM;
+	}
+	result = ring_take(ctx, uring, rb->rb_sqes,
+			   max < RING_CHUNK ? max : RING_CHUNK, &rb->rb_n);
+	if (result || rb->rb_n == 0) {
+		kfree(rb);
+		*n = 0;
+		return result;
+	}
+	rb->rb_ring = uring;
+	rb->rb_next = NULL;
+
+	if (!ctx->rc_running) {
+		result = thread_fork("ring", curproc, ring_worker, ctx, 0);
+		if (result) {
+			/* Too late to put them back; do them here. */
+			lock_release(ctx->rc_lock);
+			ring_run(ctx, uring, rb->rb_sqes, rb->rb_n);
+			lock_acquire(ctx->rc_lock);
+			*n = rb->rb_n;
+			kfree(rb);
+			return 0;
+		}
+		ctx->rc_running = true;
+	}
+
+	if (ctx->rc_tail != NULL) {
+		ctx->rc_tail->rb_next = rb;
+	}
+	else {
+		ctx->rc_head = rb;
+	}
+	ctx->rc_tail = rb;
+	*n = rb->rb_n;
+	return 0;
+}
+
+/*
+ * ring_enter: take up to TO_SUBMIT requests from the ring at URING
+ * and do them, or with RING_ENTER_ASYNC hand them to the worker; then
+ * wait until there are at least MIN_COMPLETE completions to reap, or
+ * nothing left in flight to wait for. Returns the number taken.
+ */
+int
+sys_ring_enter(userptr_t uring, unsigned to_submit, unsigned min_complete,
+	       int flags, int *retval)
+{
+	struct ring_sqe sqes[RING_CHUNK];
+	struct ringctx *ctx;
+	struct ring r;
+	unsigned done, n;
+	int result;
+
+	if (flags & ~RING_ENTER_ASYNC) {
+		return EINVAL;
+	}
+
+	ctx = ring_getctx(curproc);
+	if (ctx == NULL) {
+		return ENOMEM;
+	}
+
+	done = 0;
+	result = 0;
+	lock_acquire(ctx->rc_lock);
+	while (done < to_submit) {
+		if (flags & RING_ENTER_ASYNC) {
+			result = ring_queue(ctx, uring, to_submit - done, &n);
+		}
+		else {
+			result = ring_take(ctx, uring, sqes,
+					   to_submit - done < RING_CHUNK ?
+					   to_submit - done : RING_CHUNK, &n);
+			if (result == 0 && n > 0) {
+				lock_release(ctx->rc_lock);
+				ring_run(ctx, uring, sqes, n);
+				lock_acquire(ctx->rc_lock);
+			}
+		}
+		if (result || n == 0) {
+			break;
+		}
+		done += n;
+	}
+
+	/* Report what was taken, if anything, rather than the error. */
+	if (result && done == 0) {
+		lock_release(ctx->rc_lock);
+		return result;
+	}
+
+	while (min_complete > 0 && ctx->rc_inflight > 0) {
+		if (ring_gethdr(uring, &r) ||
+		    r.r_cqtail - r.r_cqhead >= min_complete) {
+			break;
+		}
+		cv_wait(ctx->rc_cv, ctx->rc_lock);
+	}
+	lock_release(ctx->rc_lock);
+
+	*retval = done;
+	return 0;
+}
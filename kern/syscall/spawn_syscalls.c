@@ -0,0 +1,344 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * spawn: start a new process running a program, without making a
+ * copy of the caller first.
+ *
+ * fork copies the caller's address space and file table only for
+ * execv to throw the address space away again. spawn builds the new
+ * process directly: the parent copies in the path, the arguments and
+ * the file actions, opens the program, and sets up the child's file
+ * table; then the child's first thread creates the address space,
+ * loads the program into it and goes to user mode. The parent waits
+ * for the load, so a bad executable is reported by spawn itself.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <kern/spawn.h>
+#include <limits.h>
+#include <lib.h>
+#include <synch.h>
+#include <thread.h>
+#include <proc.h>
+#include <current.h>
+#include <addrspace.h>
+#include <vfs.h>
+#include <vnode.h>
+#include <stat.h>
+#include <copyinout.h>
+#include <kern/fdesc.h>
+#include <filetable.h>
+#include <execargs.h>
+#include <syscall.h>
+
+/*
+ * What the parent hands the child's first thread. It lives on the
+ * parent's stack; the parent waits on si_done before it goes away.
+ */
+struct spawninfo {
+	struct vnode *si_vn;		/* Program to load */
+	struct execargs *si_args;	/* Its arguments */
+	struct semaphore *si_done;	/* Upped when loaded, or not */
+	int si_result;
+};
+
+/*
+ * First thing the child runs: load the program and go to user mode.
+ */
+static
+void
+spawn_start(void *data1, unsigned long data2)
+{
+	struct spawninfo *si = data1;
+	struct addrspace *as;
+	vaddr_t entrypoint, stackptr;
+	userptr_t uargv;
+	int argc, result;
+
+	(void)data2;
+
+	as = as_create();
+	if (as == NULL) {
+		result = ENOMEM;
+		goto fail;
+	}
+	proc_setas(as);
+	as_activate();
+
+	result = load_elf(si->si_vn, &entrypoint);
+	if (result) {
+		goto fail;
+	}
+
+	result = as_define_stack(as, &stackptr);
+	if (result) {
+		goto fail;
+	}
+
+	result = execargs_copyout(si->si_args, &stackptr, &uargv);
+	if (result) {
+		goto fail;
+	}
+	argc = si->si_args->ea_argc;
+
+	// The parent may free si once it's been told
+	si->si_result = 0;
+	V(si->si_done);
+
+	enter_new_process(argc, uargv, NULL, stackptr, entrypoint);
+
+ fail:
+	/*
+	 * Leave the half-built process for the parent to destroy. Move
+	 * this thread over to the kernel process first, so the child
+	 * has no threads left by the time the parent hears about it.
+	 */
+	as_deactivate();
+	proc_remthread(curthread);
+	proc_addthread(kproc, curthread);
+	si->si_result = result;
+	V(si->si_done);
+	thread_exit();
+}
+
+/*
+ * SPAWN_OPEN: open the file and put it at the action's descriptor.
+ */
+static
+int
+spawn_open(struct filetable *ft, const struct spawn_action *sa)
+{
+	struct stat st;
+	struct fdesc *fd, *oldfd;
+	struct vnode *vn;
+	char *path;
+	int result;
+
+	switch (sa->sa_flags & O_ACCMODE) {
+	    case O_RDONLY:
+	    case O_WRONLY:
+	    case O_RDWR:
+		break;
+	    default:
+		return EINVAL;
+	}
+
+	path = kmalloc(PATH_MAX);
+	if (path == NULL) {
+		return ENOMEM;
+	}
+	result = copyinstr(sa->sa_path, path, PATH_MAX, NULL);
+	if (result) {
+		kfree(path);
+		return result;
+	}
+
+	result = vfs_open(path, sa->sa_flags, sa->sa_mode, &vn);
+	if (result) {
+		kfree(path);
+		return result;
+	}
+
+	fd = fdesc_create(path, vn, sa->sa_flags);
+	kfree(path);
+	if (fd == NULL) {
+		vfs_close(vn);
+		return ENOMEM;
+	}
+
+	if (sa->sa_flags & O_APPEND) {
+		result = VOP_STAT(fd->vn, &st);
+		if (result) {
+			fdesc_decref(fd);
+			return result;
+		}
+		fd->ofst = st.st_size;
+	}
+
+	result = filetable_placeat(ft, fd, sa->sa_fd, &oldfd);
+	if (result) {
+		fdesc_decref(fd);
+		return result;
+	}
+	if (oldfd != NULL) {
+		fdesc_decref(oldfd);
+	}
+	return 0;
+}
+
+/*
+ * Apply the file actions to the child's file table FT, in order.
+ */
+static
+int
+spawn_actions(struct filetable *ft, const struct spawn_action *acts, int n)
+{
+	struct fdesc *fd, *oldfd;
+	int i, result;
+
+	for (i = 0; i < n; i++) {
+		switch (acts[i].sa_op) {
+		    case SPAWN_OPEN:
+			result = spawn_open(ft, &acts[i]);
+			break;
+		    case SPAWN_DUP2:
+			result = filetable_get(ft, acts[i].sa_fd, &fd);
+			if (result) {
+				break;
+			}
+			result = filetable_placeat(ft, fd, acts[i].sa_newfd,
+						   &oldfd);
+			if (result) {
+				fdesc_decref(fd);
+				break;
+			}
+			if (oldfd != NULL) {
+				fdesc_decref(oldfd);
+			}
+			break;
+		    case SPAWN_CLOSE:
+			result = filetable_remove(ft, acts[i].sa_fd, &fd);
+			if (result) {
+				break;
+			}
+			fdesc_decref(fd);
+			break;
+		    default:
+			result = EINVAL;
+			break;
+		}
+		if (result) {
+			return result;
+		}
+	}
+	return 0;
+}
+
+int
+sys_spawn(const_userptr_t upath, userptr_t uargv, const_userptr_t uactions,
+	  int nactions, int *retval)
+{
+	struct spawn_action actions[SPAWN_MAXACTIONS];
+	struct spawninfo si;
+	struct execargs args;
+	struct proc *newproc;
+	struct vnode *vn;
+	char *path;
+	pid_t pid;
+	int result;
+
+	if (nactions < 0 || nactions > SPAWN_MAXACTIONS) {
+		return EINVAL;
+	}
+	if (nactions > 0) {
+		result = copyin(uactions, actions,
+				nactions * sizeof(actions[0]));
+		if (result) {
+			return result;
+		}
+	}
+
+	path = kmalloc(PATH_MAX);
+	if (path == NULL) {
+		return ENOMEM;
+	}
+	result = copyinstr(upath, path, PATH_MAX, NULL);
+	if (result) {
+		goto fail_path;
+	}
+
+	result = execargs_copyin(&args, uargv);
+	if (result) {
+		goto fail_args;
+	}
+
+	// Name it now; vfs_open may scribble on the path
+	newproc = proc_create_runprogram(path, curproc);
+	if (newproc == NULL) {
+		result = ENOMEM;
+		goto fail_args;
+	}
+	pid = newproc->p_pid;
+
+	result = vfs_open(path, O_RDONLY, 0, &vn);
+	if (result) {
+		goto fail_proc;
+	}
+
+	// The child starts with the parent's files, then the actions
+	result = filetable_copy(curproc->p_ftable, newproc->p_ftable);
+	if (result) {
+		goto fail_vn;
+	}
+	result = spawn_actions(newproc->p_ftable, actions, nactions);
+	if (result) {
+		goto fail_vn;
+	}
+
+	si.si_vn = vn;
+	si.si_args = &args;
+	si.si_result = 0;
+	si.si_done = sem_create("spawn", 0);
+	if (si.si_done == NULL) {
+		result = ENOMEM;
+		goto fail_vn;
+	}
+
+	result = thread_fork(newproc->p_name, newproc, spawn_start, &si, 0);
+	if (result) {
+		goto fail_sem;
+	}
+	P(si.si_done);
+	result = si.si_result;
+	if (result == 0) {
+		// The child is off on its own now
+		newproc = NULL;
+	}
+
+ fail_sem:
+	sem_destroy(si.si_done);
+ fail_vn:
+	vfs_close(vn);
+ fail_proc:
+	if (newproc != NULL) {
+		proc_destroy(newproc);
+	}
+ fail_args:
+	execargs_cleanup(&args);
+ fail_path:
+	kfree(path);
+
+	if (result == 0) {
+		*retval = pid;
+	}
+	return result;
+}
@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * System call statistics.
+ * The interface is documented in syscallstat.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <spl.h>
+#include <clock.h>
+#include <cpu.h>
+#include <current.h>
+#include <platform/maxcpus.h>
+#include <copyinout.h>
+#include <syscall.h>
+#include <syscallstat.h>
+
+/* One per cpu, indexed by c_number. */
+static struct syscallstat *syscallstats[MAXCPUS];
+
+void
+syscallstat_create(struct cpu *c)
+{
+	struct syscallstat *st;
+
+	KASSERT(c->c_number < MAXCPUS);
+	KASSERT(syscallstats[c->c_number] == NULL);
+
+	st = kmalloc(SYSCALLSTAT_NCALLS * sizeof(*st));
+	if (st == NULL) {
+		panic("syscallstat_create: Out of memory\n");
+	}
+	bzero(st, SYSCALLSTAT_NCALLS * sizeof(*st));
+	syscallstats[c->c_number] = st;
+}
+
+uint64_t
+syscallstat_enter(int callno)
+{
+	struct syscallstat *st;
+	int spl;
+
+	if (callno < 0 || callno >= SYSCALLSTAT_NCALLS) {
+		return 0;
+	}
+
+	spl = splhigh();
+	st = syscallstats[curcpu->c_number];
+	if (st != NULL) {
+		st[callno].ss_calls++;
+	}
+	splx(spl);
+
+	return cpu_cycles();
+}
+
+/*
+ * Which latency bucket a call taking CYCLES goes in: the position of
+ * its highest set bit.
+ */
+static
+unsigned
+syscallstat_bucket(uint64_t cycles)
+{
+	uint32_t c;
+	unsigned b;
+
+	if (cycles >> SYSCALLSTAT_NBUCKETS != 0) {
+		return SYSCALLSTAT_NBUCKETS - 1;
+	}
+	for (c = cycles, b = 0; c > 1; c >>= 1) {
+		b++;
+	}
+	return b;
+}
+
+void
+syscallstat_exit(int callno, int err, uint64_t start)
+{
+	struct syscallstat *st;
+	uint64_t now;
+	unsigned b;
+	int spl;
+
+	if (callno < 0 || callno >= SYSCALLSTAT_NCALLS) {
+		return;
+	}
+
+	/* We may have moved cpus; their counters aren't quite in step. */
+	now = cpu_cycles();
+	b = syscallstat_bucket(now > start ? now - start : 0);
+
+	spl = splhigh();
+	st = syscallstats[curcpu->c_number];
+	if (st != NULL) {
+		if (err) {
+			st[callno].ss_errors++;
+		}
+		st[callno].ss_lat[b]++;
+	}
+	splx(spl);
+}
+
+/*
+ * Add cpu CPU's counts for CALLNO into RET.
+ */
+static
+void
+syscallstat_add(int callno, unsigned cpu, struct syscallstat *ret)
+{
+	const struct syscallstat *st;
+	unsigned i;
+
+	st = syscallstats[cpu];
+	if (st == NULL) {
+		return;
+	}
+	st += callno;
+	ret->ss_calls += st->ss_calls;
+	ret->ss_errors += st->ss_errors;
+	for (i=0; i<SYSCALLSTAT_NBUCKETS; i++) {
+		ret->ss_lat[i] += st->ss_lat[i];
+	}
+}
+
+int
+syscallstat_get(int callno, int cpu, struct syscallstat *ret)
+{
+	unsigned i;
+
+	if (callno < 0 || callno >= SYSCALLSTAT_NCALLS) {
+		return EINVAL;
+	}
+	if (cpu != SYSCALLSTAT_ALLCPUS &&
+	    (cpu < 0 || (unsigned)cpu >= num_cpus)) {
+		return EINVAL;
+	}
+
+	bzero(ret, sizeof(*ret));
+	if (cpu != SYSCALLSTAT_ALLCPUS) {
+		syscallstat_add(callno, cpu, ret);
+		return 0;
+	}
+	for (i=0; i<num_cpus; i++) {
+		syscallstat_add(callno, i, ret);
+	}
+	return 0;
+}
+
+/*
+ * The bucket the PCT-th percentile of ST's latencies falls in, out of
+ * TOTAL calls that returned.
+ */
+static
+unsigned
+syscallstat_pct(const struct syscallstat *st, uint64_t total, unsigned pct)
+{
+	uint64_t sofar;
+	unsigned i;
+
+	sofar = 0;
+	for (i=0; i<SYSCALLSTAT_NBUCKETS - 1; i++) {
+		sofar += st->ss_lat[i];
+		if (sofar * 100 >= total * pct) {
+			break;
+		}
+	}
+	return i;
+}
+
+/* Upper end of bucket B, in cycles. */
+#define BUCKETTOP(b)	((uint64_t)2 << (b))
+
+/*
+ * Print one line per call made: the counts, and the median, 99th
+ * percentile and largest latency, each as the top of the bucket it
+ * fell in. Or, if CALLNO isn't -1, the histogram for just that call.
+ */
+void
+syscallstat_dump(int callno)
+{
+	struct syscallstat st;
+	uint64_t total;
+	unsigned i, max;
+	int n;
+
+	if (callno >= 0) {
+		if (syscallstat_get(callno, SYSCALLSTAT_ALLCPUS, &st)) {
+			kprintf("syscallstat: No call %d\n", callno);
+			return;
+		}
+		kprintf("syscall %d: %llu calls, %llu errors\n",
+			callno, st.ss_calls, st.ss_errors);
+		kprintf("%12s %10s\n", "cycles <", "calls");
+		for (i=0; i<SYSCALLSTAT_NBUCKETS; i++) {
+			if (st.ss_lat[i] == 0) {
+				continue;
+			}
+			if (i == SYSCALLSTAT_NBUCKETS - 1) {
+				kprintf("%12s %10u\n", "(more)", st.ss_lat[i]);
+			}
+			else {
+				kprintf("%12llu %10u\n", BUCKETTOP(i),
+					st.ss_lat[i]);
+			}
+		}
+		return;
+	}
+
+	kprintf("%4s %10s %8s %12s %12s %12s\n",
+		"call", "calls", "errors", "p50 <", "p99 <", "max <");
+	for (n=0; n<SYSCALLSTAT_NCALLS; n++) {
+		syscallstat_get(n, SYSCALLSTAT_ALLCPUS, &st);
+		if (st.ss_calls == 0) {
+			continue;
+		}
+		total = 0;
+		max = 0;
+		for (i=0; i<SYSCALLSTAT_NBUCKETS; i++) {
+			total += st.ss_lat[i];
+			if (st.ss_lat[i] != 0) {
+				max = i;
+			}
+		}
+		if (total == 0) {
+			kprintf("%4d %10llu %8llu\n",
+				n, st.ss_calls, st.ss_errors);
+			continue;
+		}
+		kprintf("%4d %10llu %8llu %12llu %12llu %12llu\n",
+			n, st.ss_calls, st.ss_errors,
+			BUCKETTOP(syscallstat_pct(&st, total, 50)),
+			BUCKETTOP(syscallstat_pct(&st, total, 99)),
+			BUCKETTOP(max));
+	}
+}
+
+/*
+ * syscallstat: copy out the counts for CALLNO on cpu CPU (or all
+ * cpus) to BUF.
+ */
+int
+sys_syscallstat(int callno, int cpu, userptr_t buf)
+{
+	struct syscallstat st;
+	int result;
+
+	result = syscallstat_get(callno, cpu, &st);
+	if (result) {
+		return result;
+	}
+	return copyout(&st, buf, sizeof(st));
+}
@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * User-level threads.
+ *
+ * threadfork starts a new thread in the calling process. It shares
+ * the address space and the file table with the other threads of the
+ * process and gets its own trapframe, copied from the caller's, so
+ * things like the global pointer come along. The caller supplies the
+ * stack; libc's threadfork wrapper sets it up.
+ *
+ * Each new thread gets a thread id, unique within the process, and a
+ * struct uthread on the process's p_uthreads list that holds its exit
+ * status until someone collects it with threadjoin. The thread that
+ * started the process is thread 0 and can't be joined.
+ *
+ * Each thread created here also holds a reference to the process's
+ * address space for as long as it runs, so the address space can't
+ * be torn down under it (see as_decref).
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <mips/trapframe.h>
+#include <synch.h>
+#include <thread.h>
+#include <proc.h>
+#include <current.h>
+#include <addrspace.h>
+#include <copyinout.h>
+#include <syscall.h>
+
+/*
+ * First thing a new user thread runs, in the kernel: get off the
+ * heap copy of the trapframe and go to user mode. DATA1 is the
+ * trapframe and DATA2 the thread id.
+ */
+static
+void
+uthread_start(void *data1, unsigned long data2)
+{
+	struct trapframe *ktf = data1;
+	struct trapframe tf;
+
+	curthread->t_tid = data2;
+
+	tf = *ktf;
+	kfree(ktf);
+
+	as_activate();
+	mips_usermode(&tf);
+}
+
+/*
+ * Find the record for thread TID. p_thlock must be held.
+ */
+static
+struct uthread *
+uthread_find(struct proc *proc, int tid)
+{
+	struct uthread *ut;
+
+	KASSERT(lock_do_i_hold(proc->p_thlock));
+
+	for (ut = proc->p_uthreads; ut != NULL; ut = ut->ut_next) {
+		if (ut->ut_tid == tid) {
+			return ut;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Take UT off the process's list. p_thlock must be held.
+ */
+static
+void
+uthread_unlink(struct proc *proc, struct uthread *ut)
+{
+	struct uthread **p;
+
+	KASSERT(lock_do_i_hold(proc->p_thlock));
+
+	for (p = &proc->p_uthreads; *p != ut; p = &(*p)->ut_next) {
+		KASSERT(*p != NULL);
+	}
+	*p = ut->ut_next;
+}
+
+/*
+ * threadfork: start a thread at user address ENTRY with ARG in a0
+ * and stack pointer STACKPTR. Returns the new thread's id.
+ */
+int
+sys___threadfork(struct trapframe *tf, userptr_t entry, userptr_t arg,
+		 userptr_t stackptr, int *retval)
+{
+	struct proc *proc = curproc;
+	struct trapframe *ntf;
+	struct uthread *ut;
+	struct addrspace *as;
+	int tid, result;
+
+	/* The ABI wants doubleword-aligned stacks. */
+	if (((vaddr_t)stackptr & 7) != 0) {
+		return EINVAL;
+	}
+
+	as = proc_getas();
+	KASSERT(as != NULL);
+
+	ntf = kmalloc(sizeof(*ntf));
+	if (ntf == NULL) {
+		return ENOMEM;
+	}
+	ut = kmalloc(sizeof(*ut));
+	if (ut == NULL) {
+		kfree(ntf);
+		return ENOMEM;
+	}
+
+	*ntf = *tf;
+	ntf->tf_epc = (vaddr_t)entry;
+	ntf->tf_a0 = (vaddr_t)arg;
+	ntf->tf_sp = (vaddr_t)stackptr;
+	/* Returning from ENTRY is a bug; make it fault. */
+	ntf->tf_ra = 0;
+
+	ut->ut_exited = false;
+	ut->ut_joining = false;
+	ut->ut_status = 0;
+	/* Dropped in sys_threadexit. */
+	as_incref(as);
+	ut->ut_as = as;
+
+	/*
+	 * Put the record on the list only once the thread exists, so
+	 * nobody can start joining a thread that never runs. Hold
+	 * p_thlock across thread_fork so the new thread can't get to
+	 * threadexit and look for its record before it's there.
+	 */
+	lock_acquire(proc->p_thlock);
+	tid = proc->p_nexttid++;
+	result = thread_fork(curthread->t_name, proc, uthread_start,
+			     ntf, tid);
+	if (result) {
+		lock_release(proc->p_thlock);
+		as_decref(as);
+		kfree(ut);
+		kfree(ntf);
+		return result;
+	}
+	ut->ut_tid = tid;
+	ut->ut_next = proc->p_uthreads;
+	proc->p_uthreads = ut;
+	lock_release(proc->p_thlock);
+
+	/* Don't look at UT again; the thread may be gone and joined. */
+	*retval = tid;
+	return 0;
+}
+
+/*
+ * threadexit: end the calling thread, leaving STATUS for threadjoin.
+ * The other threads of the process keep running.
+ */
+__DEAD
+void
+sys_threadexit(int status)
+{
+	struct proc *proc = curproc;
+	struct uthread *ut;
+	struct addrspace *as;
+	int tid = curthread->t_tid;
+
+	if (tid != 0) {
+		lock_acquire(proc->p_thlock);
+		ut = uthread_find(proc, tid);
+		KASSERT(ut != NULL);
+		/* Once we let go, a joiner may free UT. */
+		as = ut->ut_as;
+		ut->ut_as = NULL;
+		ut->ut_exited = true;
+		ut->ut_status = status;
+		cv_broadcast(proc->p_thcv, proc->p_thlock);
+		lock_release(proc->p_thlock);
+
+		/* The reference taken in sys___threadfork. */
+		as_decref(as);
+	}
+
+	thread_exit();
+}
+
+/*
+ * threadjoin: wait for thread TID of this process to exit, and
+ * collect its status. Each thread can be joined once.
+ */
+int
+sys_threadjoin(int tid, userptr_t status)
+{
+	struct proc *proc = curproc;
+	struct uthread *ut;
+	int result, ustatus;
+
+	/* Joining yourself would never finish. */
+	if (tid == curthread->t_tid) {
+		return EINVAL;
+	}
+
+	lock_acquire(proc->p_thlock);
+	ut = uthread_find(proc, tid);
+	if (ut == NULL) {
+		lock_release(proc->p_thlock);
+		return ESRCH;
+	}
+	if (ut->ut_joining) {
+		lock_release(proc->p_thlock);
+		return EINVAL;
+	}
+	ut->ut_joining = true;
+
+	/* If the process is ending, give up; we're going too. */
+	while (!ut->ut_exited && !proc->p_exiting) {
+		cv_wait(proc->p_thcv, proc->p_thlock);
+	}
+	if (!ut->ut_exited) {
+		ut->ut_joining = false;
+		lock_release(proc->p_thlock);
+		return EINTR;
+	}
+
+	uthread_unlink(proc, ut);
+	lock_release(proc->p_thlock);
+
+	ustatus = ut->ut_status;
+	kfree(ut);
+
+	if (status != NULL) {
+		result = copyout(&ustatus, status, sizeof(ustatus));
+		if (result) {
+			return result;
+		}
+	}
+	return 0;
+}
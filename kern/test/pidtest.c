@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Pid allocator test code.
+ *
+ * Should be run with no user processes running, since it checks the
+ * order pids come out in.
+ */
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <limits.h>
+#include <proc.h>
+#include <pid.h>
+#include <test.h>
+
+#define NPROCS 64
+
+int
+pidtest(int nargs, char **args)
+{
+	struct proc *procs;
+	pid_t prev, pid;
+	unsigned i, n, wraps, total;
+	int result;
+
+	(void)nargs;
+	(void)args;
+
+	kprintf("Starting pid test...\n");
+
+	/* Only p_pid and p_pidrec are used; no need for proc_create. */
+	procs = kmalloc(NPROCS * sizeof(*procs));
+	if (procs == NULL) {
+		kprintf("pidtest: Out of memory\n");
+		return ENOMEM;
+	}
+
+	prev = 0;
+	for (i=0; i<NPROCS; i++) {
+		result = pid_alloc(&procs[i], NULL);
+		if (result) {
+			kprintf("pidtest: pid_alloc: %s\n", strerror(result));
+			kfree(procs);
+			return result;
+		}
+		KASSERT(procs[i].p_pid > prev);
+		KASSERT(pid_lookup(procs[i].p_pid) == &procs[i]);
+		prev = procs[i].p_pid;
+	}
+
+	/*
+	 * Recycle the slots round robin until the pids have wrapped
+	 * around twice. Each new pid should be the next one up (past
+	 * any in use), so a freed pid doesn't come back until the
+	 * whole space has gone by.
+	 */
+	total = 2 * (PID_MAX - PID_MIN + 1);
+	wraps = 0;
+	for (n=0; n<total; n++) {
+		i = n % NPROCS;
+		pid = procs[i].p_pid;
+		pid_free(&procs[i]);
+		KASSERT(pid_lookup(pid) == NULL);
+
+		result = pid_alloc(&procs[i], NULL);
+		if (result) {
+			kprintf("pidtest: pid_alloc: %s\n", strerror(result));
+			kfree(procs);
+			return result;
+		}
+		if (procs[i].p_pid < prev) {
+			wraps++;
+		}
+		KASSERT(procs[i].p_pid != pid);
+		KASSERT(pid_lookup(procs[i].p_pid) == &procs[i]);
+		prev = procs[i].p_pid;
+	}
+	KASSERT(wraps >= 2);
+
+	for (i=0; i<NPROCS; i++) {
+		pid_free(&procs[i]);
+	}
+	kfree(procs);
+
+	kprintf("pidtest: %u allocations, %u wraparounds\n",
+		total + NPROCS, wraps);
+	kprintf("Pid test done.\n");
+	return 0;
+}
@@ -0,0 +1,380 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Synchronization benchmarks.
+ *
+ * These don't check correctness (see synchtest.c and rwtest.c for
+ * that); they hammer a primitive from several threads for a few
+ * seconds and report throughput, so changes to the synchronization
+ * code can be compared on different numbers of cpus.
+ *
+ * Usage: <cmd> [nthreads]
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <clock.h>
+#include <thread.h>
+#include <spinlock.h>
+#include <synch.h>
+#include <test.h>
+
+#define BENCH_SECONDS		3
+#define BENCH_MAXTHREADS	32
+#define BENCH_DEFTHREADS	4
+
+static volatile bool bench_stop;
+static unsigned long bench_counts[BENCH_MAXTHREADS];
+static void (*bench_op)(unsigned long threadnum);
+static struct semaphore *bench_startsem;
+static struct semaphore *bench_donesem;
+
+static
+void
+bench_thread(void *junk, unsigned long num)
+{
+	unsigned long n = 0;
+
+	(void)junk;
+
+	P(bench_startsem);
+	while (!bench_stop) {
+		bench_op(num);
+		n++;
+	}
+	bench_counts[num] = n;
+	V(bench_donesem);
+}
+
+/*
+ * Get the thread count from the command line.
+ */
+static
+unsigned
+bench_nthreads(int nargs, char **args)
+{
+	int n;
+
+	if (nargs < 2) {
+		return BENCH_DEFTHREADS;
+	}
+	n = atoi(args[1]);
+	if (n < 1) {
+		n = 1;
+	}
+	if (n > BENCH_MAXTHREADS) {
+		n = BENCH_MAXTHREADS;
+	}
+	return n;
+}
+
+/*
+ * Run OP in a loop on NTHREADS threads for BENCH_SECONDS and print the
+ * total rate. The per-thread minimum and maximum are printed too, as
+ * a rough measure of fairness.
+ */
+static
+void
+bench_run(const char *name, void (*op)(unsigned long), unsigned nthreads)
+{
+	struct timespec start, end, diff;
+	uint64_t total, ns;
+	unsigned long min, max;
+	unsigned i;
+	int result;
+
+	KASSERT(nthreads > 0 && nthreads <= BENCH_MAXTHREADS);
+
+	bench_startsem = sem_create("benchstart", 0);
+	bench_donesem = sem_create("benchdone", 0);
+	if (bench_startsem == NULL || bench_donesem == NULL) {
+		panic("%s: sem_create failed\n", name);
+	}
+	bench_op = op;
+	bench_stop = false;
+
+	for (i=0; i<nthreads; i++) {
+		bench_counts[i] = 0;
+		result = thread_fork(name, NULL, bench_thread, NULL, i);
+		if (result) {
+			panic("%s: thread_fork failed: %s\n", name,
+			      strerror(result));
+		}
+	}
+
+	gettime(&start);
+	for (i=0; i<nthreads; i++) {
+		V(bench_startsem);
+	}
+	clocksleep(BENCH_SECONDS);
+	bench_stop = true;
+	for (i=0; i<nthreads; i++) {
+		P(bench_donesem);
+	}
+	gettime(&end);
+
+	total = 0;
+	min = max = bench_counts[0];
+	for (i=0; i<nthreads; i++) {
+		total += bench_counts[i];
+		if (bench_counts[i] < min) {
+			min = bench_counts[i];
+		}
+		if (bench_counts[i] > max) {
+			max = bench_counts[i];
+		}
+	}
+	timespec_sub(&end, &start, &diff);
+	ns = (uint64_t)diff.tv_sec * 1000000000 + diff.tv_nsec;
+
+	kprintf("%s: %u threads, %llu ops in %llu.%09lu s: %llu ops/sec\n",
+		name, nthreads, total, (unsigned long long)diff.tv_sec,
+		(unsigned long)diff.tv_nsec,
+		ns == 0 ? 0ULL : total * 1000000000ULL / ns);
+	kprintf("%s: per thread: min %lu, max %lu\n", name, min, max);
+
+	sem_destroy(bench_startsem);
+	sem_destroy(bench_donesem);
+	bench_startsem = bench_donesem = NULL;
+}
+
+////////////////////////////////////////////////////////////
+// spinlocks
+
+static struct spinlock benchspinlock;
+static volatile unsigned long benchval;
+
+static
+void
+spinlockbench_op(unsigned long num)
+{
+	(void)num;
+
+	spinlock_acquire(&benchspinlock);
+	benchval++;
+	spinlock_release(&benchspinlock);
+}
+
+/*
+ * Spinlock contention benchmark: every thread takes the same
+ * spinlock. With FIFO spinlocks the per-thread counts should come out
+ * close to even.
+ */
+int
+spinlockbench(int nargs, char **args)
+{
+	spinlock_init(&benchspinlock);
+	benchval = 0;
+
+	bench_run("spinlockbench", spinlockbench_op,
+		  bench_nthreads(nargs, args));
+
+	spinlock_cleanup(&benchspinlock);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////
+// locks
+
+static struct lock *benchlock;
+
+static
+void
+lockbench_op(unsigned long num)
+{
+	(void)num;
+
+	lock_acquire(benchlock);
+	benchval++;
+	lock_release(benchlock);
+}
+
+/*
+ * Lock contention benchmark: every thread takes the same lock with a
+ * tiny critical section, which is where adaptive spinning matters.
+ */
+int
+lockbench(int nargs, char **args)
+{
+	benchlock = lock_create("lockbench");
+	if (benchlock == NULL) {
+		panic("lockbench: lock_create failed\n");
+	}
+	benchval = 0;
+
+	bench_run("lockbench", lockbench_op, bench_nthreads(nargs, args));
+
+	lock_destroy(benchlock);
+	benchlock = NULL;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////
+// rwlocks
+
+#define RWBENCH_WRITEEVERY	100
+
+static struct rwlock *benchrwlock;
+
+static
+void
+rwlockbench_op(unsigned long num)
+{
+	/* Per-thread op count; each thread only touches its own slot. */
+	static unsigned long opcounts[BENCH_MAXTHREADS];
+
+	if (++opcounts[num] % RWBENCH_WRITEEVERY == 0) {
+		rwlock_acquire_write(benchrwlock);
+		benchval++;
+		rwlock_release_write(benchrwlock);
+	}
+	else {
+		rwlock_acquire_read(benchrwlock);
+		/* benchval is volatile, so this read isn't optimized out. */
+		(void)benchval;
+		rwlock_release_read(benchrwlock);
+	}
+}
+
+/*
+ * Read-mostly rwlock benchmark: one operation in RWBENCH_WRITEEVERY is
+ * a write, the rest are reads. Run it with the same thread count on
+ * different numbers of cpus to see how reads scale.
+ */
+int
+rwlockbench(int nargs, char **args)
+{
+	benchrwlock = rwlock_create("rwlockbench");
+	if (benchrwlock == NULL) {
+		panic("rwlockbench: rwlock_create failed\n");
+	}
+	benchval = 0;
+
+	bench_run("rwlockbench", rwlockbench_op, bench_nthreads(nargs, args));
+	kprintf("rwlockbench: %lu writes\n", benchval);
+
+	rwlock_destroy(benchrwlock);
+	benchrwlock = NULL;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////
+// wakeup storms
+
+#define WAKEBENCH_ROUNDS	200
+
+static struct lock *wakelock;
+static struct cv *wakecv;
+static struct semaphore *wakedonesem;
+static volatile unsigned wakegen;
+
+static
+void
+wakebench_thread(void *junk, unsigned long num)
+{
+	unsigned gen;
+
+	(void)junk;
+	(void)num;
+
+	lock_acquire(wakelock);
+	for (gen = 0; gen < WAKEBENCH_ROUNDS; gen++) {
+		while (wakegen == gen) {
+			cv_wait(wakecv, wakelock);
+		}
+		V(wakedonesem);
+	}
+	lock_release(wakelock);
+	V(wakedonesem);
+}
+
+/*
+ * Wakeup storm benchmark: NTHREADS threads wait on one CV, and each
+ * round broadcasts to all of them and waits until every one has run.
+ * Reports the average time per round, which is mostly the cost of
+ * getting all the sleepers onto run queues and running again.
+ */
+int
+wakebench(int nargs, char **args)
+{
+	struct timespec start, end, diff;
+	unsigned nthreads, i, round;
+	uint64_t ns;
+	int result;
+
+	nthreads = bench_nthreads(nargs, args);
+
+	wakelock = lock_create("wakebench");
+	wakecv = cv_create("wakebench");
+	wakedonesem = sem_create("wakedone", 0);
+	if (wakelock == NULL || wakecv == NULL || wakedonesem == NULL) {
+		panic("wakebench: out of memory\n");
+	}
+	wakegen = 0;
+
+	for (i=0; i<nthreads; i++) {
+		result = thread_fork("wakebench", NULL, wakebench_thread,
+				     NULL, i);
+		if (result) {
+			panic("wakebench: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+
+	gettime(&start);
+	for (round = 0; round < WAKEBENCH_ROUNDS; round++) {
+		lock_acquire(wakelock);
+		wakegen++;
+		cv_broadcast(wakecv, wakelock);
+		lock_release(wakelock);
+		for (i=0; i<nthreads; i++) {
+			P(wakedonesem);
+		}
+	}
+	gettime(&end);
+
+	/* Wait for the threads to let go of the lock and exit. */
+	for (i=0; i<nthreads; i++) {
+		P(wakedonesem);
+	}
+
+	timespec_sub(&end, &start, &diff);
+	ns = (uint64_t)diff.tv_sec * 1000000000 + diff.tv_nsec;
+	kprintf("wakebench: %u threads, %u rounds: %llu us per round\n",
+		nthreads, WAKEBENCH_ROUNDS, ns / WAKEBENCH_ROUNDS / 1000);
+
+	sem_destroy(wakedonesem);
+	cv_destroy(wakecv);
+	lock_destroy(wakelock);
+	wakedonesem = NULL;
+	wakecv = NULL;
+	wakelock = NULL;
+	return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Workqueue test code.
+ */
+#include <types.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <clock.h>
+#include <workqueue.h>
+#include <test.h>
+
+#define NWORK 32
+
+static struct spinlock wqt_lock = SPINLOCK_INITIALIZER;
+static volatile unsigned wqt_ran;
+
+static
+void
+wqt_func(void *data1, unsigned long num)
+{
+	volatile unsigned long *slot = data1;
+
+	spinlock_acquire(&wqt_lock);
+	*slot = num;
+	wqt_ran++;
+	spinlock_release(&wqt_lock);
+}
+
+int
+workqueuetest(int nargs, char **args)
+{
+	static struct work works[NWORK];
+	static volatile unsigned long results[NWORK];
+	struct work delayed, cancelled;
+	volatile unsigned long dummy;
+	unsigned i;
+
+	(void)nargs;
+	(void)args;
+
+	kprintf("Starting workqueue test...\n");
+	wqt_ran = 0;
+
+	/* Immediate work, then a flush. */
+	for (i=0; i<NWORK; i++) {
+		results[i] = 0;
+		work_init(&works[i], wqt_func, (void *)&results[i], i+1);
+		KASSERT(work_queue(&works[i]));
+	}
+	/* Queueing again while pending must be refused (or it already ran). */
+	(void)work_queue(&works[0]);
+	workqueue_flush();
+	for (i=0; i<NWORK; i++) {
+		work_flush(&works[i]);
+		KASSERT(results[i] == i+1);
+	}
+	kprintf("  immediate work ok (%u items run)\n", wqt_ran);
+
+	/* Delayed work; flushing it waits out the delay. */
+	dummy = 0;
+	work_init(&delayed, wqt_func, (void *)&dummy, 7);
+	KASSERT(work_queue_delayed(&delayed, HZ / 10));
+	KASSERT(!work_queue_delayed(&delayed, HZ / 10));
+	work_flush(&delayed);
+	KASSERT(dummy == 7);
+	kprintf("  delayed work ok\n");
+
+	/* Cancelled work never runs. */
+	dummy = 0;
+	work_init(&cancelled, wqt_func, (void *)&dummy, 9);
+	KASSERT(work_queue_delayed(&cancelled, HZ));
+	KASSERT(work_cancel(&cancelled));
+	KASSERT(!work_cancel(&cancelled));
+	work_flush(&cancelled);
+	KASSERT(dummy == 0);
+	kprintf("  cancel ok\n");
+
+	for (i=0; i<NWORK; i++) {
+		work_cleanup(&works[i]);
+	}
+	work_cleanup(&delayed);
+	work_cleanup(&cancelled);
+
+	kprintf("Workqueue test done.\n");
+	return 0;
+}
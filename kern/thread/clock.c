@@ -34,6 +34,7 @@
 #include <clock.h>
 #include <thread.h>
 #include <current.h>
+#include <workqueue.h>
 
 /*
  * Time handling.
@@ -66,6 +67,7 @@ void
 hardclock_bootstrap(void)
 {
 	spinlock_init(&lbolt_lock);
+	spinlock_setname(&lbolt_lock, "lbolt_lock");
 	lbolt = wchan_create("lbolt");
 	if (lbolt == NULL) {
 		panic("Couldn't create lbolt\n");
@@ -97,6 +99,7 @@ hardclock(void)
 	 */
 
 	curcpu->c_hardclocks++;
+	workqueue_hardclock();
 	if ((curcpu->c_hardclocks % MIGRATE_HARDCLOCKS) == 0) {
 		thread_consider_migration();
 	}
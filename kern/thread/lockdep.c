@@ -0,0 +1,400 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Lock order validator.
+ * The interface is documented in lockdep.h.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <spl.h>
+#include <membar.h>
+#include <spinlock.h>
+#include <lockdep.h>
+
+/* Sizes of the tables; powers of two. Nothing is ever removed. */
+#define LOCKDEP_NAMELEN		32
+#define LOCKDEP_MAXCLASSES	256
+#define LOCKDEP_MAXEDGES	1024
+
+struct lockdep_class {
+	char c_name[LOCKDEP_NAMELEN];	/* Empty if slot unused */
+	struct lockdep_edge *c_edges;	/* Edges out of this class */
+	unsigned c_visited;		/* Search generation */
+	struct lockdep_class *c_parent;	/* Search back-pointer */
+};
+
+/*
+ * An edge FROM -> TO means TO has been acquired while holding FROM.
+ * e_from is set last, with a barrier, so lockdep_findedge can use the
+ * table without taking lockdep_lock.
+ */
+struct lockdep_edge {
+	struct lockdep_class *volatile e_from;	/* NULL if slot unused */
+	struct lockdep_class *e_to;
+	struct lockdep_edge *e_next;	/* Next edge out of e_from */
+};
+
+/* Protects everything except lock-free reads of the edge table. */
+static struct spinlock lockdep_lock = SPINLOCK_INITIALIZER_NAMED("lockdep");
+
+static struct lockdep_class lockdep_classes[LOCKDEP_MAXCLASSES];
+static struct lockdep_edge lockdep_edges[LOCKDEP_MAXEDGES];
+static unsigned lockdep_nclasses;
+static unsigned lockdep_nedges;
+static unsigned lockdep_visitgen;
+static bool lockdep_full;
+
+/* Search stack for lockdep_findpath; each class goes on at most once. */
+static struct lockdep_class *lockdep_stack[LOCKDEP_MAXCLASSES];
+
+/*
+ * Complain, once, that a table filled up. Called without lockdep_lock,
+ * since kprintf takes locks of its own; so the message might rarely
+ * come out twice.
+ */
+static
+void
+lockdep_warnfull(void)
+{
+	if (!lockdep_full) {
+		lockdep_full = true;
+		kprintf("lockdep: Tables full; checking is incomplete\n");
+	}
+}
+
+////////////////////////////////////////////////////////////
+// classes
+
+/*
+ * Compare a class name against a lock name. Class names are truncated
+ * to LOCKDEP_NAMELEN-1 characters, so only compare that much.
+ */
+static
+bool
+lockdep_namematch(const char *cname, const char *name)
+{
+	unsigned i;
+
+	for (i=0; i<LOCKDEP_NAMELEN-1; i++) {
+		if (cname[i] != name[i]) {
+			return false;
+		}
+		if (name[i] == 0) {
+			return true;
+		}
+	}
+	return true;
+}
+
+static
+unsigned
+lockdep_namehash(const char *name)
+{
+	unsigned hash = 5381;
+	unsigned i;
+
+	for (i=0; i<LOCKDEP_NAMELEN-1 && name[i] != 0; i++) {
+		hash = hash * 33 + (unsigned char)name[i];
+	}
+	return hash;
+}
+
+/*
+ * Find or create the class for NAME. Returns NULL if the class table
+ * is full.
+ */
+static
+struct lockdep_class *
+lockdep_getclass(const char *name)
+{
+	struct lockdep_class *c;
+	unsigned i, n;
+
+	spinlock_acquire(&lockdep_lock);
+	i = lockdep_namehash(name) & (LOCKDEP_MAXCLASSES - 1);
+	for (n=0; n<LOCKDEP_MAXCLASSES; n++) {
+		c = &lockdep_classes[i];
+		if (c->c_name[0] == 0) {
+			break;
+		}
+		if (lockdep_namematch(c->c_name, name)) {
+			spinlock_release(&lockdep_lock);
+			return c;
+		}
+		i = (i + 1) & (LOCKDEP_MAXCLASSES - 1);
+	}
+
+	if (lockdep_nclasses >= LOCKDEP_MAXCLASSES * 3 / 4) {
+		spinlock_release(&lockdep_lock);
+		lockdep_warnfull();
+		return NULL;
+	}
+
+	/* An empty name would look like an unused slot. */
+	snprintf(c->c_name, sizeof(c->c_name), "%s",
+		 name[0] != 0 ? name : "(noname)");
+	c->c_edges = NULL;
+	c->c_visited = 0;
+	c->c_parent = NULL;
+	lockdep_nclasses++;
+	spinlock_release(&lockdep_lock);
+	return c;
+}
+
+////////////////////////////////////////////////////////////
+// edges
+
+static
+unsigned
+lockdep_edgehash(struct lockdep_class *from, struct lockdep_class *to)
+{
+	unsigned f = from - lockdep_classes;
+	unsigned t = to - lockdep_classes;
+
+	return (f * 2654435761U) ^ (t * 40503U);
+}
+
+/*
+ * Check if the edge FROM -> TO is known. Does not need lockdep_lock.
+ */
+static
+bool
+lockdep_findedge(struct lockdep_class *from, struct lockdep_class *to)
+{
+	struct lockdep_edge *e;
+	struct lockdep_class *efrom;
+	unsigned i, n;
+
+	i = lockdep_edgehash(from, to) & (LOCKDEP_MAXEDGES - 1);
+	for (n=0; n<LOCKDEP_MAXEDGES; n++) {
+		e = &lockdep_edges[i];
+		efrom = e->e_from;
+		if (efrom == NULL) {
+			return false;
+		}
+		membar_load_load();
+		if (efrom == from && e->e_to == to) {
+			return true;
+		}
+		i = (i + 1) & (LOCKDEP_MAXEDGES - 1);
+	}
+	return false;
+}
+
+/*
+ * Look for a path of known edges from START to TARGET, leaving
+ * c_parent pointers along it. lockdep_lock must be held.
+ */
+static
+bool
+lockdep_findpath(struct lockdep_class *start, struct lockdep_class *target)
+{
+	struct lockdep_class *c;
+	struct lockdep_edge *e;
+	unsigned sp;
+
+	KASSERT(spinlock_do_i_hold(&lockdep_lock));
+
+	lockdep_visitgen++;
+	start->c_visited = lockdep_visitgen;
+	start->c_parent = NULL;
+	lockdep_stack[0] = start;
+	sp = 1;
+
+	while (sp > 0) {
+		c = lockdep_stack[--sp];
+		for (e = c->c_edges; e != NULL; e = e->e_next) {
+			if (e->e_to->c_visited == lockdep_visitgen) {
+				continue;
+			}
+			e->e_to->c_visited = lockdep_visitgen;
+			e->e_to->c_parent = c;
+			if (e->e_to == target) {
+				return true;
+			}
+			KASSERT(sp < LOCKDEP_MAXCLASSES);
+			lockdep_stack[sp++] = e->e_to;
+		}
+	}
+	return false;
+}
+
+/*
+ * Report that TO is being acquired while holding FROM, but a path
+ * from TO back to FROM is already known (left in c_parent by
+ * lockdep_findpath).
+ */
+static
+void
+lockdep_report(struct lockdep_class *from, struct lockdep_class *to)
+{
+	struct lockdep_class *c;
+
+	/*
+	 * As in hangman, drop the lock before printing so kprintf
+	 * doesn't come back through here, but stay at splhigh so the
+	 * console polls and nothing else runs in the middle.
+	 */
+	splhigh();
+	spinlock_release(&lockdep_lock);
+
+	kprintf("lockdep: Lock order reversal!\n");
+	kprintf("lockdep: acquiring %s while holding %s, but already seen:\n",
+		to->c_name, from->c_name);
+	kprintf("   %s\n", from->c_name);
+	for (c = from; c != to; c = c->c_parent) {
+		kprintf("   taken while holding %s\n", c->c_parent->c_name);
+	}
+	panic("Possible deadlock.\n");
+}
+
+/*
+ * Slow path: the edge FROM -> TO hasn't been seen before. Check it
+ * against what we know, then remember it.
+ */
+static
+void
+lockdep_addedge(struct lockdep_class *from, struct lockdep_class *to)
+{
+	struct lockdep_edge *e;
+	unsigned i;
+
+	spinlock_acquire(&lockdep_lock);
+
+	/* Someone else may have added it since we looked. */
+	if (lockdep_findedge(from, to)) {
+		spinlock_release(&lockdep_lock);
+		return;
+	}
+
+	if (lockdep_findpath(to, from)) {
+		lockdep_report(from, to);
+	}
+
+	if (lockdep_nedges >= LOCKDEP_MAXEDGES * 3 / 4) {
+		spinlock_release(&lockdep_lock);
+		lockdep_warnfull();
+		return;
+	}
+
+	i = lockdep_edgehash(from, to) & (LOCKDEP_MAXEDGES - 1);
+	while (lockdep_edges[i].e_from != NULL) {
+		i = (i + 1) & (LOCKDEP_MAXEDGES - 1);
+	}
+	e = &lockdep_edges[i];
+	e->e_to = to;
+	e->e_next = from->c_edges;
+	membar_store_store();
+	e->e_from = from;
+	from->c_edges = e;
+	lockdep_nedges++;
+
+	spinlock_release(&lockdep_lock);
+}
+
+////////////////////////////////////////////////////////////
+// interface
+
+/*
+ * Note that A is about to acquire L. This is called before waiting,
+ * so an inversion is reported whether or not it would deadlock this
+ * time.
+ */
+void
+lockdep_acquire(struct lockdep_actor *a, struct lockdep_lockable *l)
+{
+	struct lockdep_class *c, *held;
+	unsigned i;
+
+	if (l == &lockdep_lock.splk_lockdep) {
+		/* don't recurse */
+		return;
+	}
+
+	c = l->l_class;
+	if (c == NULL) {
+		/* Racing lookups find the same class, so this is harmless. */
+		c = lockdep_getclass(l->l_name);
+		if (c == NULL) {
+			return;
+		}
+		l->l_class = c;
+	}
+
+	for (i=0; i<a->a_nheld; i++) {
+		held = a->a_held[i];
+		if (held != c && !lockdep_findedge(held, c)) {
+			lockdep_addedge(held, c);
+		}
+	}
+
+	if (a->a_nheld >= LOCKDEP_MAXHELD) {
+		panic("lockdep: Holding too many locks acquiring %s\n",
+		      c->c_name);
+	}
+	a->a_held[a->a_nheld++] = c;
+}
+
+void
+lockdep_release(struct lockdep_actor *a, struct lockdep_lockable *l)
+{
+	struct lockdep_class *c;
+	unsigned i;
+
+	if (l == &lockdep_lock.splk_lockdep) {
+		/* don't recurse */
+		return;
+	}
+
+	c = l->l_class;
+	if (c == NULL) {
+		/* class table was full; never recorded */
+		return;
+	}
+
+	/* Locks needn't be released in order; remove the newest match. */
+	for (i = a->a_nheld; i > 0; i--) {
+		if (a->a_held[i-1] == c) {
+			break;
+		}
+	}
+	if (i == 0) {
+		/*
+		 * Not recorded: spinlocks taken before curcpu exists
+		 * aren't tracked, and some of those are released after.
+		 */
+		return;
+	}
+	for (; i < a->a_nheld; i++) {
+		a->a_held[i-1] = a->a_held[i];
+	}
+	a->a_nheld--;
+}
@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Lock contention statistics.
+ * The interface is documented in lockstat.h.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <clock.h>
+#include <spinlock.h>
+#include <lockstat.h>
+
+/* Most records dump will print. */
+#define LOCKSTAT_DUMPMAX	32
+
+/*
+ * All registered records. lockstat_lock protects the list links only;
+ * the counters belong to the locks they describe.
+ */
+static struct spinlock lockstat_lock = SPINLOCK_INITIALIZER;
+static struct lockstat *lockstat_list;
+
+/*
+ * Take LS off the global list. lockstat_lock must be held.
+ */
+static
+void
+lockstat_unlink(struct lockstat *ls)
+{
+	KASSERT(spinlock_do_i_hold(&lockstat_lock));
+
+	if (ls->ls_prev != NULL) {
+		ls->ls_prev->ls_next = ls->ls_next;
+	}
+	else {
+		KASSERT(lockstat_list == ls);
+		lockstat_list = ls->ls_next;
+	}
+	if (ls->ls_next != NULL) {
+		ls->ls_next->ls_prev = ls->ls_prev;
+	}
+	ls->ls_prev = ls->ls_next = NULL;
+	ls->ls_registered = false;
+}
+
+/*
+ * Set up LS. It may be fresh memory, or it may be the record of a lock
+ * that is being initialized again without being cleaned up first (a
+ * static lock reused by a test, say) and is still on the list. Only a
+ * record actually found on the list is unlinked; in fresh memory
+ * ls_registered is just garbage.
+ */
+void
+lockstat_init(struct lockstat *ls, const char *kind, const char *name)
+{
+	struct lockstat *l;
+
+	if (ls->ls_registered) {
+		spinlock_acquire(&lockstat_lock);
+		for (l = lockstat_list; l != NULL; l = l->ls_next) {
+			if (l == ls) {
+				lockstat_unlink(ls);
+				break;
+			}
+		}
+		spinlock_release(&lockstat_lock);
+	}
+
+	ls->ls_kind = kind;
+	ls->ls_name = name;
+	ls->ls_prev = ls->ls_next = NULL;
+	ls->ls_registered = false;
+	ls->ls_acquires = 0;
+	ls->ls_contended = 0;
+	ls->ls_waitcycles = 0;
+	ls->ls_maxhold = 0;
+	ls->ls_holdstart = 0;
+}
+
+void
+lockstat_cleanup(struct lockstat *ls)
+{
+	if (!ls->ls_registered) {
+		return;
+	}
+
+	spinlock_acquire(&lockstat_lock);
+	lockstat_unlink(ls);
+	spinlock_release(&lockstat_lock);
+}
+
+/*
+ * Record an acquisition. The caller holds the lock ls describes.
+ * WAITSTART is the cycle count when the caller started waiting, or 0
+ * if it didn't have to.
+ */
+void
+lockstat_acquired(struct lockstat *ls, uint64_t waitstart)
+{
+	uint64_t now;
+
+	if (ls == &lockstat_lock.splk_lockstat) {
+		/* don't recurse */
+		return;
+	}
+
+	if (!ls->ls_registered) {
+		/* Safe to test unlocked: only the holder sets it. */
+		spinlock_acquire(&lockstat_lock);
+		ls->ls_prev = NULL;
+		ls->ls_next = lockstat_list;
+		if (lockstat_list != NULL) {
+			lockstat_list->ls_prev = ls;
+		}
+		lockstat_list = ls;
+		ls->ls_registered = true;
+		spinlock_release(&lockstat_lock);
+	}
+
+	now = cpu_cycles();
+	ls->ls_acquires++;
+	if (waitstart != 0) {
+		ls->ls_contended++;
+		/* Different cpus' counters aren't in step; don't go negative. */
+		if (now > waitstart) {
+			ls->ls_waitcycles += now - waitstart;
+		}
+	}
+	ls->ls_holdstart = now;
+}
+
+/*
+ * Record a release. The caller still holds the lock.
+ */
+void
+lockstat_released(struct lockstat *ls)
+{
+	uint64_t now;
+
+	if (ls == &lockstat_lock.splk_lockstat) {
+		/* don't recurse */
+		return;
+	}
+
+	now = cpu_cycles();
+	if (now > ls->ls_holdstart && now - ls->ls_holdstart > ls->ls_maxhold) {
+		ls->ls_maxhold = now - ls->ls_holdstart;
+	}
+}
+
+struct lockstat_line {
+	char name[24];
+	const char *kind;
+	uint64_t acquires, contended, waitcycles, maxhold;
+};
+
+/*
+ * Print the MAX records with the most total wait time.
+ *
+ * The counters are read without their locks, so a line may be a
+ * little inconsistent with itself. The names are copied out under
+ * lockstat_lock, because the lock can be destroyed (and its name
+ * freed) as soon as we let go.
+ */
+void
+lockstat_dump(unsigned max)
+{
+	struct lockstat_line *top;
+	struct lockstat *ls;
+	unsigned n, i, j, total;
+
+	if (max > LOCKSTAT_DUMPMAX) {
+		max = LOCKSTAT_DUMPMAX;
+	}
+	if (max == 0) {
+		return;
+	}
+
+	top = kmalloc(max * sizeof(*top));
+	if (top == NULL) {
+		kprintf("lockstat: Out of memory\n");
+		return;
+	}
+
+	n = 0;
+	total = 0;
+	spinlock_acquire(&lockstat_lock);
+	for (ls = lockstat_list; ls != NULL; ls = ls->ls_next) {
+		total++;
+		/* Insertion sort by wait time, keeping the top MAX. */
+		for (i = n; i > 0; i--) {
+			if (top[i-1].waitcycles >= ls->ls_waitcycles) {
+				break;
+			}
+		}
+		if (i >= max) {
+			continue;
+		}
+		if (n < max) {
+			n++;
+		}
+		for (j = n - 1; j > i; j--) {
+			top[j] = top[j-1];
+		}
+		snprintf(top[i].name, sizeof(top[i].name), "%s", ls->ls_name);
+		top[i].kind = ls->ls_kind;
+		top[i].acquires = ls->ls_acquires;
+		top[i].contended = ls->ls_contended;
+		top[i].waitcycles = ls->ls_waitcycles;
+		top[i].maxhold = ls->ls_maxhold;
+	}
+	spinlock_release(&lockstat_lock);
+
+	kprintf("lockstat: %u locks in use; top %u by wait time (cycles):\n",
+		total, n);
+	kprintf("%-23s %-8s %10s %10s %12s %10s\n",
+		"name", "kind", "acquires", "contended", "wait", "maxhold");
+	for (i=0; i<n; i++) {
+		kprintf("%-23s %-8s %10llu %10llu %12llu %10llu\n",
+			top[i].name, top[i].kind, top[i].acquires,
+			top[i].contended, top[i].waitcycles, top[i].maxhold);
+	}
+
+	kfree(top);
+}
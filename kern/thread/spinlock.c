@@ -41,7 +41,26 @@
 
 /*
  * Spinlocks.
+ *
+ * These are ticket locks. The lock word holds two 16-bit counters:
+ * the next ticket to hand out (upper half) and the ticket currently
+ * being served (lower half). To acquire, atomically take a ticket and
+ * spin until it is being served; to release, serve the next ticket.
+ * The lock is free when the two are equal.
+ *
+ * Unlike test-and-set, this hands the lock out in FIFO order, so no
+ * cpu can be starved, and waiters only read the lock word while they
+ * spin rather than hammering it with atomic writes. (An MCS lock
+ * would also let each waiter spin on its own word, but that needs a
+ * queue node per acquire, and System/161 has no caches for that to
+ * help with.)
+ *
+ * 16 bits of ticket is plenty: at most one ticket per cpu can be
+ * outstanding.
  */
+#define SPINLOCK_NEXT(v)	((v) >> 16)
+#define SPINLOCK_SERVING(v)	((v) & 0xffff)
+#define SPINLOCK_ONETICKET	((spinlock_data_t)1 << 16)
 
 
 /*
@@ -52,6 +71,8 @@ spinlock_init(struct spinlock *splk)
 {
 	spinlock_data_set(&splk->splk_lock, 0);
 	splk->splk_holder = NULL;
+	LOCKSTAT_INIT(&splk->splk_lockstat, "spinlock", "spinlock");
+	LOCKDEP_LOCKABLEINIT(&splk->splk_lockdep, "spinlock");
 	HANGMAN_LOCKABLEINIT(&splk->splk_hangman, "spinlock");
 }
 
@@ -61,8 +82,27 @@ spinlock_init(struct spinlock *splk)
 void
 spinlock_cleanup(struct spinlock *splk)
 {
+	spinlock_data_t val;
+
 	KASSERT(splk->splk_holder == NULL);
-	KASSERT(spinlock_data_get(&splk->splk_lock) == 0);
+	val = spinlock_data_get(&splk->splk_lock);
+	KASSERT(SPINLOCK_NEXT(val) == SPINLOCK_SERVING(val));
+	LOCKSTAT_CLEANUP(&splk->splk_lockstat);
+}
+
+/*
+ * Name the spinlock, for debugging output.
+ */
+void
+spinlock_setname(struct spinlock *splk, const char *name)
+{
+	LOCKSTAT_SETNAME(&splk->splk_lockstat, name);
+	LOCKDEP_SETNAME(&splk->splk_lockdep, name);
+#if OPT_HANGMAN
+	splk->splk_hangman.l_name = name;
+#else
+	(void)name;
+#endif
 }
 
 /*
@@ -70,12 +110,15 @@ spinlock_cleanup(struct spinlock *splk)
  *
  * First disable interrupts (otherwise, if we get a timer interrupt we
  * might come back to this lock and deadlock), then use a machine-level
- * atomic operation to wait for the lock to be free.
+ * atomic operation to take a ticket, and wait for it to come up.
  */
 void
 spinlock_acquire(struct spinlock *splk)
 {
 	struct cpu *mycpu;
+	spinlock_data_t val;
+	unsigned ticket;
+	LOCKSTAT_WAITVAR(waitstart);
 
 	splraise(IPL_NONE, IPL_HIGH);
 
@@ -87,30 +130,29 @@ spinlock_acquire(struct spinlock *splk)
 		}
 		mycpu->c_spinlocks++;
 
+		LOCKDEP_ACQUIRE(&curcpu->c_lockdep, &splk->splk_lockdep);
 		HANGMAN_WAIT(&curcpu->c_hangman, &splk->splk_hangman);
 	}
 	else {
 		mycpu = NULL;
 	}
 
-	while (1) {
-		/*
-		 * Do test-test-and-set, that is, read first before
-		 * doing test-and-set, to reduce bus contention.
-		 *
-		 * Test-and-set is a machine-level atomic operation
-		 * that writes 1 into the lock word and returns the
-		 * previous value. If that value was 0, the lock was
-		 * previously unheld and we now own it. If it was 1,
-		 * we don't.
-		 */
-		if (spinlock_data_get(&splk->splk_lock) != 0) {
-			continue;
-		}
-		if (spinlock_data_testandset(&splk->splk_lock) != 0) {
-			continue;
-		}
-		break;
+	/*
+	 * Take a ticket. The CAS only fails if someone else changed
+	 * the word under us, so just retry.
+	 */
+	do {
+		val = spinlock_data_get(&splk->splk_lock);
+	} while (!spinlock_data_cas(&splk->splk_lock, val,
+				    val + SPINLOCK_ONETICKET));
+	ticket = SPINLOCK_NEXT(val);
+
+	/* Wait for our turn; this only reads the lock word. */
+	if (SPINLOCK_SERVING(val) != ticket && mycpu != NULL) {
+		LOCKSTAT_STARTWAIT(waitstart);
+	}
+	while (SPINLOCK_SERVING(spinlock_data_get(&splk->splk_lock)) != ticket) {
+		/* spin */
 	}
 
 	membar_store_any();
@@ -118,6 +160,7 @@ spinlock_acquire(struct spinlock *splk)
 
 	if (CURCPU_EXISTS()) {
 		HANGMAN_ACQUIRE(&curcpu->c_hangman, &splk->splk_hangman);
+		LOCKSTAT_ACQUIRED(&splk->splk_lockstat, waitstart);
 	}
 }
 
@@ -127,17 +170,33 @@ spinlock_acquire(struct spinlock *splk)
 void
 spinlock_release(struct spinlock *splk)
 {
+	spinlock_data_t val, newval;
+
 	/* this must work before curcpu initialization */
 	if (CURCPU_EXISTS()) {
 		KASSERT(splk->splk_holder == curcpu->c_self);
 		KASSERT(curcpu->c_spinlocks > 0);
 		curcpu->c_spinlocks--;
 		HANGMAN_RELEASE(&curcpu->c_hangman, &splk->splk_hangman);
+		LOCKDEP_RELEASE(&curcpu->c_lockdep, &splk->splk_lockdep);
+		LOCKSTAT_RELEASED(&splk->splk_lockstat);
 	}
 
 	splk->splk_holder = NULL;
 	membar_any_store();
-	spinlock_data_set(&splk->splk_lock, 0);
+
+	/*
+	 * Serve the next ticket. Other cpus may be taking tickets in
+	 * the upper half at the same time, so this has to be atomic
+	 * too; and the lower half must wrap without carrying into the
+	 * upper half.
+	 */
+	do {
+		val = spinlock_data_get(&splk->splk_lock);
+		newval = (val & ~(spinlock_data_t)0xffff) |
+			((val + 1) & 0xffff);
+	} while (!spinlock_data_cas(&splk->splk_lock, val, newval));
+
 	spllower(IPL_HIGH, IPL_NONE);
 }
 
@@ -34,11 +34,16 @@
 
 #include <types.h>
 #include <lib.h>
+#include <spl.h>
+#include <membar.h>
 #include <spinlock.h>
 #include <wchan.h>
 #include <thread.h>
+#include <cpu.h>
 #include <current.h>
 #include <synch.h>
+#include <vm.h>
+#include <platform/maxcpus.h>
 
 ////////////////////////////////////////////////////////////
 //
@@ -68,6 +73,7 @@ sem_create(const char *name, unsigned initial_count)
 	}
 
 	spinlock_init(&sem->sem_lock);
+	spinlock_setname(&sem->sem_lock, sem->sem_name);
 	sem->sem_count = initial_count;
 
 	return sem;
@@ -156,8 +162,11 @@ lock_create(const char *name)
 
 
 	HANGMAN_LOCKABLEINIT(&lock->lk_hangman, lock->lk_name);
+	LOCKDEP_LOCKABLEINIT(&lock->lk_lockdep, lock->lk_name);
 	lock->lk_wchan = wchan_create(lock->lk_name);
 	spinlock_init(&lock->lk_spinlock);
+	spinlock_setname(&lock->lk_spinlock, lock->lk_name);
+	LOCKSTAT_INIT(&lock->lk_lockstat, "lock", lock->lk_name);
 	lock->lk_thread = NULL;
 	lock->is_held = 0;
 
@@ -170,59 +179,111 @@ lock_destroy(struct lock *lock)
 	KASSERT(lock != NULL);
 
 	// add stuff here as needed
+	LOCKSTAT_CLEANUP(&lock->lk_lockstat);
 	spinlock_cleanup(&lock->lk_spinlock);
 	wchan_destroy(lock->lk_wchan);
 	kfree(lock->lk_name);
 	kfree(lock);
 }
 
+/*
+ * Adaptive spinning.
+ *
+ * If the lock is held by a thread that is running on another cpu, it
+ * will probably let go soon, and sleeping would cost two context
+ * switches. So spin (without holding lk_spinlock, so the holder can
+ * release) as long as the holder stays on cpu, up to LOCK_SPIN_MAX
+ * iterations per acquire. After that, or if the holder isn't running,
+ * go to sleep as usual.
+ *
+ * Note that we peek at the holder's thread structure without any
+ * lock. It can exit and be recycled (or, rarely, freed) while we
+ * look; that's harmless, because kernel memory is always readable
+ * and we recheck lk_thread on every iteration, so at worst we spin a
+ * little longer than we should.
+ */
+#define LOCK_SPIN_MAX 1000
+
+static
+bool
+lock_holder_oncpu(volatile struct thread *holder)
+{
+	return holder->t_state == S_RUN && holder->t_cpu != curcpu->c_self;
+}
+
 void
 lock_acquire(struct lock *lock)
 {
+	volatile struct thread *holder;
+	unsigned spins;
+	LOCKSTAT_WAITVAR(waitstart);
 
 	// Do not allow during an interrupt
 	KASSERT(curthread->t_in_interrupt == false);
 
 	KASSERT(lock != NULL);
 
-	if (lock->lk_thread == NULL) {
-		lock->lk_thread = curthread;
-		lock->is_held = 1;
-		return;
-	}
+	LOCKDEP_ACQUIRE(&curthread->t_lockdep, &lock->lk_lockdep);
 
-	spinlock_acquire(&lock->lk_spinlock);	
+	spinlock_acquire(&lock->lk_spinlock);
 
 	HANGMAN_WAIT(&curthread->t_hangman, &lock->lk_hangman);
 
+	spins = 0;
 	while (lock->is_held == 1) {
-			wchan_sleep(lock->lk_wchan, &lock->lk_spinlock);
+		LOCKSTAT_STARTWAIT(waitstart);
+		holder = lock->lk_thread;
+		if (spins < LOCK_SPIN_MAX && lock_holder_oncpu(holder)) {
+			spinlock_release(&lock->lk_spinlock);
+			while (lock->lk_thread == holder &&
+			       spins < LOCK_SPIN_MAX &&
+			       lock_holder_oncpu(holder)) {
+				spins++;
+			}
+			spinlock_acquire(&lock->lk_spinlock);
+			continue;
+		}
+		wchan_sleep(lock->lk_wchan, &lock->lk_spinlock);
 	}
 
 	lock->is_held = 1;
 	lock->lk_thread = curthread;
+	LOCKSTAT_ACQUIRED(&lock->lk_lockstat, waitstart);
 
 	/* Call this (atomically) once the lock is acquired */
 	HANGMAN_ACQUIRE(&curthread->t_hangman, &lock->lk_hangman);
 	spinlock_release(&lock->lk_spinlock);
 }
 
+/*
+ * Release the lock; lk_spinlock must be held. Shared with cv_wait.
+ */
+static
 void
-lock_release(struct lock *lock)
+lock_release_locked(struct lock *lock)
 {
 	KASSERT(lock != NULL);
 	KASSERT(lock->is_held == 1);
 	KASSERT(lock_do_i_hold(lock));
+	KASSERT(spinlock_do_i_hold(&lock->lk_spinlock));
 
-	spinlock_acquire(&lock->lk_spinlock);
-
+	LOCKSTAT_RELEASED(&lock->lk_lockstat);
 	lock->lk_thread = NULL;
 	lock->is_held = 0;
 	wchan_wakeone(lock->lk_wchan, &lock->lk_spinlock);
 	
 	HANGMAN_RELEASE(&curthread->t_hangman, &lock->lk_hangman);
-	spinlock_release(&lock->lk_spinlock);
+	LOCKDEP_RELEASE(&curthread->t_lockdep, &lock->lk_lockdep);
+}
 
+void
+lock_release(struct lock *lock)
+{
+	KASSERT(lock != NULL);
+
+	spinlock_acquire(&lock->lk_spinlock);
+	lock_release_locked(lock);
+	spinlock_release(&lock->lk_spinlock);
 }
 
 bool
@@ -254,6 +315,7 @@ cv_create(const char *name)
 
 	// add stuff here as needed
 	cv->cv_wchan = wchan_create(cv->cv_name);
+	LOCKSTAT_INIT(&cv->cv_lockstat, "cv", cv->cv_name);
 
 	return cv;
 }
@@ -264,6 +326,7 @@ cv_destroy(struct cv *cv)
 	KASSERT(cv != NULL);
 
 	// add stuff here as needed
+	LOCKSTAT_CLEANUP(&cv->cv_lockstat);
 	wchan_destroy(cv->cv_wchan);
 	kfree(cv->cv_name);
 	kfree(cv);
@@ -272,14 +335,24 @@ cv_destroy(struct cv *cv)
 void
 cv_wait(struct cv *cv, struct lock *lock)
 {
+	LOCKSTAT_WAITVAR(waitstart);
+
 	KASSERT(lock_do_i_hold(lock));
-	lock_release(lock);
+	LOCKSTAT_STARTWAIT(waitstart);
 
+	/*
+	 * Release the lock and go to sleep without letting go of
+	 * lk_spinlock in between. cv_signal and cv_broadcast take it
+	 * too, so a wakeup can't slip in before we're on the wchan.
+	 */
 	spinlock_acquire(&lock->lk_spinlock);
+	lock_release_locked(lock);
 	wchan_sleep(cv->cv_wchan, &lock->lk_spinlock);
 	spinlock_release(&lock->lk_spinlock);
 
 	lock_acquire(lock);
+	/* The CV's statistics are protected by the lock it's used with. */
+	LOCKSTAT_ACQUIRED(&cv->cv_lockstat, waitstart);
 }
 
 void
@@ -305,119 +378,276 @@ cv_broadcast(struct cv *cv, struct lock *lock)
 
 
 
+////////////////////////////////////////////////////////////
+//
+// Reader-writer lock.
+//
+// See synch.h for the protocol and the fairness rules.
+
 /*
- *RW Locks
- *
- *
+ * One cpu's reader count, padded out to a cache line of its own.
  */
+struct rwlock_readers {
+	volatile int rr_count;
+	char rr_pad[CACHELINE_SIZE - sizeof(int)];
+};
 
 struct rwlock *
-rwlock_create(const char *name) {
-
+rwlock_create(const char *name)
+{
 	struct rwlock *rw;
+	unsigned i;
 
-	rw=kmalloc(sizeof(*rw));
+	rw = kmalloc(sizeof(*rw));
 	if (rw == NULL) {
 		return NULL;
 	}
 
-	rw->rwlock_name=kstrdup(name);
+	rw->rwlock_name = kstrdup(name);
 	if (rw->rwlock_name == NULL) {
 		kfree(rw);
 		return NULL;
 	}
 
-	rw->num_writers = 0;
-	rw->read_count = 0;
-	rw->r_cv = cv_create(strcat(rw->rwlock_name, "_read"));
-	rw->w_cv = cv_create(strcat(rw->rwlock_name, "_write"));
-	rw->rw_lock = lock_create(rw->rwlock_name);
-	return rw;
+	/*
+	 * kmalloc aligns blocks to their size class, which is at least
+	 * a cache line here, so each slot gets a line of its own. (With
+	 * kmalloc's guard bands turned on they straddle lines instead,
+	 * which is only slower.)
+	 */
+	rw->rw_readers = kmalloc(MAXCPUS * sizeof(rw->rw_readers[0]));
+	if (rw->rw_readers == NULL) {
+		kfree(rw->rwlock_name);
+		kfree(rw);
+		return NULL;
+	}
+	for (i=0; i<MAXCPUS; i++) {
+		rw->rw_readers[i].rr_count = 0;
+	}
+
+	rw->rw_rwchan = wchan_create(rw->rwlock_name);
+	rw->rw_wwchan = wchan_create(rw->rwlock_name);
+	rw->rw_drainchan = wchan_create(rw->rwlock_name);
+	if (rw->rw_rwchan == NULL || rw->rw_wwchan == NULL ||
+	    rw->rw_drainchan == NULL) {
+		if (rw->rw_rwchan != NULL) {
+			wchan_destroy(rw->rw_rwchan);
+		}
+		if (rw->rw_wwchan != NULL) {
+			wchan_destroy(rw->rw_wwchan);
+		}
+		if (rw->rw_drainchan != NULL) {
+			wchan_destroy(rw->rw_drainchan);
+		}
+		kfree(rw->rw_readers);
+		kfree(rw->rwlock_name);
+		kfree(rw);
+		return NULL;
+	}
 
+	spinlock_init(&rw->rw_lock);
+	spinlock_setname(&rw->rw_lock, rw->rwlock_name);
+	LOCKSTAT_INIT(&rw->rw_lockstat, "rwlock", rw->rwlock_name);
+	rw->rw_wpending = false;
+	rw->rw_writer = NULL;
+	rw->rw_nwriters = 0;
+	rw->rw_nrwaiting = 0;
+	rw->rw_handoff = 0;
+
+	return rw;
 }
 
+/*
+ * Total number of readers holding the lock. Only exact when no reader
+ * can be on the fast path, i.e. with rw_wpending set; otherwise it is
+ * a snapshot.
+ */
+static
+int
+rwlock_nreaders(struct rwlock *rw)
+{
+	unsigned i;
+	int n = 0;
+
+	for (i=0; i<MAXCPUS; i++) {
+		n += rw->rw_readers[i].rr_count;
+	}
+	return n;
+}
 
 void
-rwlock_destroy(struct rwlock *rw) {
-	
-	cv_destroy(rw->r_cv);
-	cv_destroy(rw->w_cv);
-	lock_destroy(rw->rw_lock);
+rwlock_destroy(struct rwlock *rw)
+{
+	KASSERT(rw != NULL);
+	KASSERT(rw->rw_writer == NULL);
+	KASSERT(rw->rw_nwriters == 0);
+	KASSERT(rwlock_nreaders(rw) == 0);
+
+	/* wchan_cleanup will assert if anyone's waiting on it */
+	LOCKSTAT_CLEANUP(&rw->rw_lockstat);
+	spinlock_cleanup(&rw->rw_lock);
+	wchan_destroy(rw->rw_rwchan);
+	wchan_destroy(rw->rw_wwchan);
+	wchan_destroy(rw->rw_drainchan);
+	kfree(rw->rw_readers);
 	kfree(rw->rwlock_name);
 	kfree(rw);
 }
 
-
+/*
+ * Reader slow path: a writer is holding, draining, or waiting. Called
+ * after the fast path has backed its increment out again.
+ */
+static
 void
-rwlock_acquire_read(struct rwlock *rw) {
+rwlock_acquire_read_slow(struct rwlock *rw)
+{
+	LOCKSTAT_WAITVAR(waitstart);
 
-	lock_acquire(rw->rw_lock);
+	spinlock_acquire(&rw->rw_lock);
 
-	// read_count will be -1 while a writer holds the lock
-	while (rw->read_count < 0 || rw->num_writers > 0) {
-		cv_wait(rw->r_cv, rw->rw_lock);
+	/*
+	 * A draining writer may have seen our transient increment and
+	 * gone to sleep on it. Let it look again.
+	 */
+	wchan_wakeall(rw->rw_drainchan, &rw->rw_lock);
+
+	if (rw->rw_nwriters > 0 && rw->rw_handoff == 0) {
+		rw->rw_nrwaiting++;
+		LOCKSTAT_STARTWAIT(waitstart);
+		do {
+			wchan_sleep(rw->rw_rwchan, &rw->rw_lock);
+		} while (rw->rw_handoff == 0 && rw->rw_nwriters > 0);
+		rw->rw_nrwaiting--;
+		if (rw->rw_handoff > 0) {
+			/* We were part of the batch; the last one in lets writers go. */
+			rw->rw_handoff--;
+			if (rw->rw_handoff == 0) {
+				wchan_wakeone(rw->rw_wwchan, &rw->rw_lock);
+			}
+		}
 	}
-	
-	rw->read_count++;
-	lock_release(rw->rw_lock);
 
+	/* Holding a spinlock keeps us on this cpu. */
+	rw->rw_readers[curcpu->c_number].rr_count++;
+	LOCKSTAT_ACQUIRED(&rw->rw_lockstat, waitstart);
+	spinlock_release(&rw->rw_lock);
 }
 
-
 void
-rwlock_release_read(struct rwlock *rw) {
-	
-	KASSERT(rw->read_count > 0);
-
-	lock_acquire(rw->rw_lock);
+rwlock_acquire_read(struct rwlock *rw)
+{
+	volatile int *mine;
+	int spl;
 
-	rw->read_count--;
+	KASSERT(rw != NULL);
+	KASSERT(curthread->t_in_interrupt == false);
 
-	if (rw->read_count == 0 || rw->num_writers > 0) {
-		cv_signal(rw->w_cv, rw->rw_lock);
-	}
-	else {
-		cv_broadcast(rw->r_cv, rw->rw_lock);
+	/*
+	 * Fast path. Raise spl so we stay on this cpu while we use its
+	 * counter; nobody else writes it. The barrier orders our
+	 * increment against the load of rw_wpending, and pairs with the
+	 * one in rwlock_acquire_write: either we see the writer's flag or
+	 * it sees our count.
+	 */
+	spl = splhigh();
+	mine = &rw->rw_readers[curcpu->c_number].rr_count;
+	(*mine)++;
+	membar_any_any();
+	if (!rw->rw_wpending) {
+		splx(spl);
+		return;
 	}
+	(*mine)--;
+	splx(spl);
 
-	lock_release(rw->rw_lock);
+	rwlock_acquire_read_slow(rw);
 }
 
-
 void
-rwlock_acquire_write(struct rwlock *rw) {
-
-	lock_acquire(rw->rw_lock);
-
-	rw->num_writers++;
-
-	// writers are only allowed access when there are zero readers and zero writers holding the lock
-	while(rw->read_count != 0) {
-		cv_wait(rw->w_cv, rw->rw_lock);
+rwlock_release_read(struct rwlock *rw)
+{
+	bool wpending;
+	int spl;
+
+	KASSERT(rw != NULL);
+
+	spl = splhigh();
+	rw->rw_readers[curcpu->c_number].rr_count--;
+	membar_any_any();
+	wpending = rw->rw_wpending;
+	splx(spl);
+
+	if (wpending) {
+		/* There may be a writer waiting for us to drain. */
+		spinlock_acquire(&rw->rw_lock);
+		wchan_wakeall(rw->rw_drainchan, &rw->rw_lock);
+		spinlock_release(&rw->rw_lock);
 	}
-
-	rw->read_count = -1;
-	lock_release(rw->rw_lock);
-
 }
 
-
 void
-rwlock_release_write(struct rwlock *rw) {
+rwlock_acquire_write(struct rwlock *rw)
+{
+	int n;
+	LOCKSTAT_WAITVAR(waitstart);
 
-	KASSERT(rw->read_count == -1);
+	KASSERT(rw != NULL);
+	KASSERT(curthread->t_in_interrupt == false);
 
-	lock_acquire(rw->rw_lock);
+	spinlock_acquire(&rw->rw_lock);
+	KASSERT(rw->rw_writer != curthread);
 
-	rw->num_writers--;
-	rw->read_count = 0;
-	
-	cv_broadcast(rw->r_cv, rw->rw_lock);
-	lock_release(rw->rw_lock);
+	rw->rw_nwriters++;
+	rw->rw_wpending = true;
+	membar_any_any();
 
-}
+	/* Wait for the previous writer and any reader batch to get in. */
+	while (rw->rw_writer != NULL || rw->rw_handoff > 0) {
+		LOCKSTAT_STARTWAIT(waitstart);
+		wchan_sleep(rw->rw_wwchan, &rw->rw_lock);
+	}
+	rw->rw_writer = curthread;
 
+	/*
+	 * Drain. No new reader can get past the fast path now, and the
+	 * slow path won't admit any while we're here, so the count only
+	 * goes down. Readers wake us from rwlock_release_read. Since it
+	 * only goes down, a pass over the counters never reads less than
+	 * the true count; a negative sum means a reader released a lock
+	 * it didn't hold.
+	 */
+	while ((n = rwlock_nreaders(rw)) != 0) {
+		KASSERT(n > 0);
+		LOCKSTAT_STARTWAIT(waitstart);
+		wchan_sleep(rw->rw_drainchan, &rw->rw_lock);
+	}
+	LOCKSTAT_ACQUIRED(&rw->rw_lockstat, waitstart);
+	spinlock_release(&rw->rw_lock);
+}
 
+void
+rwlock_release_write(struct rwlock *rw)
+{
+	KASSERT(rw != NULL);
 
+	spinlock_acquire(&rw->rw_lock);
+	KASSERT(rw->rw_writer == curthread);
+	LOCKSTAT_RELEASED(&rw->rw_lockstat);
 
+	rw->rw_writer = NULL;
+	rw->rw_nwriters--;
+	if (rw->rw_nwriters == 0) {
+		rw->rw_wpending = false;
+	}
 
+	if (rw->rw_nrwaiting > 0) {
+		/* Readers first; the last of them wakes the next writer. */
+		rw->rw_handoff = rw->rw_nrwaiting;
+		wchan_wakeall(rw->rw_rwchan, &rw->rw_lock);
+	}
+	else {
+		wchan_wakeone(rw->rw_wwchan, &rw->rw_lock);
+	}
+	spinlock_release(&rw->rw_lock);
+}
@@ -50,6 +50,8 @@
 #include <addrspace.h>
 #include <mainbus.h>
 #include <vnode.h>
+#include <workqueue.h>
+#include <syscallstat.h>
 
 
 /* Magic number used as a guard value on kernel thread stacks. */
@@ -114,22 +116,41 @@ thread_checkstack(struct thread *thread)
 	}
 }
 
+/*
+ * Initialize the fields of a thread structure. This is shared by
+ * thread_create and by the thread pool, which hands out recycled
+ * thread structures that still have their stacks attached.
+ */
+static
 void
-t_ftable_init(struct thread *t, void *dest, void *source) {
-
-	(void)t;
-	
-	// TODO add synchronization to this function
-	
-	if (source == NULL) {
-		memset(dest, 0, sizeof(dest));
-	}
-	else {
-		memcpy(dest, source, sizeof(source));
-	}
+thread_init(struct thread *thread, const char *name)
+{
+	strcpy(thread->t_name, name);
+	thread->t_wchan_name = "NEW";
+	thread->t_state = S_READY;
 
-}
+	/* Thread subsystem fields */
+	thread_machdep_init(&thread->t_machdep);
+	threadlistnode_init(&thread->t_listnode, thread);
+	thread->t_context = NULL;
+	thread->t_cpu = NULL;
+	thread->t_proc = NULL;
+	thread->t_tid = 0;
+	thread->t_bound = false;
+
+	HANGMAN_ACTORINIT(&thread->t_hangman, thread->t_name);
+	LOCKDEP_ACTORINIT(&thread->t_lockdep);
+
+	/* Interrupt state fields */
+	thread->t_in_interrupt = false;
+	thread->t_curspl = IPL_HIGH;
+	thread->t_iplhigh_count = 1; /* corresponding to t_curspl */
 
+	bzero(&thread->t_usage, sizeof(thread->t_usage));
+	thread->t_usagestamp = 0;
+
+	/* If you add to struct thread, be sure to initialize here */
+}
 
 /*
  * Create a thread. This is used both to create a first thread
@@ -151,28 +172,8 @@ thread_create(const char *name)
 		return NULL;
 	}
 
-	strcpy(thread->t_name, name);
-	thread->t_wchan_name = "NEW";
-	thread->t_state = S_READY;
-	thread->t_pid = thread->t_proc->p_pid;
-
-	/* Thread subsystem fields */
-	thread_machdep_init(&thread->t_machdep);
-	threadlistnode_init(&thread->t_listnode, thread);
 	thread->t_stack = NULL;
-	thread->t_context = NULL;
-	thread->t_cpu = NULL;
-	thread->t_proc = NULL;
-	t_ftable_init(thread, thread->t_ftable, NULL);
-
-	HANGMAN_ACTORINIT(&thread->t_hangman, thread->t_name);
-
-	/* Interrupt state fields */
-	thread->t_in_interrupt = false;
-	thread->t_curspl = IPL_HIGH;
-	thread->t_iplhigh_count = 1; /* corresponding to t_curspl */
-
-	/* If you add to struct thread, be sure to initialize here */
+	thread_init(thread, name);
 
 	return thread;
 }
@@ -202,12 +203,15 @@ cpu_create(unsigned hardware_number)
 
 	c->c_curthread = NULL;
 	threadlist_init(&c->c_zombies);
+	threadlist_init(&c->c_threadpool);
 	c->c_hardclocks = 0;
 	c->c_spinlocks = 0;
+	c->c_workqueue = NULL;
 
 	c->c_isidle = false;
 	threadlist_init(&c->c_runqueue);
 	spinlock_init(&c->c_runqueue_lock);
+	spinlock_setname(&c->c_runqueue_lock, "c_runqueue_lock");
 
 	c->c_ipi_pending = 0;
 	c->c_numshootdown = 0;
@@ -266,6 +270,7 @@ cpu_create(unsigned hardware_number)
 	}
 
 	HANGMAN_ACTORINIT(&c->c_hangman, "cpu");
+	LOCKDEP_ACTORINIT(&c->c_lockdep);
 
 	result = proc_addthread(kproc, c->c_curthread);
 	if (result) {
@@ -309,9 +314,91 @@ thread_destroy(struct thread *thread)
 	kfree(thread);
 }
 
+/*
+ * Thread pool.
+ *
+ * Creating a thread means a kmalloc for the thread structure, another
+ * for the STACK_SIZE stack, and filling in the stack guard band;
+ * destroying one means two kfrees. Fork-heavy workloads do this
+ * constantly. So instead of destroying zombies outright, exorcise()
+ * parks up to THREAD_POOL_MAX of them per cpu, stack and all, and
+ * thread_fork takes them back from there.
+ *
+ * The pool is accessed only by its own cpu, with interrupts off, so
+ * it needs no lock. Keep the bound small: pooled threads still count
+ * as allocated memory as far as kheap_printused is concerned.
+ */
+#define THREAD_POOL_MAX 8
+
+/*
+ * Get a thread with a stack, from the pool if possible.
+ */
+static
+struct thread *
+thread_pool_get(const char *name)
+{
+	struct thread *thread;
+	int spl;
+
+	DEBUGASSERT(name != NULL);
+	if (strlen(name) > MAX_NAME_LENGTH) {
+		return NULL;
+	}
+
+	spl = splhigh();
+	thread = threadlist_remhead(&curcpu->c_threadpool);
+	splx(spl);
+
+	if (thread != NULL) {
+		/* The guard band was checked on the way into the pool. */
+		thread_init(thread, name);
+		return thread;
+	}
+
+	thread = thread_create(name);
+	if (thread == NULL) {
+		return NULL;
+	}
+
+	thread->t_stack = kmalloc(STACK_SIZE);
+	if (thread->t_stack == NULL) {
+		thread_destroy(thread);
+		return NULL;
+	}
+	thread_checkstack_init(thread);
+
+	return thread;
+}
+
+/*
+ * Put a dead thread in this cpu's pool, or destroy it if the pool is
+ * full. Threads without their own stack (boot threads) are never
+ * pooled. Interrupts must be off.
+ */
+static
+void
+thread_pool_put(struct thread *thread)
+{
+	KASSERT(curthread->t_curspl > 0);
+	KASSERT(thread != curthread);
+	KASSERT(thread->t_proc == NULL);
+
+	if (thread->t_stack == NULL ||
+	    curcpu->c_threadpool.tl_count >= THREAD_POOL_MAX) {
+		thread_destroy(thread);
+		return;
+	}
+
+	thread_checkstack(thread);
+	thread_machdep_cleanup(&thread->t_machdep);
+	thread->t_wchan_name = "POOLED";
+	threadlist_addhead(&curcpu->c_threadpool, thread);
+}
+
 /*
  * Clean up zombies. (Zombies are threads that have exited but still
- * need to have thread_destroy called on them.)
+ * need to have thread_destroy called on them.) Most of them go back
+ * into the thread pool rather than being freed.
  *
  * The list of zombies is per-cpu.
  */
@@ -324,7 +411,7 @@ exorcise(void)
 	while ((z = threadlist_remhead(&curcpu->c_zombies)) != NULL) {
 		KASSERT(z != curthread);
 		KASSERT(z->t_state == S_ZOMBIE);
-		thread_destroy(z);
+		thread_pool_put(z);
 	}
 }
 
@@ -468,10 +555,17 @@ thread_start_cpus(void)
 	}
 	cpu_startup_sem = NULL;
 
+	/* Start a deferred-work thread on each cpu, and count its syscalls. */
+	for (i=0; i<num_cpus; i++) {
+		workqueue_create(cpuarray_get(&allcpus, i));
+		syscallstat_create(cpuarray_get(&allcpus, i));
+	}
+
 	// Gross hack to deal with os/161 "idle" threads. Hardcode the thread count
 	// to 1 so the inc/dec properly works in thread_[fork/exit]. The one thread
 	// is the cpu0 boot thread (menu), which is the only thread that hasn't
-	// exited yet.
+	// exited yet. The workqueue threads never exit, so they don't count
+	// either.
 	thread_count = 1;
 }
 
@@ -515,46 +609,32 @@ thread_make_runnable(struct thread *target, bool already_have_lock)
 }
 
 /*
- * Create a new thread based on an existing one.
- *
- * The new thread has name NAME, and starts executing in function
- * ENTRYPOINT. DATA1 and DATA2 are passed to ENTRYPOINT.
- *
- * The new thread is created in the process P. If P is null, the
- * process is inherited from the caller. It will start on the same CPU
- * as the caller, unless the scheduler intervenes first.
+ * Common code for thread_fork and thread_fork_bound: create the new
+ * thread on cpu C, bound there if BOUND.
  */
+static
 int
-thread_fork(const char *name,
-	    struct proc *proc,
-	    void (*entrypoint)(void *data1, unsigned long data2),
-	    void *data1, unsigned long data2)
+thread_fork_on(const char *name,
+	       struct proc *proc, struct cpu *c, bool bound,
+	       void (*entrypoint)(void *data1, unsigned long data2),
+	       void *data1, unsigned long data2)
 {
 	struct thread *newthread;
 	int result;
 
-	newthread = thread_create(name);
+	/* Get a thread and stack, recycled if possible */
+	newthread = thread_pool_get(name);
 	if (newthread == NULL) {
 		return ENOMEM;
 	}
 
-	/* Allocate a stack */
-	newthread->t_stack = kmalloc(STACK_SIZE);
-	if (newthread->t_stack == NULL) {
-		thread_destroy(newthread);
-		return ENOMEM;
-	}
-	thread_checkstack_init(newthread);
-
 	/*
 	 * Now we clone various fields from the parent thread.
 	 */
 
 	/* Thread subsystem fields */
-	newthread->t_cpu = curthread->t_cpu;
-
-	// Copy filetable to the new thread
-	t_ftable_init(newthread, newthread->t_ftable, curthread->t_ftable);
+	newthread->t_cpu = c;
+	newthread->t_bound = bound;
 
 	/* Attach the new thread to its process */
 	if (proc == NULL) {
@@ -582,12 +662,43 @@ thread_fork(const char *name,
 	/* Set up the switchframe so entrypoint() gets called */
 	switchframe_init(newthread, entrypoint, data1, data2);
 
-	/* Lock the current cpu's run queue and make the new thread runnable */
+	/* Lock C's run queue and make the new thread runnable */
 	thread_make_runnable(newthread, false);
 
 	return 0;
 }
 
+/*
+ * Create a new thread based on an existing one.
+ *
+ * The new thread has name NAME, and starts executing in function
+ * ENTRYPOINT. DATA1 and DATA2 are passed to ENTRYPOINT.
+ *
+ * The new thread is created in the process P. If P is null, the
+ * process is inherited from the caller. It will start on the same CPU
+ * as the caller, unless the scheduler intervenes first.
+ */
+int
+thread_fork(const char *name,
+	    struct proc *proc,
+	    void (*entrypoint)(void *data1, unsigned long data2),
+	    void *data1, unsigned long data2)
+{
+	return thread_fork_on(name, proc, curthread->t_cpu, false,
+			      entrypoint, data1, data2);
+}
+
+/*
+ * Create a kernel thread that runs only on cpu C.
+ */
+int
+thread_fork_bound(const char *name, struct cpu *c,
+		  void (*entrypoint)(void *data1, unsigned long data2),
+		  void *data1, unsigned long data2)
+{
+	return thread_fork_on(name, NULL, c, true, entrypoint, data1, data2);
+}
+
 /*
  * High level, machine-independent context switch code.
  *
@@ -635,6 +746,19 @@ thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 		return;
 	}
 
+	/*
+	 * Charge the time so far; we'll restamp on the way back in.
+	 * Going to sleep or yielding is giving up the cpu; a yield
+	 * from an interrupt (hardclock) is having it taken away.
+	 */
+	usage_charge(cur, false);
+	if (newstate == S_READY && cur->t_in_interrupt) {
+		cur->t_usage.u_nivcsw++;
+	}
+	else if (newstate != S_ZOMBIE) {
+		cur->t_usage.u_nvcsw++;
+	}
+
 	/* Put the thread in the right place. */
 	switch (newstate) {
 	    case S_RUN:
@@ -754,6 +878,7 @@ thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 	/* Clear the wait channel and set the thread state. */
 	cur->t_wchan_name = NULL;
 	cur->t_state = S_RUN;
+	usage_stamp(cur);
 
 	/* Unlock the run queue. */
 	spinlock_release(&curcpu->c_runqueue_lock);
@@ -787,6 +912,7 @@ thread_startup(void (*entrypoint)(void *data1, unsigned long data2),
 	/* Clear the wait channel and set the thread state. */
 	cur->t_wchan_name = NULL;
 	cur->t_state = S_RUN;
+	usage_stamp(cur);
 
 	/* Release the runqueue lock acquired in thread_switch. */
 	spinlock_release(&curcpu->c_runqueue_lock);
@@ -827,14 +953,18 @@ void
 thread_exit(void)
 {
 	struct thread *cur;
+	struct proc *proc;
 
 	cur = curthread;
+	proc = cur->t_proc;
 
 	/*
-	 * Detach from our process. You might need to move this action
-	 * around, depending on how your wait/exit works.
+	 * Detach from our process. If we were the last thread in it,
+	 * the process is done too.
 	 */
-	proc_remthread(cur);
+	if (proc_remthread(cur) && proc != kproc) {
+		proc_exit(proc);
+	}
 
 	/* Make sure we *are* detached (move this only if you're sure!) */
 	KASSERT(cur->t_proc == NULL);
@@ -971,6 +1101,13 @@ thread_consider_migration(void)
 				continue;
 			}
 
+			/* Bound threads stay put the same way. */
+			if (t->t_bound) {
+				threadlist_addtail(&victims, t);
+				to_send--;
+				continue;
+			}
+
 			t->t_cpu = c;
 			threadlist_addtail(&c->c_runqueue, t);
 			DEBUG(DB_THREADS,
@@ -1103,7 +1240,8 @@ wchan_wakeone(struct wchan *wc, struct spinlock *lk)
 void
 wchan_wakeall(struct wchan *wc, struct spinlock *lk)
 {
-	struct thread *target;
+	struct thread *target, *t, *next;
+	struct cpu *targetcpu;
 	struct threadlist list;
 
 	KASSERT(spinlock_do_i_hold(lk));
@@ -1119,12 +1257,36 @@ wchan_wakeall(struct wchan *wc, struct spinlock *lk)
 	}
 
 	/*
-	 * We could conceivably sort by cpu first to cause fewer lock
-	 * ops and fewer IPIs, but for now at least don't bother. Just
-	 * make each thread runnable.
+	 * Hand the threads to their cpus in batches: take the first
+	 * thread's cpu, lock its run queue once, move every thread on
+	 * the list that belongs to it, and send it at most one IPI.
+	 * Making each thread runnable separately costs a lock round
+	 * trip and possibly an IPI per thread, which adds up when
+	 * dozens of threads sleep on one channel (lbolt, say). Sleeping
+	 * threads don't migrate, so t_cpu is stable here, and each
+	 * cpu's threads stay in the order they went to sleep.
 	 */
 	while ((target = threadlist_remhead(&list)) != NULL) {
-		thread_make_runnable(target, false);
+		targetcpu = target->t_cpu;
+		spinlock_acquire(&targetcpu->c_runqueue_lock);
+
+		target->t_state = S_READY;
+		threadlist_addtail(&targetcpu->c_runqueue, target);
+
+		next = list.tl_head.tln_next->tln_self;
+		while ((t = next) != NULL) {
+			next = t->t_listnode.tln_next->tln_self;
+			if (t->t_cpu == targetcpu) {
+				threadlist_remove(&list, t);
+				t->t_state = S_READY;
+				threadlist_addtail(&targetcpu->c_runqueue, t);
+			}
+		}
+
+		if (targetcpu->c_isidle && targetcpu != curcpu->c_self) {
+			ipi_send(targetcpu, IPI_UNIDLE);
+		}
+		spinlock_release(&targetcpu->c_runqueue_lock);
 	}
 
 	threadlist_cleanup(&list);
@@ -1182,18 +1344,53 @@ ipi_broadcast(int code)
 	}
 }
 
+/*
+ * Check if two shootdown requests are the same. struct tlbshootdown
+ * is machine-dependent, so compare it byte by byte.
+ */
+static
+bool
+tlbshootdown_same(const struct tlbshootdown *a, const struct tlbshootdown *b)
+{
+	const unsigned char *pa = (const unsigned char *)a;
+	const unsigned char *pb = (const unsigned char *)b;
+	unsigned i;
+
+	for (i=0; i<sizeof(*a); i++) {
+		if (pa[i] != pb[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
 /*
  * Send a TLB shootdown IPI to the specified CPU.
  */
 void
 ipi_tlbshootdown(struct cpu *target, const struct tlbshootdown *mapping)
 {
-	unsigned n;
+	unsigned n, i;
 
 	spinlock_acquire(&target->c_ipi_lock);
 
+	/*
+	 * If the same request is already waiting, it covers this one
+	 * too. (dumbvm only ever asks to flush everything, so this
+	 * keeps it to one queued request however many address spaces
+	 * go away before the target gets to it.)
+	 */
 	n = target->c_numshootdown;
-	if (n == TLBSHOOTDOWN_MAX) {
+	for (i=0; i<n; i++) {
+		if (tlbshootdown_same(&target->c_shootdown[i], mapping)) {
+			break;
+		}
+	}
+
+	if (i < n) {
+		/* coalesced; just make sure the IPI is on its way */
+	}
+	else if (n == TLBSHOOTDOWN_MAX) {
 		/*
 		 * If you have problems with this panic going off,
 		 * consider: (1) increasing the maximum, (2) putting
@@ -1216,6 +1413,23 @@ ipi_tlbshootdown(struct cpu *target, const struct tlbshootdown *mapping)
 	spinlock_release(&target->c_ipi_lock);
 }
 
+/*
+ * Send a TLB shootdown IPI to all CPUs except the current one.
+ */
+void
+ipi_tlbshootdown_broadcast(const struct tlbshootdown *mapping)
+{
+	unsigned i;
+	struct cpu *c;
+
+	for (i=0; i < cpuarray_num(&allcpus); i++) {
+		c = cpuarray_get(&allcpus, i);
+		if (c != curcpu->c_self) {
+			ipi_tlbshootdown(c, mapping);
+		}
+	}
+}
+
 /*
  * Handle an incoming interprocessor interrupt.
  */
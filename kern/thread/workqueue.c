@@ -0,0 +1,419 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Per-cpu deferred work queues.
+ * The interface is documented in workqueue.h.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <cpu.h>
+#include <spl.h>
+#include <spinlock.h>
+#include <wchan.h>
+#include <thread.h>
+#include <current.h>
+#include <workqueue.h>
+
+struct workqueue {
+	struct spinlock wq_lock;	/* Protects everything below */
+	struct wchan *wq_wchan;		/* Worker sleeps here */
+	struct wchan *wq_flushchan;	/* Flushers sleep here */
+	struct work *wq_head;		/* Pending work, FIFO */
+	struct work *wq_tail;
+	struct work *wq_delayed;	/* Delayed work, unordered */
+	struct work *wq_running;	/* Work the worker is running */
+	unsigned wq_nqueued;		/* Items ever made pending */
+	unsigned wq_ndone;		/* Items ever finished */
+	struct workqueue *wq_next;	/* Link on allqueues */
+};
+
+/*
+ * All the workqueues. Set up at boot and never changed afterwards, so
+ * it can be walked without locking.
+ */
+static struct workqueue *allqueues;
+
+/*
+ * Remove W from the singly linked list at *HEADP. Returns true if it
+ * was found.
+ */
+static
+bool
+work_unlink(struct work **headp, struct work *w)
+{
+	while (*headp != NULL) {
+		if (*headp == w) {
+			*headp = w->w_next;
+			w->w_next = NULL;
+			return true;
+		}
+		headp = &(*headp)->w_next;
+	}
+	return false;
+}
+
+/*
+ * Put W on the pending list and poke the worker. Lock must be held.
+ */
+static
+void
+workqueue_addpending(struct workqueue *wq, struct work *w)
+{
+	KASSERT(spinlock_do_i_hold(&wq->wq_lock));
+
+	w->w_next = NULL;
+	w->w_state = WORK_PENDING;
+	if (wq->wq_tail == NULL) {
+		wq->wq_head = w;
+	}
+	else {
+		wq->wq_tail->w_next = w;
+	}
+	wq->wq_tail = w;
+	wq->wq_nqueued++;
+
+	wchan_wakeone(wq->wq_wchan, &wq->wq_lock);
+}
+
+/*
+ * The worker thread.
+ *
+ * The work item is marked idle before its function is called, so the
+ * function may requeue or free it. After the call we only compare the
+ * pointer against wq_running.
+ */
+static
+void
+workqueue_thread(void *data1, unsigned long data2)
+{
+	struct workqueue *wq = data1;
+	struct work *w;
+	void (*func)(void *, unsigned long);
+	void *fdata1;
+	unsigned long fdata2;
+
+	(void)data2;
+
+	spinlock_acquire(&wq->wq_lock);
+	while (1) {
+		while (wq->wq_head == NULL) {
+			wchan_sleep(wq->wq_wchan, &wq->wq_lock);
+		}
+
+		w = wq->wq_head;
+		wq->wq_head = w->w_next;
+		if (wq->wq_head == NULL) {
+			wq->wq_tail = NULL;
+		}
+		w->w_next = NULL;
+
+		KASSERT(w->w_state == WORK_PENDING);
+		w->w_state = WORK_IDLE;
+		wq->wq_running = w;
+
+		func = w->w_func;
+		fdata1 = w->w_data1;
+		fdata2 = w->w_data2;
+		spinlock_release(&wq->wq_lock);
+
+		func(fdata1, fdata2);
+
+		spinlock_acquire(&wq->wq_lock);
+		wq->wq_running = NULL;
+		wq->wq_ndone++;
+		wchan_wakeall(wq->wq_flushchan, &wq->wq_lock);
+	}
+}
+
+void
+workqueue_create(struct cpu *c)
+{
+	struct workqueue *wq;
+	char name[16];
+	int result;
+
+	KASSERT(c->c_workqueue == NULL);
+
+	wq = kmalloc(sizeof(*wq));
+	if (wq == NULL) {
+		panic("workqueue_create: Out of memory\n");
+	}
+
+	spinlock_init(&wq->wq_lock);
+	wq->wq_wchan = wchan_create("workqueue");
+	wq->wq_flushchan = wchan_create("workflush");
+	if (wq->wq_wchan == NULL || wq->wq_flushchan == NULL) {
+		panic("workqueue_create: wchan_create failed\n");
+	}
+	wq->wq_head = wq->wq_tail = NULL;
+	wq->wq_delayed = NULL;
+	wq->wq_running = NULL;
+	wq->wq_nqueued = 0;
+	wq->wq_ndone = 0;
+
+	snprintf(name, sizeof(name), "work/%u", c->c_number);
+	result = thread_fork_bound(name, c, workqueue_thread, wq, 0);
+	if (result) {
+		panic("workqueue_create: thread_fork: %s\n", strerror(result));
+	}
+
+	wq->wq_next = allqueues;
+	allqueues = wq;
+	c->c_workqueue = wq;
+}
+
+void
+work_init(struct work *w, void (*func)(void *, unsigned long),
+	  void *data1, unsigned long data2)
+{
+	spinlock_init(&w->w_lock);
+	w->w_next = NULL;
+	w->w_func = func;
+	w->w_data1 = data1;
+	w->w_data2 = data2;
+	w->w_wq = NULL;
+	w->w_state = WORK_IDLE;
+	w->w_ticks = 0;
+}
+
+void
+work_cleanup(struct work *w)
+{
+	KASSERT(w->w_state == WORK_IDLE);
+	spinlock_cleanup(&w->w_lock);
+}
+
+/*
+ * Common code for work_queue and work_queue_delayed.
+ *
+ * Raise spl while we look at curcpu so we can't be migrated between
+ * choosing a queue and locking it. (Being migrated afterwards would be
+ * harmless, but this is cheap.)
+ *
+ * W's own lock is held while we check it's idle and pick its queue,
+ * so two cpus queueing the same idle item can't both see it idle and
+ * both link it. Only queueing moves an item out of WORK_IDLE, so once
+ * we've seen it idle under w_lock it stays that way until we change
+ * it. Lock order is w_lock, then the queue locks.
+ *
+ * w_lock is let go before W is linked, while we still hold the queue
+ * lock: once W is on a queue a worker may run it, and its function
+ * may free the structure W (and w_lock) is in.
+ */
+static
+bool
+work_enqueue(struct work *w, unsigned ticks)
+{
+	struct workqueue *wq;
+	int spl;
+
+	spl = splhigh();
+	wq = curcpu->c_workqueue;
+	KASSERT(wq != NULL);
+
+	spinlock_acquire(&w->w_lock);
+
+	/*
+	 * If W was last queued elsewhere, it might still be pending
+	 * there; check under that queue's lock.
+	 */
+	if (w->w_wq != NULL && w->w_wq != wq) {
+		spinlock_acquire(&w->w_wq->wq_lock);
+		if (w->w_state != WORK_IDLE) {
+			spinlock_release(&w->w_wq->wq_lock);
+			spinlock_release(&w->w_lock);
+			splx(spl);
+			return false;
+		}
+		spinlock_release(&w->w_wq->wq_lock);
+	}
+
+	spinlock_acquire(&wq->wq_lock);
+	if (w->w_state != WORK_IDLE) {
+		spinlock_release(&wq->wq_lock);
+		spinlock_release(&w->w_lock);
+		splx(spl);
+		return false;
+	}
+
+	w->w_wq = wq;
+	spinlock_release(&w->w_lock);
+
+	if (ticks == 0) {
+		workqueue_addpending(wq, w);
+	}
+	else {
+		w->w_state = WORK_DELAYED;
+		w->w_ticks = ticks;
+		w->w_next = wq->wq_delayed;
+		wq->wq_delayed = w;
+	}
+	spinlock_release(&wq->wq_lock);
+	splx(spl);
+	return true;
+}
+
+bool
+work_queue(struct work *w)
+{
+	return work_enqueue(w, 0);
+}
+
+bool
+work_queue_delayed(struct work *w, unsigned ticks)
+{
+	return work_enqueue(w, ticks);
+}
+
+bool
+work_cancel(struct work *w)
+{
+	struct workqueue *wq;
+	bool ret = false;
+
+	KASSERT(!curthread->t_in_interrupt);
+
+	/* Hold w_lock so W can't be requeued elsewhere under us. */
+	spinlock_acquire(&w->w_lock);
+	wq = w->w_wq;
+	if (wq == NULL) {
+		/* never queued */
+		spinlock_release(&w->w_lock);
+		return false;
+	}
+
+	spinlock_acquire(&wq->wq_lock);
+	switch (w->w_state) {
+	    case WORK_IDLE:
+		break;
+	    case WORK_PENDING:
+		ret = work_unlink(&wq->wq_head, w);
+		KASSERT(ret);
+		/* Recompute the tail; the list is short. */
+		wq->wq_tail = wq->wq_head;
+		while (wq->wq_tail != NULL && wq->wq_tail->w_next != NULL) {
+			wq->wq_tail = wq->wq_tail->w_next;
+		}
+		/* Count it as done so workqueue_flush doesn't wait for it. */
+		wq->wq_ndone++;
+		w->w_state = WORK_IDLE;
+		wchan_wakeall(wq->wq_flushchan, &wq->wq_lock);
+		break;
+	    case WORK_DELAYED:
+		ret = work_unlink(&wq->wq_delayed, w);
+		KASSERT(ret);
+		w->w_state = WORK_IDLE;
+		wchan_wakeall(wq->wq_flushchan, &wq->wq_lock);
+		break;
+	}
+	spinlock_release(&wq->wq_lock);
+	spinlock_release(&w->w_lock);
+
+	return ret;
+}
+
+void
+work_flush(struct work *w)
+{
+	struct workqueue *wq;
+
+	KASSERT(!curthread->t_in_interrupt);
+
+	/*
+	 * We can't sleep holding w_lock, so take the queue from under
+	 * it and then hold that queue's lock instead. If W moved to
+	 * another queue while we slept, start over there.
+	 */
+	while (1) {
+		spinlock_acquire(&w->w_lock);
+		wq = w->w_wq;
+		if (wq == NULL) {
+			/* never queued */
+			spinlock_release(&w->w_lock);
+			return;
+		}
+		spinlock_acquire(&wq->wq_lock);
+		spinlock_release(&w->w_lock);
+
+		if (w->w_state == WORK_IDLE && wq->wq_running != w) {
+			spinlock_release(&wq->wq_lock);
+			return;
+		}
+		wchan_sleep(wq->wq_flushchan, &wq->wq_lock);
+		spinlock_release(&wq->wq_lock);
+	}
+}
+
+void
+workqueue_flush(void)
+{
+	struct workqueue *wq;
+	unsigned target;
+
+	KASSERT(!curthread->t_in_interrupt);
+
+	for (wq = allqueues; wq != NULL; wq = wq->wq_next) {
+		spinlock_acquire(&wq->wq_lock);
+		target = wq->wq_nqueued;
+		/* This comparison is wraparound-safe. */
+		while ((int)(wq->wq_ndone - target) < 0) {
+			wchan_sleep(wq->wq_flushchan, &wq->wq_lock);
+		}
+		spinlock_release(&wq->wq_lock);
+	}
+}
+
+void
+workqueue_hardclock(void)
+{
+	struct workqueue *wq;
+	struct work **wp, *w;
+
+	wq = curcpu->c_workqueue;
+	if (wq == NULL) {
+		/* not started yet */
+		return;
+	}
+
+	spinlock_acquire(&wq->wq_lock);
+	wp = &wq->wq_delayed;
+	while ((w = *wp) != NULL) {
+		KASSERT(w->w_state == WORK_DELAYED);
+		KASSERT(w->w_ticks > 0);
+		if (--w->w_ticks > 0) {
+			wp = &w->w_next;
+			continue;
+		}
+		*wp = w->w_next;
+		workqueue_addpending(wq, w);
+	}
+	spinlock_release(&wq->wq_lock);
+}
@@ -236,6 +236,17 @@ null_fsync(struct vnode *v)
 	return 0;
 }
 
+/*
+ * For poll() and select(). Just pass through.
+ */
+static
+int
+dev_poll(struct vnode *v, int events, struct pollset *ps)
+{
+	struct device *d = v->vn_data;
+	return DEVOP_POLL(d, events, ps);
+}
+
 /*
  * For mmap. If you want this to do anything, you have to write it
  * yourself. Some devices may not make sense to map. Others do.
@@ -336,6 +347,7 @@ static const struct vnode_ops dev_vnode_ops = {
 	.vop_gettype = dev_gettype,
 	.vop_isseekable = dev_isseekable,
 	.vop_fsync = null_fsync,
+	.vop_poll = dev_poll,
 	.vop_mmap = dev_mmap,
 	.vop_truncate = dev_truncate,
 	.vop_namefile = dev_namefile,
@@ -33,6 +33,7 @@
  */
 #include <types.h>
 #include <kern/errno.h>
+#include <kern/poll.h>
 #include <lib.h>
 #include <uio.h>
 #include <vfs.h>
@@ -88,10 +89,22 @@ nullioctl(struct device *dev, int op, userptr_t data)
 	return EINVAL;
 }
 
+/* For poll() - reads get EOF and writes vanish, so always ready. */
+static
+int
+nullpoll(struct device *dev, int events, struct pollset *ps)
+{
+	(void)dev;
+	(void)ps;
+
+	return events & (POLLIN | POLLOUT);
+}
+
 static const struct device_ops null_devops = {
 	.devop_eachopen = nullopen,
 	.devop_io = nullio,
 	.devop_ioctl = nullioctl,
+	.devop_poll = nullpoll,
 };
 
 /*
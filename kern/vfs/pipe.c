@@ -0,0 +1,709 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Pipes. See pipe.h.
+ *
+ * A pipe is a PIPE_SIZE byte ring with two free-running counters: the
+ * bytes ever put in (pi_head) and ever taken out (pi_tail). Only the
+ * writer moves the head and only the reader moves the tail, and the
+ * bytes between them belong to the reader and the rest to the writer,
+ * so the copying itself happens without holding anything but the
+ * per-end sleep lock that lets one reader (and one writer) in at a
+ * time. pi_lock is only taken to look at and move the counters and to
+ * sleep and wake.
+ *
+ * A write of a page or more doesn't go through the ring at all. The
+ * writer fills whole pages and hands them to the reader on a queue,
+ * up to PIPE_MAXPAGES at a time, so a big transfer moves in page-sized
+ * pieces rather than ring-sized ones, and the writer can fill the next
+ * page while the reader empties the last. To keep the bytes in order,
+ * the ring and the page queue are never both in use: ring writes wait
+ * for the queue to drain and page writes for the ring to. Pages are
+ * kept in a pool afterwards rather than freed, so busy pipes don't
+ * keep going back to the page allocator.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/limits.h>
+#include <kern/poll.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <wchan.h>
+#include <synch.h>
+#include <uio.h>
+#include <stat.h>
+#include <vm.h>
+#include <vnode.h>
+#include <poll.h>
+#include <pipe.h>
+
+#define PIPE_SIZE	1024	/* Ring size; a power of two >= PIPE_BUF */
+#define PIPE_MAXPAGES	8	/* Pages queued at once, per pipe */
+#define PIPE_POOLMAX	32	/* Spare pages kept for reuse */
+
+/*
+ * A page handed from the writer to the reader.
+ */
+struct pipepage {
+	struct pipepage *pp_next;
+	char *pp_data;			/* PAGE_SIZE bytes */
+	unsigned pp_pos;		/* Next byte to read */
+	unsigned pp_len;		/* Bytes written */
+};
+
+struct pipe {
+	struct vnode pi_rvn;		/* Read end */
+	struct vnode pi_wvn;		/* Write end */
+	struct lock *pi_rlock;		/* One reader at a time */
+	struct lock *pi_wlock;		/* One writer at a time */
+	char *pi_ring;			/* PIPE_SIZE bytes */
+
+	struct spinlock pi_lock;	/* Protects the rest */
+	struct wchan *pi_rwchan;	/* Reader waiting for data */
+	struct wchan *pi_wwchan;	/* Writer waiting for room */
+	struct pollq pi_rpollq;		/* Pollers of the read end */
+	struct pollq pi_wpollq;		/* Pollers of the write end */
+	unsigned pi_head;		/* Bytes ever put in the ring */
+	unsigned pi_tail;		/* Bytes ever taken out */
+	struct pipepage *pi_pages;	/* Queued pages */
+	struct pipepage **pi_pagetail;
+	unsigned pi_npages;
+	bool pi_rclosed;		/* Read end closed */
+	bool pi_wclosed;		/* Write end closed */
+	unsigned pi_nends;		/* Ends not yet done with the pipe */
+};
+
+static struct spinlock pipe_poollock = SPINLOCK_INITIALIZER;
+static struct pipepage *pipe_pool;
+static unsigned pipe_poolcount;
+
+////////////////////////////////////////////////////////////
+// Page pool
+
+static
+struct pipepage *
+pipe_getpage(void)
+{
+	struct pipepage *pp;
+
+	spinlock_acquire(&pipe_poollock);
+	pp = pipe_pool;
+	if (pp != NULL) {
+		pipe_pool = pp->pp_next;
+		pipe_poolcount--;
+	}
+	spinlock_release(&pipe_poollock);
+	if (pp != NULL) {
+		return pp;
+	}
+
+	pp = kmalloc(sizeof(*pp));
+	if (pp == NULL) {
+		return NULL;
+	}
+	pp->pp_data = (char *)alloc_kpages(1);
+	if (pp->pp_data == NULL) {
+		kfree(pp);
+		return NULL;
+	}
+	return pp;
+}
+
+static
+void
+pipe_putpage(struct pipepage *pp)
+{
+	spinlock_acquire(&pipe_poollock);
+	if (pipe_poolcount < PIPE_POOLMAX) {
+		pp->pp_next = pipe_pool;
+		pipe_pool = pp;
+		pipe_poolcount++;
+		pp = NULL;
+	}
+	spinlock_release(&pipe_poollock);
+
+	if (pp != NULL) {
+		free_kpages((vaddr_t)pp->pp_data);
+		kfree(pp);
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Reading
+
+/*
+ * Wait until there's something to read, or the write end is closed
+ * and there never will be. Returns with pi_lock held. If DONTWAIT,
+ * just look.
+ */
+static
+bool
+pipe_waitdata(struct pipe *p, bool dontwait)
+{
+	spinlock_acquire(&p->pi_lock);
+	while (p->pi_head == p->pi_tail && p->pi_npages == 0) {
+		if (dontwait || p->pi_wclosed) {
+			return false;
+		}
+		wchan_sleep(p->pi_rwchan, &p->pi_lock);
+	}
+	return true;
+}
+
+/*
+ * Wake the writer and its pollers; the reader made room. Called with
+ * pi_lock held, and releases it.
+ */
+static
+void
+pipe_wakewriter(struct pipe *p)
+{
+	wchan_wakeall(p->pi_wwchan, &p->pi_lock);
+	spinlock_release(&p->pi_lock);
+	pollq_wakeup(&p->pi_wpollq);
+}
+
+static
+int
+pipe_readring(struct pipe *p, struct uio *uio)
+{
+	unsigned head, tail, n;
+	int result;
+
+	head = p->pi_head;
+	tail = p->pi_tail;
+	spinlock_release(&p->pi_lock);
+
+	/* At most two pieces, if the data wraps around */
+	n = head - tail;
+	if (n > PIPE_SIZE - (tail % PIPE_SIZE)) {
+		n = PIPE_SIZE - (tail % PIPE_SIZE);
+	}
+	if (n > uio->uio_resid) {
+		n = uio->uio_resid;
+	}
+	result = uiomove(p->pi_ring + (tail % PIPE_SIZE), n, uio);
+	if (result) {
+		return result;
+	}
+
+	spinlock_acquire(&p->pi_lock);
+	p->pi_tail = tail + n;
+	pipe_wakewriter(p);
+	return 0;
+}
+
+static
+int
+pipe_readpage(struct pipe *p, struct uio *uio)
+{
+	struct pipepage *pp;
+	unsigned n;
+	int result;
+
+	/* Only we take pages off, so it stays put. */
+	pp = p->pi_pages;
+	spinlock_release(&p->pi_lock);
+
+	n = pp->pp_len - pp->pp_pos;
+	if (n > uio->uio_resid) {
+		n = uio->uio_resid;
+	}
+	result = uiomove(pp->pp_data + pp->pp_pos, n, uio);
+	if (result) {
+		return result;
+	}
+	pp->pp_pos += n;
+	if (pp->pp_pos < pp->pp_len) {
+		return 0;
+	}
+
+	spinlock_acquire(&p->pi_lock);
+	p->pi_pages = pp->pp_next;
+	if (p->pi_pages == NULL) {
+		p->pi_pagetail = &p->pi_pages;
+	}
+	p->pi_npages--;
+	pipe_wakewriter(p);
+	pipe_putpage(pp);
+	return 0;
+}
+
+/*
+ * Read what's there, waiting only if nothing is.
+ */
+static
+int
+pipe_read(struct vnode *v, struct uio *uio)
+{
+	struct pipe *p = v->vn_data;
+	size_t start = uio->uio_resid;
+	int result = 0;
+
+	if (v != &p->pi_rvn) {
+		return EBADF;
+	}
+
+	lock_acquire(p->pi_rlock);
+	while (uio->uio_resid > 0) {
+		if (!pipe_waitdata(p, uio->uio_resid < start)) {
+			spinlock_release(&p->pi_lock);
+			break;
+		}
+		if (p->pi_npages > 0) {
+			result = pipe_readpage(p, uio);
+		}
+		else {
+			result = pipe_readring(p, uio);
+		}
+		if (result) {
+			break;
+		}
+	}
+	lock_release(p->pi_rlock);
+
+	/* Report what did get read rather than a later fault */
+	return uio->uio_resid < start ? 0 : result;
+}
+
+////////////////////////////////////////////////////////////
+// Writing
+
+/*
+ * Wake the reader and its pollers; the writer added data. Called with
+ * pi_lock held, and releases it.
+ */
+static
+void
+pipe_wakereader(struct pipe *p)
+{
+	wchan_wakeall(p->pi_rwchan, &p->pi_lock);
+	spinlock_release(&p->pi_lock);
+	pollq_wakeup(&p->pi_rpollq);
+}
+
+static
+int
+pipe_writering(struct pipe *p, struct uio *uio)
+{
+	unsigned head, tail, n;
+	int result;
+
+	while (uio->uio_resid > 0) {
+		spinlock_acquire(&p->pi_lock);
+		while (!p->pi_rclosed &&
+		       (p->pi_npages > 0 ||
+			p->pi_head - p->pi_tail == PIPE_SIZE)) {
+			wchan_sleep(p->pi_wwchan, &p->pi_lock);
+		}
+		if (p->pi_rclosed) {
+			spinlock_release(&p->pi_lock);
+			return EPIPE;
+		}
+		head = p->pi_head;
+		tail = p->pi_tail;
+		spinlock_release(&p->pi_lock);
+
+		n = PIPE_SIZE - (head - tail);
+		if (n > PIPE_SIZE - (head % PIPE_SIZE)) {
+			n = PIPE_SIZE - (head % PIPE_SIZE);
+		}
+		if (n > uio->uio_resid) {
+			n = uio->uio_resid;
+		}
+		result = uiomove(p->pi_ring + (head % PIPE_SIZE), n, uio);
+		if (result) {
+			return result;
+		}
+
+		spinlock_acquire(&p->pi_lock);
+		p->pi_head = head + n;
+		pipe_wakereader(p);
+	}
+	return 0;
+}
+
+static
+int
+pipe_writepages(struct pipe *p, struct uio *uio)
+{
+	struct pipepage *pp;
+	unsigned n;
+	int result;
+
+	while (uio->uio_resid > 0) {
+		pp = pipe_getpage();
+		if (pp == NULL) {
+			return ENOMEM;
+		}
+
+		/* Fill it before waiting, while the reader drains others */
+		n = PAGE_SIZE;
+		if (n > uio->uio_resid) {
+			n = uio->uio_resid;
+		}
+		result = uiomove(pp->pp_data, n, uio);
+		if (result) {
+			pipe_putpage(pp);
+			return result;
+		}
+		pp->pp_next = NULL;
+		pp->pp_pos = 0;
+		pp->pp_len = n;
+
+		spinlock_acquire(&p->pi_lock);
+		while (!p->pi_rclosed && (p->pi_head != p->pi_tail ||
+					  p->pi_npages >= PIPE_MAXPAGES)) {
+			wchan_sleep(p->pi_wwchan, &p->pi_lock);
+		}
+		if (p->pi_rclosed) {
+			spinlock_release(&p->pi_lock);
+			pipe_putpage(pp);
+			return EPIPE;
+		}
+		*p->pi_pagetail = pp;
+		p->pi_pagetail = &pp->pp_next;
+		p->pi_npages++;
+		pipe_wakereader(p);
+	}
+	return 0;
+}
+
+static
+int
+pipe_write(struct vnode *v, struct uio *uio)
+{
+	struct pipe *p = v->vn_data;
+	int result;
+
+	if (v != &p->pi_wvn) {
+		return EBADF;
+	}
+
+	lock_acquire(p->pi_wlock);
+	if (uio->uio_resid >= PAGE_SIZE) {
+		result = pipe_writepages(p, uio);
+	}
+	else {
+		result = pipe_writering(p, uio);
+	}
+	lock_release(p->pi_wlock);
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////
+// Other vnode ops
+
+/*
+ * The read end is readable when there's data, and at end of file,
+ * which is also a hangup. The write end is writable when PIPE_BUF
+ * bytes would go in without waiting, and an error once nobody can
+ * read. Hook onto the pollq before looking, so nothing is missed.
+ */
+static
+int
+pipe_poll(struct vnode *v, int events, struct pollset *ps)
+{
+	struct pipe *p = v->vn_data;
+	int ready = 0;
+
+	if (v == &p->pi_rvn) {
+		if (ps != NULL) {
+			pollq_add(&p->pi_rpollq, ps);
+		}
+		spinlock_acquire(&p->pi_lock);
+		if (p->pi_head != p->pi_tail || p->pi_npages > 0) {
+			ready |= POLLIN;
+		}
+		else if (p->pi_wclosed) {
+			ready |= POLLIN | POLLHUP;
+		}
+		spinlock_release(&p->pi_lock);
+	}
+	else {
+		if (ps != NULL) {
+			pollq_add(&p->pi_wpollq, ps);
+		}
+		spinlock_acquire(&p->pi_lock);
+		if (p->pi_rclosed) {
+			ready |= POLLERR;
+		}
+		else if (p->pi_npages == 0 &&
+			 PIPE_SIZE - (p->pi_head - p->pi_tail) >= __PIPE_BUF) {
+			ready |= POLLOUT;
+		}
+		spinlock_release(&p->pi_lock);
+	}
+	return ready & (events | POLLERR | POLLHUP);
+}
+
+static
+void
+pipe_destroy(struct pipe *p)
+{
+	struct pipepage *pp;
+
+	while (p->pi_pages != NULL) {
+		pp = p->pi_pages;
+		p->pi_pages = pp->pp_next;
+		pipe_putpage(pp);
+	}
+	pollq_cleanup(&p->pi_wpollq);
+	pollq_cleanup(&p->pi_rpollq);
+	wchan_destroy(p->pi_wwchan);
+	wchan_destroy(p->pi_rwchan);
+	spinlock_cleanup(&p->pi_lock);
+	kfree(p->pi_ring);
+	lock_destroy(p->pi_wlock);
+	lock_destroy(p->pi_rlock);
+	kfree(p);
+}
+
+/*
+ * One end has been closed for the last time. Tell the other end, and
+ * if it's closed too, the pipe is done. Both ends can get here at
+ * once, so the closed flags don't say when it's safe to free the
+ * pipe; pi_nends does, and whichever end takes it to zero does so
+ * only after it's finished with the pipe.
+ */
+static
+int
+pipe_reclaim(struct vnode *v)
+{
+	struct pipe *p = v->vn_data;
+	bool done;
+
+	spinlock_acquire(&v->vn_countlock);
+	if (v->vn_refcount != 1) {
+		/* consume the reference VOP_DECREF gave us */
+		KASSERT(v->vn_refcount > 1);
+		v->vn_refcount--;
+		spinlock_release(&v->vn_countlock);
+		return EBUSY;
+	}
+	spinlock_release(&v->vn_countlock);
+
+	spinlock_acquire(&p->pi_lock);
+	if (v == &p->pi_rvn) {
+		p->pi_rclosed = true;
+		wchan_wakeall(p->pi_wwchan, &p->pi_lock);
+	}
+	else {
+		p->pi_wclosed = true;
+		wchan_wakeall(p->pi_rwchan, &p->pi_lock);
+	}
+	spinlock_release(&p->pi_lock);
+
+	pollq_wakeup(v == &p->pi_rvn ? &p->pi_wpollq : &p->pi_rpollq);
+	vnode_cleanup(v);
+
+	spinlock_acquire(&p->pi_lock);
+	KASSERT(p->pi_nends > 0);
+	p->pi_nends--;
+	done = p->pi_nends == 0;
+	spinlock_release(&p->pi_lock);
+
+	if (done) {
+		pipe_destroy(p);
+	}
+	return 0;
+}
+
+static
+int
+pipe_eachopen(struct vnode *v, int flags)
+{
+	/* Pipes aren't in the name space, so this can't happen. */
+	(void)v;
+	(void)flags;
+	return EINVAL;
+}
+
+static
+int
+pipe_ioctl(struct vnode *v, int op, userptr_t data)
+{
+	(void)v;
+	(void)op;
+	(void)data;
+	return EIOCTL;
+}
+
+static
+int
+pipe_stat(struct vnode *v, struct stat *statbuf)
+{
+	struct pipe *p = v->vn_data;
+	struct pipepage *pp;
+
+	bzero(statbuf, sizeof(*statbuf));
+	statbuf->st_mode = S_IFIFO | 0600;
+	statbuf->st_nlink = 1;
+	statbuf->st_blksize = PIPE_SIZE;
+
+	/* What's waiting to be read */
+	spinlock_acquire(&p->pi_lock);
+	statbuf->st_size = p->pi_head - p->pi_tail;
+	for (pp = p->pi_pages; pp != NULL; pp = pp->pp_next) {
+		statbuf->st_size += pp->pp_len - pp->pp_pos;
+	}
+	spinlock_release(&p->pi_lock);
+
+	return 0;
+}
+
+static
+int
+pipe_gettype(struct vnode *v, mode_t *ret)
+{
+	(void)v;
+	*ret = S_IFIFO;
+	return 0;
+}
+
+static
+bool
+pipe_isseekable(struct vnode *v)
+{
+	(void)v;
+	return false;
+}
+
+static
+int
+pipe_fsync(struct vnode *v)
+{
+	(void)v;
+	return EINVAL;
+}
+
+static
+int
+pipe_truncate(struct vnode *v, off_t len)
+{
+	(void)v;
+	(void)len;
+	return EINVAL;
+}
+
+static const struct vnode_ops pipe_vnode_ops = {
+	.vop_magic = VOP_MAGIC,
+
+	.vop_eachopen = pipe_eachopen,
+	.vop_reclaim = pipe_reclaim,
+	.vop_read = pipe_read,
+	.vop_readlink = vopfail_uio_inval,
+	.vop_getdirentry = vopfail_uio_notdir,
+	.vop_write = pipe_write,
+	.vop_ioctl = pipe_ioctl,
+	.vop_stat = pipe_stat,
+	.vop_gettype = pipe_gettype,
+	.vop_isseekable = pipe_isseekable,
+	.vop_fsync = pipe_fsync,
+	.vop_poll = pipe_poll,
+	.vop_mmap = vopfail_mmap_nosys,
+	.vop_truncate = pipe_truncate,
+	.vop_namefile = vopfail_uio_notdir,
+	.vop_creat = vopfail_creat_notdir,
+	.vop_symlink = vopfail_symlink_notdir,
+	.vop_mkdir = vopfail_mkdir_notdir,
+	.vop_link = vopfail_link_notdir,
+	.vop_remove = vopfail_string_notdir,
+	.vop_rmdir = vopfail_string_notdir,
+	.vop_rename = vopfail_rename_notdir,
+	.vop_lookup = vopfail_lookup_notdir,
+	.vop_lookparent = vopfail_lookparent_notdir,
+};
+
+////////////////////////////////////////////////////////////
+
+int
+pipe_create(struct vnode **readvn, struct vnode **writevn)
+{
+	struct pipe *p;
+
+	p = kmalloc(sizeof(*p));
+	if (p == NULL) {
+		goto fail;
+	}
+	p->pi_rlock = lock_create("pipe-read");
+	if (p->pi_rlock == NULL) {
+		goto fail_pipe;
+	}
+	p->pi_wlock = lock_create("pipe-write");
+	if (p->pi_wlock == NULL) {
+		goto fail_rlock;
+	}
+	p->pi_ring = kmalloc(PIPE_SIZE);
+	if (p->pi_ring == NULL) {
+		goto fail_wlock;
+	}
+	p->pi_rwchan = wchan_create("pipe-read");
+	if (p->pi_rwchan == NULL) {
+		goto fail_ring;
+	}
+	p->pi_wwchan = wchan_create("pipe-write");
+	if (p->pi_wwchan == NULL) {
+		goto fail_rwchan;
+	}
+
+	spinlock_init(&p->pi_lock);
+	pollq_init(&p->pi_rpollq);
+	pollq_init(&p->pi_wpollq);
+	p->pi_head = p->pi_tail = 0;
+	p->pi_pages = NULL;
+	p->pi_pagetail = &p->pi_pages;
+	p->pi_npages = 0;
+	p->pi_rclosed = p->pi_wclosed = false;
+	p->pi_nends = 2;
+
+	/* These can't fail. */
+	vnode_init(&p->pi_rvn, &pipe_vnode_ops, NULL, p);
+	vnode_init(&p->pi_wvn, &pipe_vnode_ops, NULL, p);
+
+	*readvn = &p->pi_rvn;
+	*writevn = &p->pi_wvn;
+	return 0;
+
+ fail_rwchan:
+	wchan_destroy(p->pi_rwchan);
+ fail_ring:
+	kfree(p->pi_ring);
+ fail_wlock:
+	lock_destroy(p->pi_wlock);
+ fail_rlock:
+	lock_destroy(p->pi_rlock);
+ fail_pipe:
+	kfree(p);
+ fail:
+	return ENOMEM;
+}
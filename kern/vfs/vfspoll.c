@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Wait queues for poll() and select(). See poll.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/poll.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <wchan.h>
+#include <workqueue.h>
+#include <vnode.h>
+#include <poll.h>
+
+/*
+ * One pollset hooked onto one pollq. It's on the pollq's list, under
+ * the pollq's lock, and on the pollset's, which only the poller uses.
+ */
+struct pollent {
+	struct pollq *pe_q;
+	struct pollset *pe_set;
+	struct pollent *pe_qnext;	/* On pe_q's list */
+	struct pollent **pe_qprev;
+	struct pollent *pe_setnext;	/* On pe_set's list */
+};
+
+void
+pollq_init(struct pollq *pq)
+{
+	spinlock_init(&pq->pq_lock);
+	pq->pq_ents = NULL;
+}
+
+void
+pollq_cleanup(struct pollq *pq)
+{
+	KASSERT(pq->pq_ents == NULL);
+	spinlock_cleanup(&pq->pq_lock);
+}
+
+void
+pollq_add(struct pollq *pq, struct pollset *ps)
+{
+	struct pollent *pe;
+
+	pe = kmalloc(sizeof(*pe));
+	if (pe == NULL) {
+		if (ps->ps_err == 0) {
+			ps->ps_err = ENOMEM;
+		}
+		return;
+	}
+	pe->pe_q = pq;
+	pe->pe_set = ps;
+	pe->pe_setnext = ps->ps_ents;
+	ps->ps_ents = pe;
+
+	spinlock_acquire(&pq->pq_lock);
+	pe->pe_qnext = pq->pq_ents;
+	pe->pe_qprev = &pq->pq_ents;
+	if (pe->pe_qnext != NULL) {
+		pe->pe_qnext->pe_qprev = &pe->pe_qnext;
+	}
+	pq->pq_ents = pe;
+	spinlock_release(&pq->pq_lock);
+}
+
+/*
+ * Lock order is pollq, then pollset.
+ */
+void
+pollq_wakeup(struct pollq *pq)
+{
+	struct pollent *pe;
+	struct pollset *ps;
+
+	spinlock_acquire(&pq->pq_lock);
+	for (pe = pq->pq_ents; pe != NULL; pe = pe->pe_qnext) {
+		ps = pe->pe_set;
+		spinlock_acquire(&ps->ps_lock);
+		ps->ps_woken = true;
+		wchan_wakeall(ps->ps_wchan, &ps->ps_lock);
+		spinlock_release(&ps->ps_lock);
+	}
+	spinlock_release(&pq->pq_lock);
+}
+
+////////////////////////////////////////////////////////////
+
+/*
+ * Timeout handler; runs on the workqueue.
+ */
+static
+void
+pollset_expire(void *data1, unsigned long data2)
+{
+	struct pollset *ps = data1;
+
+	(void)data2;
+
+	spinlock_acquire(&ps->ps_lock);
+	ps->ps_expired = true;
+	wchan_wakeall(ps->ps_wchan, &ps->ps_lock);
+	spinlock_release(&ps->ps_lock);
+}
+
+int
+pollset_init(struct pollset *ps)
+{
+	ps->ps_wchan = wchan_create("poll");
+	if (ps->ps_wchan == NULL) {
+		return ENOMEM;
+	}
+	spinlock_init(&ps->ps_lock);
+	ps->ps_woken = false;
+	ps->ps_expired = false;
+	ps->ps_err = 0;
+	ps->ps_ents = NULL;
+	work_init(&ps->ps_timer, pollset_expire, ps, 0);
+	return 0;
+}
+
+void
+pollset_cleanup(struct pollset *ps)
+{
+	struct pollent *pe;
+	struct pollq *pq;
+
+	/* The timer must be done with PS before it goes away. */
+	work_cancel(&ps->ps_timer);
+	work_flush(&ps->ps_timer);
+	work_cleanup(&ps->ps_timer);
+
+	while (ps->ps_ents != NULL) {
+		pe = ps->ps_ents;
+		ps->ps_ents = pe->pe_setnext;
+
+		pq = pe->pe_q;
+		spinlock_acquire(&pq->pq_lock);
+		*pe->pe_qprev = pe->pe_qnext;
+		if (pe->pe_qnext != NULL) {
+			pe->pe_qnext->pe_qprev = pe->pe_qprev;
+		}
+		spinlock_release(&pq->pq_lock);
+		kfree(pe);
+	}
+
+	spinlock_cleanup(&ps->ps_lock);
+	wchan_destroy(ps->ps_wchan);
+}
+
+int
+pollset_error(struct pollset *ps)
+{
+	return ps->ps_err;
+}
+
+void
+pollset_timeout(struct pollset *ps, unsigned ticks)
+{
+	work_queue_delayed(&ps->ps_timer, ticks);
+}
+
+bool
+pollset_wait(struct pollset *ps)
+{
+	bool expired;
+
+	spinlock_acquire(&ps->ps_lock);
+	while (!ps->ps_woken && !ps->ps_expired) {
+		wchan_sleep(ps->ps_wchan, &ps->ps_lock);
+	}
+	ps->ps_woken = false;
+	expired = ps->ps_expired;
+	spinlock_release(&ps->ps_lock);
+
+	return expired;
+}
+
+////////////////////////////////////////////////////////////
+
+/*
+ * vop_poll for objects that never block.
+ */
+int
+vopready_poll(struct vnode *vn, int events, struct pollset *ps)
+{
+	(void)vn;
+	(void)ps;
+	return events & (POLLIN | POLLOUT);
+}
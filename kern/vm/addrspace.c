@@ -50,6 +50,10 @@ as_create(void)
 		return NULL;
 	}
 
+	spinlock_init(&as->as_reflock);
+	as->as_refcount = 1;
+	as->as_shared = false;
+
 	/*
 	 * Initialize as needed.
 	 */
@@ -77,6 +81,38 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 	return 0;
 }
 
+void
+as_incref(struct addrspace *as)
+{
+	spinlock_acquire(&as->as_reflock);
+	KASSERT(as->as_refcount > 0);
+	as->as_refcount++;
+	as->as_shared = true;
+	spinlock_release(&as->as_reflock);
+}
+
+void
+as_decref(struct addrspace *as)
+{
+	unsigned refcount;
+
+	spinlock_acquire(&as->as_reflock);
+	KASSERT(as->as_refcount > 0);
+	refcount = --as->as_refcount;
+	spinlock_release(&as->as_reflock);
+
+	if (refcount > 0) {
+		return;
+	}
+
+	/*
+	 * If as_shared is set, shoot down this address space's
+	 * mappings on the other cpus before the pages are reused.
+	 */
+
+	as_destroy(as);
+}
+
 void
 as_destroy(struct addrspace *as)
 {
@@ -84,6 +120,7 @@ as_destroy(struct addrspace *as)
 	 * Clean up as needed.
 	 */
 
+	spinlock_cleanup(&as->as_reflock);
 	kfree(as);
 }
 
@@ -180,3 +217,17 @@ as_define_stack(struct addrspace *as, vaddr_t *stackptr)
 	return 0;
 }
 
+int
+as_translate(struct addrspace *as, vaddr_t vaddr, paddr_t *ret)
+{
+	/*
+	 * Write this.
+	 */
+
+	(void)as;
+	(void)vaddr;
+	(void)ret;
+
+	return EFAULT;
+}
+
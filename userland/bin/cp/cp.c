@@ -28,6 +28,7 @@
  */
 
 #include <unistd.h>
+#include <errno.h>
 #include <err.h>
 
 /*
@@ -35,6 +36,9 @@
  * Usage: cp oldfile newfile
  */
 
+/* How much to ask copy_file_range for at a time. */
+#define COPYSIZE (1024*1024)
+
 
 /* Copy one file to another. */
 static
@@ -58,6 +62,17 @@ copy(const char *from, const char *to)
 		err(1, "%s", to);
 	}
 
+	/*
+	 * Let the kernel move the data if it can; then it never comes
+	 * out here at all. Fall back to read and write if it can't.
+	 */
+	while ((len = copy_file_range(fromfd, tofd, COPYSIZE))>0) {
+		/* nothing */
+	}
+	if (len<0 && errno!=ENOSYS) {
+		err(1, "%s to %s", from, to);
+	}
+
 	/*
 	 * As long as we get more than zero bytes, we haven't hit EOF.
 	 * Zero means EOF. Less than zero means an error occurred.
@@ -48,6 +48,8 @@
 
 #ifdef HOST
 #include "hostcompat.h"
+#else
+#include <spawn.h>
 #endif
 
 #ifndef NARG_MAX
@@ -421,6 +423,7 @@ docommand(char *buf, struct exitinfo *ei)
 		__time(&startsecs, &startnsecs);
 	}
 
+#ifdef HOST
 	pid = fork();
 	switch (pid) {
 		case -1:
@@ -443,6 +446,15 @@ docommand(char *buf, struct exitinfo *ei)
 		default:
 			break;
 	}
+#else
+	/* No point copying the whole shell just to throw it away */
+	pid = spawnvp(args[0], args, NULL, 0);
+	if (pid < 0) {
+		warn("%s", args[0]);
+		exitinfo_exit(ei, 1);
+		return;
+	}
+#endif
 
 	/* parent */
 	if (bg) {
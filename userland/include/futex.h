@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _FUTEX_H_
+#define _FUTEX_H_
+
+/*
+ * Userlevel mutexes and semaphores that only enter the kernel when
+ * they have to wait or wake someone up.
+ *
+ * futex_wait(addr, val) sleeps if *addr still contains val, and fails
+ * with EAGAIN at once if it doesn't. futex_wake(addr, count) wakes up
+ * to count sleepers on addr and returns how many it woke. These are
+ * system calls; the rest is in libc.
+ *
+ * Waiters are keyed by physical address, so a mutex or semaphore
+ * works across processes if it's in memory they share; otherwise it
+ * only works among the threads of one process.
+ */
+
+/* System calls. */
+int futex_wait(volatile int *addr, int val);
+int futex_wake(volatile int *addr, int count);
+
+/*
+ * Mutex. fm_state is 0 if unlocked, 1 if locked, and 2 if locked and
+ * someone might be waiting. Unlocking from 1 doesn't enter the kernel.
+ */
+struct fmutex {
+	volatile int fm_state;
+};
+
+#define FMUTEX_INITIALIZER	{ 0 }
+
+void fmutex_init(struct fmutex *fm);
+int fmutex_trylock(struct fmutex *fm);		/* 0 on success */
+void fmutex_lock(struct fmutex *fm);
+void fmutex_unlock(struct fmutex *fm);
+
+/*
+ * Semaphore. fs_count is the count; fs_waiters is the number of
+ * threads in (or about to be in) futex_wait, so V can skip the
+ * system call when nobody is waiting.
+ */
+struct fsem {
+	volatile int fs_count;
+	volatile int fs_waiters;
+};
+
+void fsem_init(struct fsem *fs, unsigned count);
+int fsem_tryP(struct fsem *fs);			/* 0 on success */
+void fsem_P(struct fsem *fs);
+void fsem_V(struct fsem *fs);
+
+#endif /* _FUTEX_H_ */
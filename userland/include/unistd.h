@@ -40,12 +40,32 @@
  */
 #include <kern/fcntl.h>
 #include <kern/ioctl.h>
+#include <kern/poll.h>
 #include <kern/reboot.h>
+#include <kern/resource.h>
 #include <kern/seek.h>
 #include <kern/time.h>
 #include <kern/unistd.h>
 #include <kern/wait.h>
 
+/*
+ * Descriptor sets for select().
+ */
+#define FD_SETSIZE	__FD_SETSIZE
+typedef struct __fd_set fd_set;
+
+#define __FDWORD(fd, s)	((s)->fds_bits[(fd) / __NFDBITS])
+#define __FDMASK(fd)	(1U << ((fd) % __NFDBITS))
+#define FD_SET(fd, s)	(__FDWORD(fd, s) |= __FDMASK(fd))
+#define FD_CLR(fd, s)	(__FDWORD(fd, s) &= ~__FDMASK(fd))
+#define FD_ISSET(fd, s)	((__FDWORD(fd, s) & __FDMASK(fd)) != 0)
+#define FD_ZERO(s) do { \
+		unsigned __i; \
+		for (__i = 0; __i < FD_SETSIZE / __NFDBITS; __i++) { \
+			(s)->fds_bits[__i] = 0; \
+		} \
+	} while (0)
+
 
 /*
  * Prototypes for OS/161 system calls.
@@ -62,12 +82,16 @@
  * header files as well, as follows:
  *
  *     waitpid:  sys/wait.h
+ *     wait4:    sys/wait.h
  *     open:     fcntl.h or sys/fcntl.h
  *     reboot:   sys/reboot.h
  *     ioctl:    sys/ioctl.h
  *     remove:   stdio.h
  *     rename:   stdio.h
  *     time:     time.h
+ *     poll:     poll.h
+ *     select:   sys/select.h
+ *     getrusage: sys/resource.h
  *
  * Also note that the prototypes for open() and mkdir() contain, for
  * compatibility with Unix, an extra argument that is not meaningful
@@ -144,13 +168,27 @@ void *sbrk(__intptr_t change);
 ssize_t getdirentry(int filehandle, char *buf, size_t buflen);
 int symlink(const char *target, const char *linkname);
 ssize_t readlink(const char *path, char *buf, size_t buflen);
+ssize_t pread(int filehandle, void *buf, size_t size, off_t pos);
+ssize_t pwrite(int filehandle, const void *buf, size_t size, off_t pos);
 int dup2(int filehandle, int newhandle);
 int pipe(int filehandles[2]);
+pid_t wait4(pid_t pid, int *returncode, int flags, struct rusage *usage);
+int getrusage(int who, struct rusage *usage);
+int poll(struct pollfd *fds, unsigned nfds, int timeout);
+int select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
+	   struct timeval *timeout);
 int __time(time_t *seconds, unsigned long *nanoseconds);
 ssize_t __getcwd(char *buf, size_t buflen);
 /* stat - see sys/stat.h */
 /* lstat - see sys/stat.h */
 
+/* OS/161 extensions. (futex_wait and futex_wake are in futex.h.) */
+int __threadfork(void (*entry)(void *), void *arg, void *stackptr);
+__DEAD void threadexit(int status);
+int threadjoin(int tid, int *status);
+/* Copies from infd's position to outfd's. Unlike Linux, no offsets or flags. */
+ssize_t copy_file_range(int infd, int outfd, size_t len);
+
 /*
  * These are not themselves system calls, but wrapper routines in libc.
  */
@@ -158,5 +196,7 @@ ssize_t __getcwd(char *buf, size_t buflen);
 int execvp(const char *prog, char *const *args); /* calls execv */
 char *getcwd(char *buf, size_t buflen);		/* calls __getcwd */
 time_t time(time_t *seconds);			/* calls __time */
+int threadfork(void (*func)(void *), void *arg,
+	       void *stack, size_t stacksize);	/* calls __threadfork */
 
 #endif /* _UNISTD_H_ */
@@ -31,23 +31,27 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <spawn.h>
 #include <errno.h>
 #include <limits.h>
 
 /*
- * POSIX C function: exec a program on the search path. Tries
- * execv() repeatedly until one of the choices works.
+ * Call TRY with each place PROG might be found on the search path,
+ * until one works (returns something other than -1) or fails with
+ * something other than "it isn't here". DATA is passed along to TRY.
  */
+static
 int
-execvp(const char *prog, char *const *args)
+pathsearch(const char *prog, int (*try)(const char *, const void *),
+	   const void *data)
 {
 	const char *searchpath, *s, *t;
 	char progpath[PATH_MAX];
 	size_t len;
+	int result;
 
 	if (strchr(prog, '/') != NULL) {
-		execv(prog, args);
-		return -1;
+		return try(prog, data);
 	}
 
 	searchpath = getenv("PATH");
@@ -74,7 +78,10 @@ execvp(const char *prog, char *const *args)
 		}
 		memcpy(progpath, s, len);
 		snprintf(progpath + len, sizeof(progpath) - len, "/%s", prog);
-		execv(progpath, args);
+		result = try(progpath, data);
+		if (result != -1) {
+			return result;
+		}
 		switch (errno) {
 		    case ENOENT:
 		    case ENOTDIR:
@@ -89,3 +96,53 @@ execvp(const char *prog, char *const *args)
 	errno = ENOENT;
 	return -1;
 }
+
+static
+int
+tryexec(const char *path, const void *data)
+{
+	/* execv only returns if it fails */
+	execv(path, (char *const *)data);
+	return -1;
+}
+
+/*
+ * POSIX C function: exec a program on the search path. Tries
+ * execv() repeatedly until one of the choices works.
+ */
+int
+execvp(const char *prog, char *const *args)
+{
+	return pathsearch(prog, tryexec, args);
+}
+
+struct spawnvp_data {
+	char *const *args;
+	const struct spawn_action *actions;
+	int nactions;
+};
+
+static
+int
+tryspawn(const char *path, const void *data)
+{
+	const struct spawnvp_data *sd = data;
+
+	return spawn(path, sd->args, sd->actions, sd->nactions);
+}
+
+/*
+ * OS/161 function: spawn a program on the search path, the way
+ * execvp runs one.
+ */
+pid_t
+spawnvp(const char *prog, char *const *args,
+	const struct spawn_action *actions, int nactions)
+{
+	struct spawnvp_data sd;
+
+	sd.args = args;
+	sd.actions = actions;
+	sd.nactions = nactions;
+	return pathsearch(prog, tryspawn, &sd);
+}
@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <futex.h>
+
+/*
+ * Mutexes and semaphores on top of futex_wait/futex_wake. See futex.h.
+ *
+ * The mutex is the usual three-state one: lockers go 0 -> 1 with one
+ * compare-and-swap, and only someone who finds it held marks it 2 and
+ * sleeps. An unlocker that finds 1 knows nobody is asleep and needn't
+ * call the kernel.
+ */
+
+/*
+ * Compare-and-swap: if *P is OLDVAL, set it to NEWVAL. Returns the
+ * value found, so it succeeded if that's OLDVAL.
+ *
+ * This is the same LL/SC sequence as the kernel's spinlock_data_cas,
+ * except that it retries if the SC fails, so the return value always
+ * tells the truth. LL/SC are MIPS32 instructions; see the comments in
+ * the kernel's <arch/mips/include/spinlock.h>.
+ */
+static
+int
+futex_cas(volatile int *p, int oldval, int newval)
+{
+	int x, y;
+
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 instructions */
+		".set volatile;"	/* avoid unwanted optimization */
+		".set noreorder;"	/* we fill the delay slots */
+		"1: ll %0, 0(%2);"	/*   x = *p */
+		"bne %0, %3, 2f;"	/*   if (x != oldval) give up */
+		"move %1, %4;"		/*   (delay slot) y = newval */
+		"sc %1, 0(%2);"		/*   *p = y; y = success? */
+		"beqz %1, 1b;"		/*   if (!y) try again */
+		"nop;"			/*   (delay slot) */
+		"2:"
+		".set pop"		/* restore assembler mode */
+		: "=&r" (x), "=&r" (y)
+		: "r" (p), "r" (oldval), "r" (newval)
+		: "memory");
+	return x;
+}
+
+/*
+ * Atomically add DELTA to *P; returns the old value.
+ */
+static
+int
+futex_add(volatile int *p, int delta)
+{
+	int old;
+
+	do {
+		old = *p;
+	} while (futex_cas(p, old, old + delta) != old);
+	return old;
+}
+
+/*
+ * Atomically set *P to VAL; returns the old value.
+ */
+static
+int
+futex_swap(volatile int *p, int val)
+{
+	int old;
+
+	do {
+		old = *p;
+	} while (futex_cas(p, old, val) != old);
+	return old;
+}
+
+////////////////////////////////////////////////////////////
+// mutex
+
+void
+fmutex_init(struct fmutex *fm)
+{
+	fm->fm_state = 0;
+}
+
+int
+fmutex_trylock(struct fmutex *fm)
+{
+	return futex_cas(&fm->fm_state, 0, 1) == 0 ? 0 : -1;
+}
+
+void
+fmutex_lock(struct fmutex *fm)
+{
+	int c;
+
+	c = futex_cas(&fm->fm_state, 0, 1);
+	if (c == 0) {
+		return;
+	}
+
+	/*
+	 * Held. Mark it contended and sleep until we're the one that
+	 * changes it from 0. We always leave it at 2, since we can't
+	 * know if anyone else is still waiting.
+	 */
+	if (c != 2) {
+		c = futex_swap(&fm->fm_state, 2);
+	}
+	while (c != 0) {
+		/* EAGAIN just means it changed; look again. */
+		(void)futex_wait(&fm->fm_state, 2);
+		c = futex_swap(&fm->fm_state, 2);
+	}
+}
+
+void
+fmutex_unlock(struct fmutex *fm)
+{
+	if (futex_add(&fm->fm_state, -1) != 1) {
+		fm->fm_state = 0;
+		futex_wake(&fm->fm_state, 1);
+	}
+}
+
+////////////////////////////////////////////////////////////
+// semaphore
+
+void
+fsem_init(struct fsem *fs, unsigned count)
+{
+	fs->fs_count = count;
+	fs->fs_waiters = 0;
+}
+
+int
+fsem_tryP(struct fsem *fs)
+{
+	int c;
+
+	c = fs->fs_count;
+	while (c > 0) {
+		if (futex_cas(&fs->fs_count, c, c - 1) == c) {
+			return 0;
+		}
+		c = fs->fs_count;
+	}
+	return -1;
+}
+
+void
+fsem_P(struct fsem *fs)
+{
+	while (fsem_tryP(fs) != 0) {
+		/*
+		 * Count ourselves as a waiter before sleeping. If a V
+		 * gets in between, the count won't be 0 any more and
+		 * futex_wait returns at once.
+		 */
+		futex_add(&fs->fs_waiters, 1);
+		(void)futex_wait(&fs->fs_count, 0);
+		futex_add(&fs->fs_waiters, -1);
+	}
+}
+
+void
+fsem_V(struct fsem *fs)
+{
+	futex_add(&fs->fs_count, 1);
+	if (fs->fs_waiters > 0) {
+		futex_wake(&fs->fs_count, 1);
+	}
+}
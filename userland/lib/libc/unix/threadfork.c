@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+
+/*
+ * Start a user-level thread running FUNC(ARG) on the stack STACK,
+ * which is STACKSIZE bytes long and must stay around until the thread
+ * is done. Returns the thread id for threadjoin. If FUNC returns, the
+ * thread exits with status 0.
+ *
+ * The system call just drops the new thread into user mode with one
+ * argument, so the function and its argument are stored at the top of
+ * the new stack and the thread starts in threadstart.
+ */
+
+struct threadstart {
+	void (*ts_func)(void *);
+	void *ts_arg;
+};
+
+static
+void
+threadstart(void *data)
+{
+	struct threadstart *ts = data;
+
+	ts->ts_func(ts->ts_arg);
+	threadexit(0);
+}
+
+int
+threadfork(void (*func)(void *), void *arg, void *stack, size_t stacksize)
+{
+	struct threadstart *ts;
+	uintptr_t top;
+
+	/* Leave some room to do something. */
+	if (stacksize < 1024) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* Stacks are doubleword aligned. */
+	top = ((uintptr_t)stack + stacksize) & ~(uintptr_t)7;
+	top -= (sizeof(*ts) + 7) & ~(uintptr_t)7;
+	ts = (struct threadstart *)top;
+	ts->ts_func = func;
+	ts->ts_arg = arg;
+
+	/* The calling convention gives a function 16 bytes above its sp. */
+	top -= 16;
+
+	return __threadfork(threadstart, ts, (void *)top);
+}
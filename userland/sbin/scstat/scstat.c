@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * scstat - print the kernel's system call statistics.
+ *
+ * Usage: scstat [callno]
+ *
+ * With no argument, prints a line for each system call that has been
+ * made: how many calls, how many failed, and the median, 99th
+ * percentile and longest time taken, in cpu cycles. Each time is the
+ * top of the log2 bucket it fell in, so it's good to within a factor
+ * of two. With a call number, prints the whole latency histogram for
+ * that call, and how its calls were spread over the cpus.
+ */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscallstat.h>
+#include <errno.h>
+#include <err.h>
+
+/* Upper end of bucket B, in cycles. */
+#define BUCKETTOP(b)	((unsigned long long)2 << (b))
+
+/*
+ * The bucket the PCT-th percentile of ST's latencies falls in, out of
+ * TOTAL calls that returned.
+ */
+static
+unsigned
+percentile(const struct syscallstat *st, unsigned long long total, unsigned pct)
+{
+	unsigned long long sofar;
+	unsigned i;
+
+	sofar = 0;
+	for (i=0; i<SYSCALLSTAT_NBUCKETS - 1; i++) {
+		sofar += st->ss_lat[i];
+		if (sofar * 100 >= total * pct) {
+			break;
+		}
+	}
+	return i;
+}
+
+static
+void
+summary(void)
+{
+	struct syscallstat st;
+	unsigned long long total;
+	unsigned i, max;
+	int n;
+
+	printf("%4s %10s %8s %12s %12s %12s\n",
+	       "call", "calls", "errors", "p50 <", "p99 <", "max <");
+	for (n=0; n<SYSCALLSTAT_NCALLS; n++) {
+		if (syscallstat(n, SYSCALLSTAT_ALLCPUS, &st)) {
+			err(1, "syscallstat %d", n);
+		}
+		if (st.ss_calls == 0) {
+			continue;
+		}
+		total = 0;
+		max = 0;
+		for (i=0; i<SYSCALLSTAT_NBUCKETS; i++) {
+			total += st.ss_lat[i];
+			if (st.ss_lat[i] != 0) {
+				max = i;
+			}
+		}
+		if (total == 0) {
+			printf("%4d %10llu %8llu\n",
+			       n, st.ss_calls, st.ss_errors);
+			continue;
+		}
+		printf("%4d %10llu %8llu %12llu %12llu %12llu\n",
+		       n, st.ss_calls, st.ss_errors,
+		       BUCKETTOP(percentile(&st, total, 50)),
+		       BUCKETTOP(percentile(&st, total, 99)),
+		       BUCKETTOP(max));
+	}
+}
+
+static
+void
+detail(int callno)
+{
+	struct syscallstat st;
+	unsigned i;
+	int cpu;
+
+	if (syscallstat(callno, SYSCALLSTAT_ALLCPUS, &st)) {
+		err(1, "syscallstat %d", callno);
+	}
+	printf("syscall %d: %llu calls, %llu errors\n",
+	       callno, st.ss_calls, st.ss_errors);
+	printf("%12s %10s\n", "cycles <", "calls");
+	for (i=0; i<SYSCALLSTAT_NBUCKETS; i++) {
+		if (st.ss_lat[i] == 0) {
+			continue;
+		}
+		if (i == SYSCALLSTAT_NBUCKETS - 1) {
+			printf("%12s %10u\n", "(more)", st.ss_lat[i]);
+		}
+		else {
+			printf("%12llu %10u\n", BUCKETTOP(i), st.ss_lat[i]);
+		}
+	}
+
+	/* There are as many cpus as it takes to get EINVAL. */
+	printf("%4s %10s %8s\n", "cpu", "calls", "errors");
+	for (cpu=0; syscallstat(callno, cpu, &st) == 0; cpu++) {
+		printf("%4d %10llu %8llu\n", cpu, st.ss_calls, st.ss_errors);
+	}
+	if (errno != EINVAL) {
+		err(1, "syscallstat %d cpu %d", callno, cpu);
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc == 1) {
+		summary();
+	}
+	else if (argc == 2) {
+		detail(atoi(argv[1]));
+	}
+	else {
+		errx(1, "Usage: scstat [callno]");
+	}
+	return 0;
+}
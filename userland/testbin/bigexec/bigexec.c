@@ -32,6 +32,9 @@
  *
  * Checks that argv passing works and is not restricted to an
  * unreasonably small size.
+ *
+ * Also reports how long each execv took, by argument size. The time
+ * just before the call is left in a file for the next stage to find.
  */
 
 #include <stdarg.h>
@@ -39,12 +42,14 @@
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <assert.h>
 #include <err.h>
 #include <test161/test161.h>
 
 #define _PATH_MYSELF "/testbin/bigexec"
+#define _PATH_STAMP "bigexec.time"
 
 ////////////////////////////////////////////////////////////
 // words
@@ -100,6 +105,70 @@ prepwords(void)
 	fill(word65500, sizeof(word65500));
 }
 
+////////////////////////////////////////////////////////////
+// timing
+
+/*
+ * Note the time, just before execv.
+ */
+static
+void
+stamp(void)
+{
+	time_t secs;
+	unsigned long nsecs;
+	int fd;
+
+	fd = open(_PATH_STAMP, O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		return;
+	}
+	__time(&secs, &nsecs);
+	write(fd, &secs, sizeof(secs));
+	write(fd, &nsecs, sizeof(nsecs));
+	close(fd);
+}
+
+/*
+ * Report the time since the last stamp, if there is one, along with
+ * how much space our arguments take.
+ */
+static
+void
+lapse(int argc, char *argv[])
+{
+	time_t secs, nowsecs;
+	unsigned long nsecs, nownsecs, usecs;
+	size_t size;
+	int fd, i;
+
+	__time(&nowsecs, &nownsecs);
+
+	fd = open(_PATH_STAMP, O_RDONLY);
+	if (fd < 0) {
+		return;
+	}
+	if (read(fd, &secs, sizeof(secs)) != sizeof(secs) ||
+	    read(fd, &nsecs, sizeof(nsecs)) != sizeof(nsecs)) {
+		close(fd);
+		return;
+	}
+	close(fd);
+	remove(_PATH_STAMP);
+
+	if (argv == NULL || argc <= 1) {
+		/* left over from some earlier run */
+		return;
+	}
+
+	size = (argc + 1) * sizeof(char *);
+	for (i=0; i<argc; i++) {
+		size += strlen(argv[i]) + 1;
+	}
+	usecs = (nowsecs - secs) * 1000000UL + nownsecs / 1000 - nsecs / 1000;
+	warnx("execv with %d args, %zu bytes: %lu us", argc, size, usecs);
+}
+
 ////////////////////////////////////////////////////////////
 // execing/checking
 
@@ -130,6 +199,7 @@ try(const char *first, ...)
 	nprintf("\n");
 	assert(num < 20);
 	args[num] = NULL;
+	stamp();
 	execv(_PATH_MYSELF, (char **)args);
 	err(1, "execv");
 }
@@ -149,6 +219,7 @@ trymany(int num, const char *word)
 			nprintf(".");
 	}
 	args[num+1] = NULL;
+	stamp();
 	execv(_PATH_MYSELF, (char **)args);
 	err(1, "execv");
 }
@@ -258,6 +329,8 @@ main(int argc, char *argv[])
 		err(1, "argc is negative!?");
 	}
 
+	lapse(argc, argv);
+
 	prepwords();
 	assert(strlen(word8) == 8);
 	assert(strlen(word4050) == 4050);
@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * copybench - copy_file_range check and benchmark.
+ *
+ * Usage: copybench [size]
+ *
+ * Makes a file of SIZE bytes (default DEFSIZE, which is about what
+ * people give bigfile) and copies it twice: once the way cp used to,
+ * with a read() and write() loop through a user buffer, and once with
+ * copy_file_range(), which keeps the data in the kernel. Prints the
+ * number of system calls and the time for each, and checks that both
+ * copies match the original.
+ */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <err.h>
+#include <test/bench.h>
+
+#define SRCFILE		"copybench.src"
+#define DSTFILE		"copybench.dst"
+#define DEFSIZE		(512*1024)
+#define BUFSIZE		1024
+#define COPYSIZE	(1024*1024)
+
+static char buf[BUFSIZE], buf2[BUFSIZE];
+
+static
+void
+report(const char *what, size_t size, unsigned ncalls, unsigned long usecs)
+{
+	printf("%-16s %8zu bytes: %6u calls in %8lu us: %9lu bytes/s\n",
+	       what, size, ncalls, usecs, persec(size, usecs));
+}
+
+static
+int
+openfile(const char *file, int flags)
+{
+	int fd;
+
+	fd = open(file, flags, 0664);
+	if (fd < 0) {
+		err(1, "%s", file);
+	}
+	return fd;
+}
+
+static
+void
+mkfile(size_t size)
+{
+	size_t done, i, n;
+	ssize_t r;
+	int fd;
+
+	fd = openfile(SRCFILE, O_WRONLY|O_CREAT|O_TRUNC);
+	for (done = 0; done < size; done += n) {
+		n = size - done < BUFSIZE ? size - done : BUFSIZE;
+		for (i=0; i<n; i++) {
+			buf[i] = 'a' + (done + i) % 23;
+		}
+		r = write(fd, buf, n);
+		if (r < 0) {
+			err(1, "%s: write", SRCFILE);
+		}
+		if ((size_t)r != n) {
+			errx(1, "%s: short write", SRCFILE);
+		}
+	}
+	close(fd);
+}
+
+static
+void
+rwcopy(size_t size)
+{
+	time_t s0;
+	unsigned long ns0, usecs;
+	unsigned ncalls;
+	ssize_t len, wr;
+	int infd, outfd;
+
+	infd = openfile(SRCFILE, O_RDONLY);
+	outfd = openfile(DSTFILE, O_WRONLY|O_CREAT|O_TRUNC);
+	ncalls = 0;
+	__time(&s0, &ns0);
+	while ((len = read(infd, buf, sizeof(buf))) > 0) {
+		wr = write(outfd, buf, len);
+		if (wr < 0) {
+			err(1, "%s: write", DSTFILE);
+		}
+		if (wr != len) {
+			errx(1, "%s: short write", DSTFILE);
+		}
+		ncalls += 2;
+	}
+	if (len < 0) {
+		err(1, "%s: read", SRCFILE);
+	}
+	ncalls++;
+	usecs = elapsed(s0, ns0);
+	close(infd);
+	close(outfd);
+	report("read/write", size, ncalls, usecs);
+}
+
+static
+void
+kcopy(size_t size)
+{
+	time_t s0;
+	unsigned long ns0, usecs;
+	unsigned ncalls;
+	ssize_t len;
+	int infd, outfd;
+
+	infd = openfile(SRCFILE, O_RDONLY);
+	outfd = openfile(DSTFILE, O_WRONLY|O_CREAT|O_TRUNC);
+	ncalls = 0;
+	__time(&s0, &ns0);
+	do {
+		len = copy_file_range(infd, outfd, COPYSIZE);
+		ncalls++;
+	} while (len > 0);
+	if (len < 0) {
+		err(1, "copy_file_range");
+	}
+	usecs = elapsed(s0, ns0);
+	close(infd);
+	close(outfd);
+	report("copy_file_range", size, ncalls, usecs);
+}
+
+static
+void
+compare(size_t size)
+{
+	size_t done;
+	ssize_t r1, r2;
+	int fd1, fd2;
+
+	fd1 = openfile(SRCFILE, O_RDONLY);
+	fd2 = openfile(DSTFILE, O_RDONLY);
+	for (done = 0; ; done += r1) {
+		r1 = read(fd1, buf, sizeof(buf));
+		r2 = read(fd2, buf2, sizeof(buf2));
+		if (r1 < 0 || r2 < 0) {
+			err(1, "read");
+		}
+		if (r1 != r2 || memcmp(buf, buf2, r1) != 0) {
+			errx(1, "Copy differs near offset %zu", done);
+		}
+		if (r1 == 0) {
+			break;
+		}
+	}
+	if (done != size) {
+		errx(1, "Copy is %zu bytes; expected %zu", done, size);
+	}
+	close(fd1);
+	close(fd2);
+}
+
+int
+main(int argc, char *argv[])
+{
+	size_t size;
+
+	if (argc > 2) {
+		errx(1, "Usage: copybench [size]");
+	}
+	size = argc == 2 ? (size_t)atoi(argv[1]) : DEFSIZE;
+
+	mkfile(size);
+
+	rwcopy(size);
+	compare(size);
+
+	kcopy(size);
+	compare(size);
+
+	remove(SRCFILE);
+	remove(DSTFILE);
+	printf("copybench: passed\n");
+	return 0;
+}
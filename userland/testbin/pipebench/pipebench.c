@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * pipebench - pipe check and benchmark.
+ *
+ * Usage: pipebench
+ *
+ * First checks that bytes come out of a pipe in the order they went
+ * in, whatever size pieces they're written and read in (small writes
+ * go through the pipe's ring and large ones are handed over a page at
+ * a time, so the sizes are picked to mix the two); that the reader
+ * sees end of file once the writer closes; that writing fails with
+ * EPIPE once the reader closes; and that poll reports each of these.
+ *
+ * Then, for each chunk size from 1 byte to 64K, times a child process
+ * writing to the parent through a pipe in chunks of that size while
+ * the parent reads it in the same size chunks.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <err.h>
+#include <test/bench.h>
+
+#define BUFSIZE		65536
+#define CHECKSIZE	(96*1024)
+#define READSIZE	777	/* Not a divisor of anything */
+#define MINTOTAL	(16*1024)
+#define MAXTOTAL	(1024*1024)
+
+static char buf[BUFSIZE];
+
+static const unsigned writesizes[] = {
+	1, 100, 513, 4096, 5000, 9000, 1023, 20000, 3,
+};
+#define NWRITESIZES (sizeof(writesizes) / sizeof(writesizes[0]))
+
+static const unsigned chunks[] = {
+	1, 16, 256, 1024, 4096, 16384, 65536,
+};
+#define NCHUNKS (sizeof(chunks) / sizeof(chunks[0]))
+
+static
+void
+dopipe(int fds[2])
+{
+	if (pipe(fds) < 0) {
+		err(1, "pipe");
+	}
+}
+
+static
+void
+dowait(pid_t pid)
+{
+	int status;
+
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		errx(1, "child failed");
+	}
+}
+
+/*
+ * Poll one descriptor without waiting and check what comes back.
+ */
+static
+void
+pollcheck(int fd, int events, int revents, const char *what)
+{
+	struct pollfd pfd;
+
+	pfd.fd = fd;
+	pfd.events = events;
+	pfd.revents = 0;
+	if (poll(&pfd, 1, 0) < 0) {
+		err(1, "poll");
+	}
+	if (pfd.revents != revents) {
+		errx(1, "%s: revents 0x%x, expected 0x%x",
+		     what, pfd.revents, revents);
+	}
+}
+
+static
+void
+checkorder(void)
+{
+	int fds[2];
+	pid_t pid;
+	unsigned pos, i, j, n;
+	ssize_t r;
+
+	dopipe(fds);
+
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		close(fds[0]);
+		pos = 0;
+		for (i=0; pos < CHECKSIZE; i = (i + 1) % NWRITESIZES) {
+			n = writesizes[i];
+			if (n > CHECKSIZE - pos) {
+				n = CHECKSIZE - pos;
+			}
+			for (j=0; j<n; j++) {
+				buf[j] = (pos + j) % 251;
+			}
+			r = write(fds[1], buf, n);
+			if (r != (ssize_t)n) {
+				err(1, "write of %u returned %d", n, (int)r);
+			}
+			pos += n;
+		}
+		_exit(0);
+	}
+
+	close(fds[1]);
+	pos = 0;
+	while (1) {
+		r = read(fds[0], buf, READSIZE);
+		if (r < 0) {
+			err(1, "read");
+		}
+		if (r == 0) {
+			break;
+		}
+		for (i=0; i<(unsigned)r; i++) {
+			if ((unsigned char)buf[i] != (pos + i) % 251) {
+				errx(1, "byte %u is wrong", pos + i);
+			}
+		}
+		pos += r;
+	}
+	if (pos != CHECKSIZE) {
+		errx(1, "end of file after %u of %u bytes", pos, CHECKSIZE);
+	}
+	dowait(pid);
+	close(fds[0]);
+	printf("order:  %u bytes came through in order\n", pos);
+}
+
+static
+void
+checkends(void)
+{
+	int fds[2];
+	char ch;
+
+	dopipe(fds);
+
+	pollcheck(fds[0], POLLIN, 0, "empty read end");
+	pollcheck(fds[1], POLLOUT, POLLOUT, "empty write end");
+	if (write(fds[1], "x", 1) != 1) {
+		err(1, "write");
+	}
+	pollcheck(fds[0], POLLIN, POLLIN, "read end with data");
+
+	/* Data written before the close is still there to read */
+	close(fds[1]);
+	pollcheck(fds[0], POLLIN, POLLIN, "read end with data, closed");
+	if (read(fds[0], &ch, 1) != 1 || ch != 'x') {
+		errx(1, "lost data written before close");
+	}
+	pollcheck(fds[0], POLLIN, POLLIN|POLLHUP, "read end at eof");
+	if (read(fds[0], &ch, 1) != 0) {
+		errx(1, "no end of file after close");
+	}
+	close(fds[0]);
+
+	dopipe(fds);
+	close(fds[0]);
+	pollcheck(fds[1], POLLOUT, POLLERR, "write end, reader gone");
+	if (write(fds[1], "x", 1) >= 0 || errno != EPIPE) {
+		errx(1, "write with no reader didn't fail with EPIPE");
+	}
+	close(fds[1]);
+
+	printf("ends:   eof, EPIPE and poll ok\n");
+}
+
+/*
+ * Move TOTAL bytes from a child to us in CHUNK byte pieces.
+ */
+static
+void
+bench(unsigned chunk)
+{
+	int fds[2];
+	time_t s0;
+	unsigned long ns0, usecs;
+	unsigned total, pos;
+	pid_t pid;
+	ssize_t r;
+
+	total = chunk * 256;
+	if (total < MINTOTAL) {
+		total = MINTOTAL;
+	}
+	if (total > MAXTOTAL) {
+		total = MAXTOTAL;
+	}
+
+	dopipe(fds);
+	__time(&s0, &ns0);
+
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		close(fds[0]);
+		for (pos=0; pos<total; pos += chunk) {
+			if (write(fds[1], buf, chunk) != (ssize_t)chunk) {
+				err(1, "write");
+			}
+		}
+		_exit(0);
+	}
+
+	close(fds[1]);
+	pos = 0;
+	while (pos < total) {
+		r = read(fds[0], buf, chunk);
+		if (r <= 0) {
+			err(1, "read after %u of %u bytes", pos, total);
+		}
+		pos += r;
+	}
+	usecs = elapsed(s0, ns0);
+	dowait(pid);
+	close(fds[0]);
+
+	printf("%5u byte chunks: %7u bytes in %8lu us, %6lu KB/s\n",
+	       chunk, total, usecs, persec(total / 1024, usecs));
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned i;
+
+	(void)argv;
+	if (argc != 1) {
+		errx(1, "Usage: pipebench");
+	}
+
+	checkorder();
+	checkends();
+	for (i=0; i<NCHUNKS; i++) {
+		bench(chunks[i]);
+	}
+
+	printf("pipebench: passed\n");
+	return 0;
+}
@@ -0,0 +1,398 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * polltest - poll/select check and benchmark.
+ *
+ * Usage: polltest [-i]
+ *
+ * Checks that a regular file is always ready, that closed and negative
+ * descriptors are reported the way they should be, that a timeout
+ * expires when nothing happens, and that a poller sleeping on a
+ * semfs semaphore (which blocks on read until someone writes it)
+ * is woken when another process writes to it. Then times NROUNDS
+ * round trips between two processes that each wait in poll (and then
+ * select) before every read.
+ *
+ * With -i, waits for console input instead, printing a dot each
+ * second nothing is typed, until q is typed.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <err.h>
+#include <test/bench.h>
+
+#define TESTFILE	"polltest.dat"
+#define SEM_A		"sem:polltest.a"
+#define SEM_B		"sem:polltest.b"
+#define TIMEOUTMS	200
+#define SPINUSECS	100000
+#define NROUNDS		500
+
+static
+int
+semopen(const char *name)
+{
+	int fd;
+
+	fd = open(name, O_RDWR|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s", name);
+	}
+	return fd;
+}
+
+/* V: make the semaphore readable. */
+static
+void
+semup(int fd)
+{
+	if (write(fd, "x", 1) != 1) {
+		err(1, "semaphore write");
+	}
+}
+
+/* P: must not block, since poll said it was readable. */
+static
+void
+semdown(int fd)
+{
+	char ch;
+
+	if (read(fd, &ch, 1) != 1) {
+		err(1, "semaphore read");
+	}
+}
+
+/*
+ * Poll one descriptor and check the outcome.
+ */
+static
+void
+pollone(int fd, int events, int timeout, int expect, int revents)
+{
+	struct pollfd pfd;
+	int r;
+
+	pfd.fd = fd;
+	pfd.events = events;
+	pfd.revents = -1;
+	r = poll(&pfd, 1, timeout);
+	if (r < 0) {
+		err(1, "poll");
+	}
+	if (r != expect) {
+		errx(1, "poll of fd %d for 0x%x returned %d, expected %d",
+		     fd, events, r, expect);
+	}
+	if (pfd.revents != revents) {
+		errx(1, "poll of fd %d for 0x%x gave revents 0x%x, "
+		     "expected 0x%x", fd, events, pfd.revents, revents);
+	}
+}
+
+static
+void
+checkfile(void)
+{
+	struct pollfd pfd[3];
+	fd_set rfds, wfds;
+	struct timeval tv;
+	int fd, r;
+
+	fd = open(TESTFILE, O_RDWR|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s", TESTFILE);
+	}
+
+	pollone(fd, POLLIN|POLLOUT, INFTIM, 1, POLLIN|POLLOUT);
+	pollone(fd, POLLIN, 0, 1, POLLIN);
+	pollone(STDOUT_FILENO, POLLOUT, 0, 1, POLLOUT);
+
+	/* Negative fds are skipped; closed ones get POLLNVAL. */
+	pfd[0].fd = -1;
+	pfd[0].events = POLLIN;
+	pfd[1].fd = fd + 10;
+	pfd[1].events = POLLIN;
+	pfd[2].fd = fd;
+	pfd[2].events = POLLOUT;
+	r = poll(pfd, 3, INFTIM);
+	if (r != 2 || pfd[0].revents != 0 || pfd[1].revents != POLLNVAL ||
+	    pfd[2].revents != POLLOUT) {
+		errx(1, "poll with bad fds: %d, revents 0x%x 0x%x 0x%x",
+		     r, pfd[0].revents, pfd[1].revents, pfd[2].revents);
+	}
+
+	FD_ZERO(&rfds);
+	FD_ZERO(&wfds);
+	FD_SET(fd, &rfds);
+	FD_SET(fd, &wfds);
+	tv.tv_sec = 0;
+	tv.tv_usec = 0;
+	r = select(fd + 1, &rfds, &wfds, NULL, &tv);
+	if (r != 2 || !FD_ISSET(fd, &rfds) || !FD_ISSET(fd, &wfds)) {
+		errx(1, "select of a file returned %d", r);
+	}
+
+	FD_ZERO(&rfds);
+	FD_SET(fd + 10, &rfds);
+	r = select(fd + 11, &rfds, NULL, NULL, &tv);
+	if (r >= 0 || errno != EBADF) {
+		errx(1, "select of a closed fd didn't fail with EBADF");
+	}
+
+	close(fd);
+	remove(TESTFILE);
+}
+
+static
+void
+checktimeout(void)
+{
+	time_t s0;
+	unsigned long ns0, usecs;
+	fd_set rfds;
+	struct timeval tv;
+	int fd, r;
+
+	fd = semopen(SEM_A);
+
+	pollone(fd, POLLOUT, 0, 1, POLLOUT);
+	pollone(fd, POLLIN, 0, 0, 0);
+
+	__time(&s0, &ns0);
+	pollone(fd, POLLIN, TIMEOUTMS, 0, 0);
+	usecs = elapsed(s0, ns0);
+	/* The timer counts clock ticks; the first may come at once. */
+	if (usecs < (TIMEOUTMS - 10) * 1000UL) {
+		errx(1, "%d ms poll timeout expired after %lu us",
+		     TIMEOUTMS, usecs);
+	}
+	printf("poll:   %d ms timeout took %lu us\n", TIMEOUTMS, usecs);
+
+	FD_ZERO(&rfds);
+	FD_SET(fd, &rfds);
+	tv.tv_sec = 0;
+	tv.tv_usec = TIMEOUTMS * 1000;
+	__time(&s0, &ns0);
+	r = select(fd + 1, &rfds, NULL, NULL, &tv);
+	usecs = elapsed(s0, ns0);
+	if (r != 0 || FD_ISSET(fd, &rfds)) {
+		errx(1, "select of an empty semaphore returned %d", r);
+	}
+	if (usecs < (TIMEOUTMS - 10) * 1000UL) {
+		errx(1, "%d ms select timeout expired after %lu us",
+		     TIMEOUTMS, usecs);
+	}
+	printf("select: %d ms timeout took %lu us\n", TIMEOUTMS, usecs);
+
+	close(fd);
+	remove(SEM_A);
+}
+
+static
+void
+dowait(pid_t pid)
+{
+	int status;
+
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		errx(1, "child failed");
+	}
+}
+
+/*
+ * Sleep in poll until another process writes the semaphore.
+ */
+static
+void
+checkwakeup(void)
+{
+	time_t s0;
+	unsigned long ns0, usecs;
+	pid_t pid;
+	int fd;
+
+	fd = semopen(SEM_A);
+
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		__time(&s0, &ns0);
+		while (elapsed(s0, ns0) < SPINUSECS) {
+			/* spin */
+		}
+		semup(fd);
+		_exit(0);
+	}
+
+	__time(&s0, &ns0);
+	pollone(fd, POLLIN, INFTIM, 1, POLLIN);
+	usecs = elapsed(s0, ns0);
+	semdown(fd);
+	dowait(pid);
+	printf("poll:   woken after %lu us by a write %d us later\n",
+	       usecs, SPINUSECS);
+
+	close(fd);
+	remove(SEM_A);
+}
+
+/*
+ * Wait for FD to be readable, with poll or select.
+ */
+static
+void
+waitread(int fd, int useselect)
+{
+	fd_set rfds;
+
+	if (useselect) {
+		FD_ZERO(&rfds);
+		FD_SET(fd, &rfds);
+		if (select(fd + 1, &rfds, NULL, NULL, NULL) != 1) {
+			err(1, "select");
+		}
+	}
+	else {
+		pollone(fd, POLLIN, INFTIM, 1, POLLIN);
+	}
+}
+
+/*
+ * Two processes take turns: each waits for its semaphore to be
+ * readable, takes it, and posts the other's.
+ */
+static
+void
+pingpong(int useselect)
+{
+	time_t s0;
+	unsigned long ns0, usecs;
+	pid_t pid;
+	int a, b, i;
+
+	a = semopen(SEM_A);
+	b = semopen(SEM_B);
+
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		for (i=0; i<NROUNDS; i++) {
+			waitread(b, useselect);
+			semdown(b);
+			semup(a);
+		}
+		_exit(0);
+	}
+
+	__time(&s0, &ns0);
+	for (i=0; i<NROUNDS; i++) {
+		semup(b);
+		waitread(a, useselect);
+		semdown(a);
+	}
+	usecs = elapsed(s0, ns0);
+	dowait(pid);
+
+	printf("%-7s %d round trips in %lu us: %lu us each\n",
+	       useselect ? "select:" : "poll:", NROUNDS, usecs,
+	       usecs / NROUNDS);
+
+	close(a);
+	close(b);
+	remove(SEM_A);
+	remove(SEM_B);
+}
+
+static
+void
+interactive(void)
+{
+	struct pollfd pfd;
+	char ch;
+	int r;
+
+	printf("Type something; q to quit.\n");
+	pfd.fd = STDIN_FILENO;
+	pfd.events = POLLIN;
+	while (1) {
+		r = poll(&pfd, 1, 1000);
+		if (r < 0) {
+			err(1, "poll");
+		}
+		if (r == 0) {
+			putchar('.');
+			continue;
+		}
+		if (read(STDIN_FILENO, &ch, 1) != 1) {
+			err(1, "read");
+		}
+		if (ch == 'q') {
+			break;
+		}
+		printf("[%c]", ch);
+	}
+	printf("\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc == 2 && !strcmp(argv[1], "-i")) {
+		interactive();
+		return 0;
+	}
+	if (argc != 1) {
+		errx(1, "Usage: polltest [-i]");
+	}
+
+	checkfile();
+	checktimeout();
+	checkwakeup();
+	pingpong(0);
+	pingpong(1);
+
+	printf("polltest: passed\n");
+	return 0;
+}
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * preadbench - pread/pwrite check and benchmark.
+ *
+ * Usage: preadbench [file]
+ *
+ * Fills a file of NBLOCKS blocks with pwrite(), each block written at
+ * its own offset and stamped with its number, and checks that the
+ * seek position never moved. Then forks 1, 2, 4, ... MAXREADERS
+ * children, which all pread() the whole file through the one shared
+ * descriptor, each starting at a different block, checking each block
+ * as it goes. Prints the time for each number of readers; since
+ * pread doesn't touch the shared offset and SFS lets reads of one
+ * file run at once, more readers should get more done in the same
+ * time on a multiprocessor.
+ *
+ * Also checks that pread rejects negative offsets.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <err.h>
+#include <test/bench.h>
+
+#define DEFFILE		"preadbench.dat"
+#define BLOCKSIZE	4096
+#define NBLOCKS		64
+#define PASSES		4
+#define MAXREADERS	8
+
+static unsigned buf[BLOCKSIZE / sizeof(unsigned)];
+
+static
+void
+mkblock(unsigned blk)
+{
+	unsigned i;
+
+	for (i=0; i<BLOCKSIZE / sizeof(unsigned); i++) {
+		buf[i] = blk * 65536 + i;
+	}
+}
+
+static
+int
+chkblock(unsigned blk)
+{
+	unsigned i;
+
+	for (i=0; i<BLOCKSIZE / sizeof(unsigned); i++) {
+		if (buf[i] != blk * 65536 + i) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static
+void
+chkpos(int fd, const char *what)
+{
+	off_t pos;
+
+	pos = lseek(fd, 0, SEEK_CUR);
+	if (pos != 0) {
+		errx(1, "%s moved the seek position to %lld",
+		     what, (long long)pos);
+	}
+}
+
+static
+void
+fill(int fd)
+{
+	unsigned blk;
+	ssize_t r;
+
+	/* Backwards, so each one really does go where it's told */
+	for (blk = NBLOCKS; blk-- > 0; ) {
+		mkblock(blk);
+		r = pwrite(fd, buf, BLOCKSIZE, (off_t)blk * BLOCKSIZE);
+		if (r < 0) {
+			err(1, "pwrite");
+		}
+		if (r != BLOCKSIZE) {
+			errx(1, "pwrite: short count (%zd)", r);
+		}
+	}
+	chkpos(fd, "pwrite");
+}
+
+static
+void
+reader(int fd, unsigned who)
+{
+	unsigned pass, i, blk;
+	ssize_t r;
+
+	for (pass=0; pass<PASSES; pass++) {
+		for (i=0; i<NBLOCKS; i++) {
+			blk = (who + i) % NBLOCKS;
+			r = pread(fd, buf, BLOCKSIZE, (off_t)blk * BLOCKSIZE);
+			if (r < 0) {
+				err(1, "reader %u: pread", who);
+			}
+			if (r != BLOCKSIZE) {
+				errx(1, "reader %u: short read (%zd)", who, r);
+			}
+			if (chkblock(blk)) {
+				errx(1, "reader %u: block %u is wrong",
+				     who, blk);
+			}
+		}
+	}
+	_exit(0);
+}
+
+static
+void
+bench(int fd, unsigned nreaders)
+{
+	pid_t pids[MAXREADERS];
+	time_t s0;
+	unsigned long ns0, usecs;
+	unsigned long long bytes;
+	unsigned i;
+	int status, failed;
+
+	__time(&s0, &ns0);
+	for (i=0; i<nreaders; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			err(1, "fork");
+		}
+		if (pids[i] == 0) {
+			reader(fd, i * (NBLOCKS / MAXREADERS));
+		}
+	}
+
+	failed = 0;
+	for (i=0; i<nreaders; i++) {
+		if (waitpid(pids[i], &status, 0) < 0) {
+			err(1, "waitpid");
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			warnx("reader %u failed", i);
+			failed = 1;
+		}
+	}
+	usecs = elapsed(s0, ns0);
+	if (failed) {
+		errx(1, "FAILED");
+	}
+	chkpos(fd, "pread");
+
+	bytes = (unsigned long long)nreaders * PASSES * NBLOCKS * BLOCKSIZE;
+	printf("%u reader(s): %8llu bytes in %8lu us: %9lu bytes/s\n",
+	       nreaders, bytes, usecs, persec(bytes, usecs));
+}
+
+static
+void
+badoffset(int fd)
+{
+	if (pread(fd, buf, 1, -1) >= 0 || errno != EINVAL) {
+		errx(1, "pread at offset -1 didn't fail with EINVAL");
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *file;
+	unsigned n;
+	int fd;
+
+	if (argc > 2) {
+		errx(1, "Usage: preadbench [file]");
+	}
+	file = argc == 2 ? argv[1] : DEFFILE;
+
+	fd = open(file, O_RDWR|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s", file);
+	}
+
+	fill(fd);
+	badoffset(fd);
+	for (n = 1; n <= MAXREADERS; n *= 2) {
+		bench(fd, n);
+	}
+
+	close(fd);
+	remove(file);
+	printf("preadbench: passed\n");
+	return 0;
+}
@@ -0,0 +1,407 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * ringbench - ring_enter check and benchmark.
+ *
+ * Usage: ringbench [file]
+ *
+ * First checks that each kind of request does what the plain call
+ * would: opens, writes, fsyncs and closes a file through the ring,
+ * reads it back, and checks that a bad request fails by itself.
+ *
+ * Then times the same work three ways: one system call per
+ * operation, BATCH operations per ring_enter, and BATCH operations
+ * per ring_enter with RING_ENTER_ASYNC while the program does some
+ * computing of its own on the previous batch. The work is NOPS empty
+ * calls (getpid against RING_OP_NOP), then writing and reading back
+ * NRECS records of RECSIZE bytes.
+ */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <err.h>
+#include <ring.h>
+#include <test/bench.h>
+
+#define DEFFILE		"ringbench.dat"
+#define ENTRIES		64
+#define BATCH		32
+#define NOPS		4096
+#define NRECS		2048
+#define RECSIZE		64
+#define WORK		200	/* Compute per record, in rounds */
+
+static struct ring_sqe sq[ENTRIES];
+static struct ring_cqe cq[ENTRIES];
+static struct ring ring;
+
+static char recs[NRECS][RECSIZE];
+static char buf[NRECS][RECSIZE];
+
+static
+void
+report(const char *what, const char *how, unsigned n, unsigned ncalls,
+       unsigned long usecs)
+{
+	printf("%-6s %-7s %5u ops, %5u calls in %8lu us: %7lu ops/s\n",
+	       what, how, n, ncalls, usecs, persec(n, usecs));
+}
+
+static
+void
+ring_init(void)
+{
+	ring.r_entries = ENTRIES;
+	ring.r_sqhead = ring.r_sqtail = 0;
+	ring.r_cqhead = ring.r_cqtail = 0;
+	ring.r_sq = sq;
+	ring.r_cq = cq;
+}
+
+/*
+ * Queue a request. There must be room.
+ */
+static
+struct ring_sqe *
+queue(int op, int fd, void *p, size_t len, off_t off, unsigned data)
+{
+	struct ring_sqe *sqe;
+
+	if (ring.r_sqtail - ring.r_sqhead >= ENTRIES) {
+		errx(1, "Submission queue full");
+	}
+	sqe = &sq[ring.r_sqtail % ENTRIES];
+	sqe->sqe_op = op;
+	sqe->sqe_fd = fd;
+	sqe->sqe_buf = p;
+	sqe->sqe_len = len;
+	sqe->sqe_off = off;
+	sqe->sqe_flags = 0;
+	sqe->sqe_data = data;
+	ring.r_sqtail++;
+	return sqe;
+}
+
+/*
+ * Submit everything queued, with FLAGS, and wait for WAIT completions.
+ */
+static
+void
+submit(int flags, unsigned wait)
+{
+	unsigned n;
+	int r;
+
+	n = ring.r_sqtail - ring.r_sqhead;
+	r = ring_enter(&ring, n, wait, flags);
+	if (r < 0) {
+		err(1, "ring_enter");
+	}
+	if ((unsigned)r != n) {
+		errx(1, "ring_enter took %d of %u", r, n);
+	}
+}
+
+/*
+ * Take the next completion, waiting if need be, and check it.
+ */
+static
+int
+reap(unsigned data, int expect)
+{
+	struct ring_cqe *cqe;
+
+	if (ring.r_cqhead == ring.r_cqtail) {
+		if (ring_enter(&ring, 0, 1, 0) < 0) {
+			err(1, "ring_enter");
+		}
+		if (ring.r_cqhead == ring.r_cqtail) {
+			errx(1, "No completion for request %u", data);
+		}
+	}
+	cqe = &cq[ring.r_cqhead % ENTRIES];
+	ring.r_cqhead++;
+	if (cqe->cqe_data != data) {
+		errx(1, "Completion for %u where %u expected",
+		     cqe->cqe_data, data);
+	}
+	if (expect != -1 && cqe->cqe_res != expect) {
+		errx(1, "Request %u: result %d, expected %d",
+		     data, cqe->cqe_res, expect);
+	}
+	return cqe->cqe_res;
+}
+
+static
+void
+mkrecs(void)
+{
+	unsigned i, j;
+
+	for (i=0; i<NRECS; i++) {
+		for (j=0; j<RECSIZE; j++) {
+			recs[i][j] = 'a' + (i + j) % 26;
+		}
+	}
+}
+
+/* Something to do while the I/O happens. */
+static
+unsigned
+compute(const char *p)
+{
+	unsigned s = 0;
+	unsigned i, j;
+
+	for (i=0; i<WORK; i++) {
+		for (j=0; j<RECSIZE; j++) {
+			s = s * 31 + (unsigned char)p[j];
+		}
+	}
+	return s;
+}
+
+/*
+ * Each kind of request, once.
+ */
+static
+void
+check(const char *file)
+{
+	char rec[RECSIZE];
+	int fd, i;
+
+	ring_init();
+
+	queue(RING_OP_OPEN, -1, (void *)file, 0, 0, 1)->sqe_flags =
+		O_RDWR|O_CREAT|O_TRUNC;
+	submit(0, 1);
+	fd = reap(1, -1);
+	if (fd < 0) {
+		errno = -fd;
+		err(1, "%s: open through ring", file);
+	}
+
+	queue(RING_OP_WRITE, fd, recs[0], RECSIZE, -1, 2);
+	queue(RING_OP_WRITE, fd, recs[1], RECSIZE, RECSIZE, 3);
+	queue(RING_OP_FSYNC, fd, NULL, 0, 0, 4);
+	queue(RING_OP_NOP, -1, NULL, 0, 0, 5);
+	queue(99, fd, NULL, 0, 0, 6);
+	queue(RING_OP_READ, fd, rec, RECSIZE, 0, 7);
+	queue(RING_OP_CLOSE, fd, NULL, 0, 0, 8);
+	queue(RING_OP_CLOSE, fd, NULL, 0, 0, 9);
+	submit(0, 8);
+	reap(2, RECSIZE);
+	reap(3, RECSIZE);
+	reap(4, 0);
+	reap(5, 0);
+	reap(6, -EINVAL);
+	reap(7, RECSIZE);
+	reap(8, 0);
+	reap(9, -EBADF);
+	if (memcmp(rec, recs[0], RECSIZE) != 0) {
+		errx(1, "Read back the wrong data");
+	}
+
+	/* Async, and more than fits at once */
+	for (i=0; i<ENTRIES; i++) {
+		queue(RING_OP_NOP, -1, NULL, 0, 0, 100 + i);
+	}
+	if (ring_enter(&ring, ENTRIES, 0, RING_ENTER_ASYNC) != ENTRIES) {
+		errx(1, "Async ring_enter of a full ring didn't take it all");
+	}
+	queue(RING_OP_NOP, -1, NULL, 0, 0, 1000);
+	if (ring_enter(&ring, 1, 0, 0) != 0) {
+		errx(1, "ring_enter took a request it had no room for");
+	}
+	for (i=0; i<ENTRIES; i++) {
+		reap(100 + i, 0);
+	}
+	submit(0, 1);
+	reap(1000, 0);
+
+	if (ring_enter(&ring, 1, 0, 0x100) >= 0 || errno != EINVAL) {
+		errx(1, "ring_enter with bad flags didn't fail with EINVAL");
+	}
+}
+
+static
+void
+nops(void)
+{
+	time_t s0;
+	unsigned long ns0;
+	unsigned i, j;
+
+	__time(&s0, &ns0);
+	for (i=0; i<NOPS; i++) {
+		getpid();
+	}
+	report("nop", "calls", NOPS, NOPS, elapsed(s0, ns0));
+
+	ring_init();
+	__time(&s0, &ns0);
+	for (i=0; i<NOPS; i+=BATCH) {
+		for (j=0; j<BATCH; j++) {
+			queue(RING_OP_NOP, -1, NULL, 0, 0, i + j);
+		}
+		submit(0, BATCH);
+		for (j=0; j<BATCH; j++) {
+			reap(i + j, 0);
+		}
+	}
+	report("nop", "ring", NOPS, NOPS / BATCH, elapsed(s0, ns0));
+}
+
+static
+void
+checkbuf(void)
+{
+	if (memcmp(buf, recs, sizeof(recs)) != 0) {
+		errx(1, "Read back the wrong data");
+	}
+	memset(buf, 0, sizeof(buf));
+}
+
+/*
+ * Write and read back the records, BATCH per ring_enter, computing on
+ * each batch of records read; with ASYNC, the reads of one batch go
+ * on while the previous one is computed on.
+ */
+static
+void
+ringio(int fd, int flags, const char *how)
+{
+	time_t s0;
+	unsigned long ns0;
+	unsigned i, j, pending;
+	volatile unsigned sum;
+
+	ring_init();
+	__time(&s0, &ns0);
+	for (i=0; i<NRECS; i+=BATCH) {
+		for (j=0; j<BATCH; j++) {
+			queue(RING_OP_WRITE, fd, recs[i+j], RECSIZE,
+			      (off_t)(i+j) * RECSIZE, i + j);
+		}
+		submit(flags, flags ? 0 : BATCH);
+		for (j=0; j<BATCH; j++) {
+			reap(i + j, RECSIZE);
+		}
+	}
+	report("write", how, NRECS, NRECS / BATCH, elapsed(s0, ns0));
+
+	sum = 0;
+	pending = 0;
+	__time(&s0, &ns0);
+	for (i=0; i<=NRECS; i+=BATCH) {
+		if (i < NRECS) {
+			for (j=0; j<BATCH; j++) {
+				queue(RING_OP_READ, fd, buf[i+j], RECSIZE,
+				      (off_t)(i+j) * RECSIZE, i + j);
+			}
+			submit(flags, flags ? 0 : BATCH);
+		}
+		if (i > 0) {
+			/* Finish the previous batch while this one runs. */
+			for (j=0; j<BATCH; j++) {
+				reap(pending + j, RECSIZE);
+				sum += compute(buf[pending + j]);
+			}
+		}
+		pending = i;
+	}
+	report("read", how, NRECS, NRECS / BATCH, elapsed(s0, ns0));
+	checkbuf();
+}
+
+static
+void
+rw(const char *file)
+{
+	time_t s0;
+	unsigned long ns0;
+	unsigned i;
+	volatile unsigned sum;
+	int fd;
+
+	fd = open(file, O_RDWR|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s", file);
+	}
+
+	__time(&s0, &ns0);
+	for (i=0; i<NRECS; i++) {
+		if (pwrite(fd, recs[i], RECSIZE, (off_t)i * RECSIZE) != RECSIZE) {
+			err(1, "pwrite");
+		}
+	}
+	report("write", "calls", NRECS, NRECS, elapsed(s0, ns0));
+
+	sum = 0;
+	__time(&s0, &ns0);
+	for (i=0; i<NRECS; i++) {
+		if (pread(fd, buf[i], RECSIZE, (off_t)i * RECSIZE) != RECSIZE) {
+			err(1, "pread");
+		}
+		sum += compute(buf[i]);
+	}
+	report("read", "calls", NRECS, NRECS, elapsed(s0, ns0));
+	checkbuf();
+
+	ringio(fd, 0, "ring");
+	ringio(fd, RING_ENTER_ASYNC, "async");
+
+	close(fd);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *file;
+
+	if (argc > 2) {
+		errx(1, "Usage: ringbench [file]");
+	}
+	file = argc == 2 ? argv[1] : DEFFILE;
+
+	mkrecs();
+	check(file);
+	nops();
+	rw(file);
+
+	remove(file);
+	printf("ringbench: passed\n");
+	return 0;
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * rwbench - read/write throughput at different buffer sizes.
+ *
+ * Usage: rwbench [file]
+ *
+ * For each buffer size from 1 byte to 64K, by factors of 4, writes a
+ * file with that size of write() and reads it back with that size of
+ * read(), and prints the calls per second and bytes per second for
+ * each. The small sizes show the fixed cost of a call; the large ones
+ * show the cost per byte, which should be one copy between the user
+ * buffer and the file system.
+ *
+ * Each size moves at most TOTALBYTES, and makes at most MAXCALLS
+ * calls, so the 1-byte case doesn't take all day.
+ */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <err.h>
+#include <test/bench.h>
+
+#define DEFFILE		"rwbench.dat"
+#define MINSIZE		1
+#define MAXSIZE		65536
+#define TOTALBYTES	(1024*1024)
+#define MAXCALLS	8192
+
+static char buf[MAXSIZE];
+
+static
+void
+report(const char *what, size_t size, unsigned ncalls, unsigned long usecs)
+{
+	printf("%-5s %6zu bytes: %5u calls in %8lu us: "
+	       "%7lu calls/s %9lu bytes/s\n",
+	       what, size, ncalls, usecs, persec(ncalls, usecs),
+	       persec((unsigned long long)size * ncalls, usecs));
+}
+
+static
+void
+bench(const char *file, size_t size)
+{
+	time_t s0;
+	unsigned long ns0, usecs;
+	unsigned i, ncalls;
+	ssize_t r;
+	int fd;
+
+	ncalls = TOTALBYTES / size;
+	if (ncalls > MAXCALLS) {
+		ncalls = MAXCALLS;
+	}
+
+	fd = open(file, O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s", file);
+	}
+	__time(&s0, &ns0);
+	for (i=0; i<ncalls; i++) {
+		r = write(fd, buf, size);
+		if (r < 0) {
+			err(1, "%s: write", file);
+		}
+		if ((size_t)r != size) {
+			errx(1, "%s: short write (%zd of %zu)", file, r, size);
+		}
+	}
+	usecs = elapsed(s0, ns0);
+	close(fd);
+	report("write", size, ncalls, usecs);
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0) {
+		err(1, "%s", file);
+	}
+	__time(&s0, &ns0);
+	for (i=0; i<ncalls; i++) {
+		r = read(fd, buf, size);
+		if (r < 0) {
+			err(1, "%s: read", file);
+		}
+		if ((size_t)r != size) {
+			errx(1, "%s: short read (%zd of %zu)", file, r, size);
+		}
+	}
+	usecs = elapsed(s0, ns0);
+	close(fd);
+	report("read", size, ncalls, usecs);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *file;
+	size_t size;
+
+	if (argc > 2) {
+		errx(1, "Usage: rwbench [file]");
+	}
+	file = argc == 2 ? argv[1] : DEFFILE;
+
+	memset(buf, 'x', sizeof(buf));
+
+	for (size = MINSIZE; size <= MAXSIZE; size *= 4) {
+		bench(file, size);
+	}
+
+	remove(file);
+	return 0;
+}
@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * sharedofs - check that forked processes and dup2'd descriptors
+ * share one seek position.
+ *
+ * The parent opens a file and forks NCHILDREN children, which all
+ * write NRECS fixed-size records through the inherited descriptor as
+ * fast as they can. Since they share the offset, every record should
+ * land in a place of its own: the file should come out exactly
+ * NCHILDREN * NRECS records long, with no record torn or overwritten,
+ * and the parent's own offset should have moved to the end too.
+ *
+ * Then it checks that a dup2'd descriptor moves along with the one it
+ * was copied from, and still works after the original is closed.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <err.h>
+
+#define FILENAME	"sharedofs.dat"
+#define NCHILDREN	6
+#define NRECS		200
+#define RECSIZE		16
+
+/*
+ * A record is RECSIZE copies of the writer's letter, except for a
+ * newline at the end so the file can be looked at.
+ */
+static
+void
+mkrec(char *rec, int who)
+{
+	memset(rec, 'a' + who, RECSIZE - 1);
+	rec[RECSIZE - 1] = '\n';
+}
+
+static
+void
+child(int fd, int who)
+{
+	char rec[RECSIZE];
+	ssize_t r;
+	int i;
+
+	mkrec(rec, who);
+	for (i=0; i<NRECS; i++) {
+		r = write(fd, rec, RECSIZE);
+		if (r < 0) {
+			err(1, "child %d: write", who);
+		}
+		if (r != RECSIZE) {
+			errx(1, "child %d: short write (%zd)", who, r);
+		}
+	}
+	_exit(0);
+}
+
+static
+void
+forkwriters(int fd)
+{
+	pid_t pids[NCHILDREN];
+	int i, status, failed;
+
+	for (i=0; i<NCHILDREN; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			err(1, "fork");
+		}
+		if (pids[i] == 0) {
+			child(fd, i);
+		}
+	}
+
+	failed = 0;
+	for (i=0; i<NCHILDREN; i++) {
+		if (waitpid(pids[i], &status, 0) < 0) {
+			err(1, "waitpid");
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			warnx("child %d failed", i);
+			failed = 1;
+		}
+	}
+	if (failed) {
+		errx(1, "FAILED");
+	}
+}
+
+static
+void
+checkfile(int fd)
+{
+	char rec[RECSIZE], expect[RECSIZE];
+	int counts[NCHILDREN];
+	off_t pos;
+	ssize_t r;
+	int i, who;
+
+	pos = lseek(fd, 0, SEEK_CUR);
+	if (pos != NCHILDREN * NRECS * RECSIZE) {
+		errx(1, "Parent's offset is %lld; expected %d",
+		     (long long)pos, NCHILDREN * NRECS * RECSIZE);
+	}
+
+	if (lseek(fd, 0, SEEK_SET) != 0) {
+		err(1, "lseek");
+	}
+
+	for (i=0; i<NCHILDREN; i++) {
+		counts[i] = 0;
+	}
+	for (i=0; i<NCHILDREN * NRECS; i++) {
+		r = read(fd, rec, RECSIZE);
+		if (r < 0) {
+			err(1, "read");
+		}
+		if (r != RECSIZE) {
+			errx(1, "Record %d: short read (%zd)", i, r);
+		}
+		who = rec[0] - 'a';
+		if (who < 0 || who >= NCHILDREN) {
+			errx(1, "Record %d: garbage", i);
+		}
+		mkrec(expect, who);
+		if (memcmp(rec, expect, RECSIZE) != 0) {
+			errx(1, "Record %d: torn or overwritten", i);
+		}
+		counts[who]++;
+	}
+
+	r = read(fd, rec, RECSIZE);
+	if (r != 0) {
+		errx(1, "File is longer than it should be");
+	}
+
+	for (i=0; i<NCHILDREN; i++) {
+		if (counts[i] != NRECS) {
+			errx(1, "Child %d: %d records; expected %d",
+			     i, counts[i], NRECS);
+		}
+	}
+}
+
+static
+void
+checkdup2(int fd)
+{
+	char rec[RECSIZE];
+	int fd2 = 20;
+	off_t pos;
+
+	if (dup2(fd, fd2) != fd2) {
+		err(1, "dup2");
+	}
+
+	if (lseek(fd, RECSIZE, SEEK_SET) != RECSIZE) {
+		err(1, "lseek");
+	}
+	pos = lseek(fd2, 0, SEEK_CUR);
+	if (pos != RECSIZE) {
+		errx(1, "dup2: offset %lld after seek on other fd",
+		     (long long)pos);
+	}
+
+	if (read(fd2, rec, RECSIZE) != RECSIZE) {
+		err(1, "read through dup2'd fd");
+	}
+	pos = lseek(fd, 0, SEEK_CUR);
+	if (pos != 2 * RECSIZE) {
+		errx(1, "dup2: offset %lld after read on other fd",
+		     (long long)pos);
+	}
+
+	/* The file stays open through the other descriptor. */
+	if (close(fd)) {
+		err(1, "close");
+	}
+	if (read(fd2, rec, RECSIZE) != RECSIZE) {
+		err(1, "read after closing original fd");
+	}
+	if (close(fd2)) {
+		err(1, "close");
+	}
+}
+
+int
+main(void)
+{
+	int fd;
+
+	fd = open(FILENAME, O_RDWR|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s", FILENAME);
+	}
+
+	printf("sharedofs: %d children writing %d records each...\n",
+	       NCHILDREN, NRECS);
+	forkwriters(fd);
+	checkfile(fd);
+	checkdup2(fd);
+
+	remove(FILENAME);
+	printf("sharedofs: passed\n");
+	return 0;
+}
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * spawnbench - command launch latency, spawn vs. fork and execv.
+ *
+ * Usage: spawnbench [count]
+ *
+ * Starts COUNT (default 1000) copies of itself, one at a time, each
+ * of which exits at once, and waits for each one; first with spawn(),
+ * then with fork() and execv(). Prints the average time per launch
+ * for both. Also checks that spawn reports a missing program itself,
+ * and that a file action takes effect in the child.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <spawn.h>
+#include <err.h>
+#include <test/bench.h>
+
+#define PROG		"/testbin/spawnbench"
+#define DEFCOUNT	1000
+#define TESTFILE	"spawnbench.out"
+#define MSG		"spawnbench child\n"
+
+static
+void
+reap(pid_t pid)
+{
+	int status;
+
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		errx(1, "child %d failed", pid);
+	}
+}
+
+static
+void
+report(const char *what, unsigned count, unsigned long usecs)
+{
+	printf("%-12s %5u launches in %9lu us: %7lu us each\n",
+	       what, count, usecs, usecs / count);
+}
+
+static
+void
+spawnloop(unsigned count)
+{
+	char *args[3] = { (char *)PROG, (char *)"-x", NULL };
+	time_t s0;
+	unsigned long ns0;
+	unsigned i;
+	pid_t pid;
+
+	__time(&s0, &ns0);
+	for (i=0; i<count; i++) {
+		pid = spawn(PROG, args, NULL, 0);
+		if (pid < 0) {
+			err(1, "spawn");
+		}
+		reap(pid);
+	}
+	report("spawn", count, elapsed(s0, ns0));
+}
+
+static
+void
+forkloop(unsigned count)
+{
+	char *args[3] = { (char *)PROG, (char *)"-x", NULL };
+	time_t s0;
+	unsigned long ns0;
+	unsigned i;
+	pid_t pid;
+
+	__time(&s0, &ns0);
+	for (i=0; i<count; i++) {
+		pid = fork();
+		if (pid < 0) {
+			err(1, "fork");
+		}
+		if (pid == 0) {
+			execv(PROG, args);
+			_exit(1);
+		}
+		reap(pid);
+	}
+	report("fork+execv", count, elapsed(s0, ns0));
+}
+
+static
+void
+checkspawn(void)
+{
+	char *args[3] = { (char *)PROG, (char *)"-w", NULL };
+	struct spawn_action act;
+	char buf[sizeof(MSG)];
+	ssize_t r;
+	pid_t pid;
+	int fd;
+
+	if (spawn("/testbin/no-such-program", args, NULL, 0) >= 0 ||
+	    errno != ENOENT) {
+		errx(1, "spawn of a missing program didn't fail with ENOENT");
+	}
+
+	/* The child writes to stdout, which should be the file */
+	act.sa_op = SPAWN_OPEN;
+	act.sa_fd = STDOUT_FILENO;
+	act.sa_newfd = -1;
+	act.sa_flags = O_WRONLY|O_CREAT|O_TRUNC;
+	act.sa_mode = 0664;
+	act.sa_path = TESTFILE;
+	pid = spawn(PROG, args, &act, 1);
+	if (pid < 0) {
+		err(1, "spawn with an open action");
+	}
+	reap(pid);
+
+	fd = open(TESTFILE, O_RDONLY);
+	if (fd < 0) {
+		err(1, "%s", TESTFILE);
+	}
+	r = read(fd, buf, sizeof(buf));
+	if (r != sizeof(MSG) - 1 || memcmp(buf, MSG, r) != 0) {
+		errx(1, "%s doesn't have the child's output", TESTFILE);
+	}
+	close(fd);
+	remove(TESTFILE);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned count;
+
+	/* Child modes */
+	if (argc == 2 && !strcmp(argv[1], "-x")) {
+		_exit(0);
+	}
+	if (argc == 2 && !strcmp(argv[1], "-w")) {
+		write(STDOUT_FILENO, MSG, sizeof(MSG) - 1);
+		_exit(0);
+	}
+
+	if (argc > 2) {
+		errx(1, "Usage: spawnbench [count]");
+	}
+	count = argc == 2 ? (unsigned)atoi(argv[1]) : DEFCOUNT;
+	if (count == 0) {
+		errx(1, "Usage: spawnbench [count]");
+	}
+
+	checkspawn();
+	spawnloop(count);
+	forkloop(count);
+
+	printf("spawnbench: passed\n");
+	return 0;
+}
@@ -0,0 +1,306 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * usagetest - getrusage/wait4 check.
+ *
+ * Usage: usagetest
+ *
+ * Checks that each thing getrusage counts goes up when it should:
+ * user time while spinning, system time while making system calls,
+ * minor faults when touching pages for the first time, and voluntary
+ * context switches when sleeping in a read. Prints the filesystem
+ * block counts for writing and reading back a file, which are only
+ * counted on SFS. Then checks that wait4 hands back a child's usage
+ * and that the parent's RUSAGE_CHILDREN includes it, and times a
+ * system call so the cost of the accounting can be compared against
+ * an earlier kernel.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <err.h>
+#include <test/bench.h>
+
+#define TESTFILE	"usagetest.dat"
+#define SPINUSECS	200000
+#define NCALLS		2000
+#define NPAGES		16	/* Well under dumbvm's TLB size */
+#define PAGESIZE	4096
+#define FILESIZE	(32*1024)
+
+static char pages[NPAGES * PAGESIZE];
+static char buf[FILESIZE];
+
+static
+unsigned long
+usecs(const struct timeval *tv)
+{
+	return tv->tv_sec * 1000000UL + tv->tv_usec;
+}
+
+static
+void
+getusage(int who, struct rusage *ru)
+{
+	if (getrusage(who, ru) < 0) {
+		err(1, "getrusage");
+	}
+}
+
+static
+void
+spin(unsigned long us)
+{
+	time_t s0;
+	unsigned long ns0;
+
+	__time(&s0, &ns0);
+	while (elapsed(s0, ns0) < us) {
+		/* spin */
+	}
+}
+
+static
+void
+checktime(void)
+{
+	struct rusage r0, r1;
+	unsigned long u, s;
+	time_t s0;
+	unsigned long ns0, spent;
+	int i;
+
+	/*
+	 * elapsed() is itself a system call, so spin without it
+	 * for most of the time.
+	 */
+	getusage(RUSAGE_SELF, &r0);
+	__time(&s0, &ns0);
+	do {
+		for (i=0; i<100000; i++) {
+			pages[0] = i;
+		}
+		spent = elapsed(s0, ns0);
+	} while (spent < SPINUSECS);
+	getusage(RUSAGE_SELF, &r1);
+	u = usecs(&r1.ru_utime) - usecs(&r0.ru_utime);
+	s = usecs(&r1.ru_stime) - usecs(&r0.ru_stime);
+	printf("spin:     %lu us: %lu us user, %lu us system\n", spent, u, s);
+	if (u < spent / 2) {
+		errx(1, "spinning for %lu us only took %lu us user time",
+		     spent, u);
+	}
+
+	getusage(RUSAGE_SELF, &r0);
+	for (i=0; i<NCALLS; i++) {
+		getpid();
+	}
+	getusage(RUSAGE_SELF, &r1);
+	u = usecs(&r1.ru_utime) - usecs(&r0.ru_utime);
+	s = usecs(&r1.ru_stime) - usecs(&r0.ru_stime);
+	printf("syscalls: %d getpids: %lu us user, %lu us system\n",
+	       NCALLS, u, s);
+	if (s == 0) {
+		errx(1, "%d system calls took no system time", NCALLS);
+	}
+}
+
+static
+void
+checkfaults(void)
+{
+	struct rusage r0, r1;
+	unsigned long n;
+	unsigned i;
+
+	getusage(RUSAGE_SELF, &r0);
+	for (i=1; i<NPAGES; i++) {
+		pages[i * PAGESIZE] = i;
+	}
+	getusage(RUSAGE_SELF, &r1);
+	n = r1.ru_minflt - r0.ru_minflt;
+	printf("faults:   %lu touching %d new pages\n", n, NPAGES - 1);
+	if (n < NPAGES - 1) {
+		errx(1, "too few faults");
+	}
+}
+
+static
+void
+checkswitch(void)
+{
+	struct rusage r0, r1;
+	int fds[2];
+	pid_t pid;
+	char ch;
+
+	if (pipe(fds) < 0) {
+		err(1, "pipe");
+	}
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		spin(SPINUSECS / 4);
+		write(fds[1], "x", 1);
+		_exit(0);
+	}
+
+	getusage(RUSAGE_SELF, &r0);
+	if (read(fds[0], &ch, 1) != 1) {
+		err(1, "read");
+	}
+	getusage(RUSAGE_SELF, &r1);
+	waitpid(pid, NULL, 0);
+	close(fds[0]);
+	close(fds[1]);
+
+	printf("switches: %lu voluntary, %lu involuntary across a read\n",
+	       (unsigned long)(r1.ru_nvcsw - r0.ru_nvcsw),
+	       (unsigned long)(r1.ru_nivcsw - r0.ru_nivcsw));
+	if (r1.ru_nvcsw == r0.ru_nvcsw) {
+		errx(1, "sleeping in read wasn't a voluntary switch");
+	}
+}
+
+static
+void
+checkblocks(void)
+{
+	struct rusage r0, r1, r2;
+	int fd;
+
+	getusage(RUSAGE_SELF, &r0);
+	fd = open(TESTFILE, O_RDWR|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s", TESTFILE);
+	}
+	if (write(fd, buf, FILESIZE) != FILESIZE) {
+		err(1, "write");
+	}
+	if (fsync(fd) < 0) {
+		err(1, "fsync");
+	}
+	getusage(RUSAGE_SELF, &r1);
+	lseek(fd, 0, SEEK_SET);
+	if (read(fd, buf, FILESIZE) != FILESIZE) {
+		err(1, "read");
+	}
+	getusage(RUSAGE_SELF, &r2);
+	close(fd);
+	remove(TESTFILE);
+
+	printf("blocks:   %lu written for %d bytes, %lu read back "
+	       "(0 if not on SFS)\n",
+	       (unsigned long)(r1.ru_oublock - r0.ru_oublock), FILESIZE,
+	       (unsigned long)(r2.ru_inblock - r1.ru_inblock));
+}
+
+static
+void
+checkwait4(void)
+{
+	struct rusage ru, c0, c1;
+	unsigned long u, cu;
+	int status;
+	pid_t pid;
+
+	getusage(RUSAGE_CHILDREN, &c0);
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		spin(SPINUSECS);
+		_exit(0);
+	}
+
+	if (wait4(pid, &status, 0, &ru) != pid) {
+		err(1, "wait4");
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		errx(1, "child failed");
+	}
+	getusage(RUSAGE_CHILDREN, &c1);
+
+	u = usecs(&ru.ru_utime) + usecs(&ru.ru_stime);
+	cu = usecs(&c1.ru_utime) + usecs(&c1.ru_stime) -
+		usecs(&c0.ru_utime) - usecs(&c0.ru_stime);
+	printf("wait4:    child spun %d us, used %lu us; children now "
+	       "%lu us more\n", SPINUSECS, u, cu);
+	if (u < SPINUSECS / 2) {
+		errx(1, "wait4 says the child used only %lu us", u);
+	}
+	/* Each figure is truncated to a microsecond separately */
+	if (cu + 4 < u || cu > u + 4) {
+		errx(1, "RUSAGE_CHILDREN went up %lu us, not %lu", cu, u);
+	}
+}
+
+static
+void
+timecalls(void)
+{
+	time_t s0;
+	unsigned long ns0, us;
+	int i;
+
+	__time(&s0, &ns0);
+	for (i=0; i<NCALLS; i++) {
+		getpid();
+	}
+	us = elapsed(s0, ns0);
+	printf("cost:     %d getpids in %lu us, %lu ns each\n",
+	       NCALLS, us, us * 1000 / NCALLS);
+}
+
+int
+main(int argc, char *argv[])
+{
+	(void)argv;
+	if (argc != 1) {
+		errx(1, "Usage: usagetest");
+	}
+
+	checktime();
+	checkfaults();
+	checkswitch();
+	checkblocks();
+	checkwait4();
+	timecalls();
+
+	printf("usagetest: passed\n");
+	return 0;
+}
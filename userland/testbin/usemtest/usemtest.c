@@ -44,6 +44,10 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <err.h>
+#ifndef HOST
+#include <futex.h>
+#include <test/bench.h>
+#endif
 
 #define ONCELOOPS   3
 #define TWICELOOPS  2
@@ -376,6 +380,66 @@ conctest(void)
 	}
 }
 
+////////////////////////////////////////////////////////////
+// speed comparison
+
+#ifndef HOST
+
+#define SPEEDLOOPS 10000U
+
+/*
+ * Compare the cost of an uncontended V/P pair on a semfs semaphore,
+ * which is two system calls, against a futex semaphore, which should
+ * be none.
+ */
+
+static
+void
+report(const char *what, unsigned long usecs)
+{
+	if (usecs == 0) {
+		printf("%s: %u V/P pairs in no measurable time\n",
+		       what, SPEEDLOOPS);
+		return;
+	}
+	printf("%s: %u V/P pairs in %lu us, %lu per second\n",
+	       what, SPEEDLOOPS, usecs, persec(SPEEDLOOPS, usecs));
+}
+
+static
+void
+speedtest(void)
+{
+	struct usem usem;
+	struct fsem fsem;
+	time_t s0;
+	unsigned long ns0;
+	unsigned i;
+
+	say("Speed...\n");
+
+	usem_init(&usem, "s", 0);
+	usem_open(&usem);
+	__time(&s0, &ns0);
+	for (i=0; i<SPEEDLOOPS; i++) {
+		V(&usem);
+		P(&usem);
+	}
+	report("semfs", elapsed(s0, ns0));
+	usem_close(&usem);
+	usem_cleanup(&usem);
+
+	fsem_init(&fsem, 0);
+	__time(&s0, &ns0);
+	for (i=0; i<SPEEDLOOPS; i++) {
+		fsem_V(&fsem);
+		fsem_P(&fsem);
+	}
+	report("futex", elapsed(s0, ns0));
+}
+
+#endif /* HOST */
+
 ////////////////////////////////////////////////////////////
 // concurrent use test
 
@@ -384,6 +448,9 @@ main(void)
 {
 	basetest();
 	conctest();
+#ifndef HOST
+	speedtest();
+#endif
 	say("Passed.\n");
 	return 0;
 }
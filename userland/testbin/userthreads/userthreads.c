@@ -32,17 +32,12 @@
  * forks 3 threads off 2 to functions, each of which displays a string
  * every once in a while.
  *
- * This won't do much of anything unless you implement user-level
- * threads.
- *
- * It also makes various assumptions about the thread API. In
- * particular, it believes (1) that you create a thread by calling
- * "threadfork()" and passing the address for execution of the new
- * thread to begin at, (2) that if the parent thread exits any child
- * threads will keep running, and (3) child threads will exit if they
- * return from the function they started in. If any or all of these
- * assumptions are not met by your user-level threads, you will need
- * to patch this test accordingly.
+ * Threads are created with threadfork(), which takes the function
+ * and its argument and a stack for the new thread to run on, and
+ * returns a thread id. A thread that returns from its function exits,
+ * and the parent collects it with threadjoin(). The parent waits for
+ * its children before leaving, since exiting from main ends the whole
+ * process.
  *
  * This is also a rather basic test and you'll probably want to write
  * some more of your own.
@@ -51,35 +46,47 @@
 
 #include <unistd.h>
 #include <stdio.h>
+#include <err.h>
 
 #define NTHREADS  3
 #define MAX       1<<25
+#define STACKSIZE 16384
 
 /* counter for the loop in the threads:
    This variable is shared and incremented by each
    thread during his computation */
 volatile int count = 0;
 
+/* stacks for the threads */
+static char stacks[NTHREADS][STACKSIZE];
+
 /* the 2 threads : */
-void ThreadRunner(void);
-void BladeRunner(void);
+void ThreadRunner(void *);
+void BladeRunner(void *);
 
 int
 main(int argc, char *argv[])
 {
-    int i;
+    int i, tids[NTHREADS];
 
     (void)argc;
     (void)argv;
 
     for (i=0; i<NTHREADS; i++) {
-	if (i)
-	    threadfork(ThreadRunner);
-        else
-	    threadfork(BladeRunner);
+	tids[i] = threadfork(i ? ThreadRunner : BladeRunner, NULL,
+			     stacks[i], STACKSIZE);
+	if (tids[i] < 0) {
+	    err(1, "threadfork");
+	}
+    }
+
+    for (i=0; i<NTHREADS; i++) {
+	if (threadjoin(tids[i], NULL) < 0) {
+	    err(1, "threadjoin");
+	}
     }
 
-    tprintf("Parent has left.\n");
+    tprintf("\nParent has left.\n");
     return 0;
 }
 
@@ -89,8 +96,9 @@ main(int argc, char *argv[])
 */
 
 void
-BladeRunner()
+BladeRunner(void *arg)
 {
+    (void)arg;
     while (count < MAX) {
 	if (count % 500 == 0)
 	    tprintf("Blade ");
@@ -99,8 +107,9 @@ BladeRunner()
 }
 
 void
-ThreadRunner()
+ThreadRunner(void *arg)
 {
+    (void)arg;
     while (count < MAX) {
 	if (count % 513 == 0)
 	    tprintf(" Runner\n");
@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * vecbench - readv/writev check and benchmark.
+ *
+ * Usage: vecbench [file]
+ *
+ * Writes NRECS records, each a small header and a payload, to a file
+ * two ways: with two write() calls per record, and with one writev()
+ * per record. Then reads the file back both ways: two read() calls
+ * per record, and readv() of BATCH records at a time. Prints the
+ * number of system calls and the time for each, at a few payload
+ * sizes, and checks that what comes back is what went in.
+ *
+ * Also checks that readv/writev reject iovec counts of 0 and more
+ * than IOV_MAX.
+ */
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <err.h>
+#include <test/bench.h>
+
+#define DEFFILE		"vecbench.dat"
+#define NRECS		1024
+#define BATCH		8
+#define MAXPAYLOAD	4096
+
+struct hdr {
+	unsigned h_seq;
+	unsigned h_len;
+	unsigned h_sum;
+	unsigned h_magic;
+};
+
+#define HDRMAGIC	0x76656362
+
+static char payload[BATCH][MAXPAYLOAD];
+static struct hdr hdrs[BATCH];
+
+static
+void
+report(const char *what, size_t len, unsigned ncalls, unsigned long usecs)
+{
+	unsigned long long bytes;
+
+	bytes = (unsigned long long)NRECS * (sizeof(struct hdr) + len);
+	printf("%-12s %4zu-byte payload: %5u calls in %8lu us: "
+	       "%9lu bytes/s\n",
+	       what, len, ncalls, usecs, persec(bytes, usecs));
+}
+
+static
+unsigned
+sum(const char *p, size_t len)
+{
+	unsigned s = 0;
+	size_t i;
+
+	for (i=0; i<len; i++) {
+		s = s * 31 + (unsigned char)p[i];
+	}
+	return s;
+}
+
+static
+void
+mkrec(unsigned seq, size_t len, struct hdr *h, char *p)
+{
+	size_t i;
+
+	for (i=0; i<len; i++) {
+		p[i] = 'a' + (seq + i) % 26;
+	}
+	h->h_seq = seq;
+	h->h_len = len;
+	h->h_sum = sum(p, len);
+	h->h_magic = HDRMAGIC;
+}
+
+static
+void
+chkrec(unsigned seq, size_t len, const struct hdr *h, const char *p)
+{
+	if (h->h_magic != HDRMAGIC || h->h_seq != seq || h->h_len != len) {
+		errx(1, "Record %u: bad header", seq);
+	}
+	if (h->h_sum != sum(p, len)) {
+		errx(1, "Record %u: bad payload", seq);
+	}
+}
+
+static
+void
+chkxfer(const char *what, ssize_t r, size_t expected)
+{
+	if (r < 0) {
+		err(1, "%s", what);
+	}
+	if ((size_t)r != expected) {
+		errx(1, "%s: short count (%zd of %zu)", what, r, expected);
+	}
+}
+
+static
+int
+openfile(const char *file, int flags)
+{
+	int fd;
+
+	fd = open(file, flags, 0664);
+	if (fd < 0) {
+		err(1, "%s", file);
+	}
+	return fd;
+}
+
+static
+void
+bench(const char *file, size_t len)
+{
+	struct iovec iov[2 * BATCH];
+	time_t s0;
+	unsigned long ns0, usecs;
+	unsigned seq, ncalls;
+	int fd, i;
+
+	/* write, twice per record */
+	fd = openfile(file, O_WRONLY|O_CREAT|O_TRUNC);
+	ncalls = 0;
+	__time(&s0, &ns0);
+	for (seq=0; seq<NRECS; seq++) {
+		mkrec(seq, len, &hdrs[0], payload[0]);
+		chkxfer("write", write(fd, &hdrs[0], sizeof(hdrs[0])),
+			sizeof(hdrs[0]));
+		chkxfer("write", write(fd, payload[0], len), len);
+		ncalls += 2;
+	}
+	usecs = elapsed(s0, ns0);
+	close(fd);
+	report("write", len, ncalls, usecs);
+
+	/* writev, once per record */
+	fd = openfile(file, O_WRONLY|O_CREAT|O_TRUNC);
+	ncalls = 0;
+	__time(&s0, &ns0);
+	for (seq=0; seq<NRECS; seq++) {
+		mkrec(seq, len, &hdrs[0], payload[0]);
+		iov[0].iov_base = &hdrs[0];
+		iov[0].iov_len = sizeof(hdrs[0]);
+		iov[1].iov_base = payload[0];
+		iov[1].iov_len = len;
+		chkxfer("writev", writev(fd, iov, 2), sizeof(hdrs[0]) + len);
+		ncalls++;
+	}
+	usecs = elapsed(s0, ns0);
+	close(fd);
+	report("writev", len, ncalls, usecs);
+
+	/* read, twice per record */
+	fd = openfile(file, O_RDONLY);
+	ncalls = 0;
+	__time(&s0, &ns0);
+	for (seq=0; seq<NRECS; seq++) {
+		chkxfer("read", read(fd, &hdrs[0], sizeof(hdrs[0])),
+			sizeof(hdrs[0]));
+		chkxfer("read", read(fd, payload[0], len), len);
+		ncalls += 2;
+		chkrec(seq, len, &hdrs[0], payload[0]);
+	}
+	usecs = elapsed(s0, ns0);
+	close(fd);
+	report("read", len, ncalls, usecs);
+
+	/* readv, BATCH records per call */
+	fd = openfile(file, O_RDONLY);
+	ncalls = 0;
+	__time(&s0, &ns0);
+	for (seq=0; seq<NRECS; seq+=BATCH) {
+		for (i=0; i<BATCH; i++) {
+			iov[2*i].iov_base = &hdrs[i];
+			iov[2*i].iov_len = sizeof(hdrs[i]);
+			iov[2*i+1].iov_base = payload[i];
+			iov[2*i+1].iov_len = len;
+		}
+		chkxfer("readv", readv(fd, iov, 2 * BATCH),
+			BATCH * (sizeof(hdrs[0]) + len));
+		ncalls++;
+		for (i=0; i<BATCH; i++) {
+			chkrec(seq + i, len, &hdrs[i], payload[i]);
+		}
+	}
+	usecs = elapsed(s0, ns0);
+	close(fd);
+	report("readv", len, ncalls, usecs);
+}
+
+static
+void
+badcounts(const char *file)
+{
+	struct iovec iov;
+	char c;
+	int fd;
+
+	iov.iov_base = &c;
+	iov.iov_len = 1;
+
+	fd = openfile(file, O_RDWR|O_CREAT|O_TRUNC);
+	if (writev(fd, &iov, 0) >= 0 || errno != EINVAL) {
+		errx(1, "writev with no iovecs didn't fail with EINVAL");
+	}
+	if (readv(fd, &iov, IOV_MAX + 1) >= 0 || errno != EINVAL) {
+		errx(1, "readv with IOV_MAX+1 iovecs didn't fail with EINVAL");
+	}
+	close(fd);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *file;
+	size_t len;
+
+	if (argc > 2) {
+		errx(1, "Usage: vecbench [file]");
+	}
+	file = argc == 2 ? argv[1] : DEFFILE;
+
+	badcounts(file);
+	for (len = 16; len <= MAXPAYLOAD; len *= 16) {
+		bench(file, len);
+	}
+
+	remove(file);
+	printf("vecbench: passed\n");
+	return 0;
+}
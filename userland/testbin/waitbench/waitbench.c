@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009, 2010
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * waitbench - waitpid/_exit check and benchmark.
+ *
+ * Usage: waitbench
+ *
+ * Checks that each child's exit code (or the signal that killed it)
+ * comes back to the parent whether it is waited for by pid or with
+ * WAIT_ANY, that WNOHANG doesn't wait for a child still running, and
+ * that waiting for something that isn't our child fails the way it
+ * should. Then times NROUNDS rounds of fork, _exit and waitpid, one
+ * child at a time and NBATCH children at a time.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <err.h>
+#include <test/bench.h>
+
+#define NCHILDREN	32
+#define NROUNDS		256
+#define NBATCH		16
+#define SPINUSECS	200000
+
+/*
+ * Fork a child that spins for USECS microseconds and then exits
+ * with CODE.
+ */
+static
+pid_t
+spawnchild(int code, unsigned long usecs)
+{
+	time_t s0;
+	unsigned long ns0;
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		__time(&s0, &ns0);
+		while (usecs > 0 && elapsed(s0, ns0) < usecs) {
+			/* spin */
+		}
+		_exit(code);
+	}
+	return pid;
+}
+
+static
+int
+reap(pid_t pid, int options)
+{
+	pid_t r;
+	int status;
+
+	r = waitpid(pid, &status, options);
+	if (r < 0) {
+		err(1, "waitpid %d", pid);
+	}
+	if (r != pid) {
+		errx(1, "waitpid %d returned %d", pid, r);
+	}
+	return status;
+}
+
+static
+void
+checkexit(int status, int code)
+{
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != code) {
+		errx(1, "Bad status 0x%x; expected exit code %d", status, code);
+	}
+}
+
+/*
+ * Exit codes come back, with children reaped by pid in the opposite
+ * order from how they were started.
+ */
+static
+void
+bypid(void)
+{
+	pid_t pids[NCHILDREN];
+	int i;
+
+	for (i=0; i<NCHILDREN; i++) {
+		pids[i] = spawnchild(i, 0);
+	}
+	for (i=NCHILDREN-1; i>=0; i--) {
+		checkexit(reap(pids[i], 0), i);
+	}
+}
+
+/*
+ * Same with WAIT_ANY; each child should turn up exactly once, and
+ * then there should be nobody left.
+ */
+static
+void
+byany(void)
+{
+	pid_t pids[NCHILDREN];
+	int seen[NCHILDREN];
+	int i, j, status;
+	pid_t r;
+
+	for (i=0; i<NCHILDREN; i++) {
+		pids[i] = spawnchild(i, 0);
+		seen[i] = 0;
+	}
+	for (i=0; i<NCHILDREN; i++) {
+		r = waitpid(WAIT_ANY, &status, 0);
+		if (r < 0) {
+			err(1, "waitpid WAIT_ANY");
+		}
+		for (j=0; j<NCHILDREN && pids[j] != r; j++) {
+			/* nothing */
+		}
+		if (j == NCHILDREN) {
+			errx(1, "waitpid WAIT_ANY returned %d, not a child", r);
+		}
+		if (seen[j]++) {
+			errx(1, "waitpid WAIT_ANY returned %d twice", r);
+		}
+		checkexit(status, j);
+	}
+	if (waitpid(WAIT_ANY, &status, 0) >= 0 || errno != ECHILD) {
+		errx(1, "waitpid WAIT_ANY with no children didn't fail "
+		     "with ECHILD");
+	}
+}
+
+/*
+ * WNOHANG returns 0 while the child is still running.
+ */
+static
+void
+nohang(void)
+{
+	pid_t pid, r;
+	int status;
+
+	pid = spawnchild(7, SPINUSECS);
+	r = waitpid(pid, &status, WNOHANG);
+	if (r < 0) {
+		err(1, "waitpid WNOHANG");
+	}
+	if (r != 0) {
+		errx(1, "waitpid WNOHANG returned %d for a running child", r);
+	}
+	checkexit(reap(pid, 0), 7);
+}
+
+/*
+ * A child killed by a fault is reported as signalled.
+ */
+static
+void
+killed(void)
+{
+	volatile int *p = NULL;
+	pid_t pid;
+	int status;
+
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		*p = 0;
+		_exit(0);
+	}
+	status = reap(pid, 0);
+	if (!WIFSIGNALED(status) || WTERMSIG(status) != SIGSEGV) {
+		errx(1, "Faulting child: bad status 0x%x", status);
+	}
+}
+
+/*
+ * Things that shouldn't work.
+ */
+static
+void
+errors(void)
+{
+	pid_t pid;
+	int status;
+
+	if (waitpid(getpid(), &status, 0) >= 0 || errno != ECHILD) {
+		errx(1, "waitpid on self didn't fail with ECHILD");
+	}
+
+	pid = spawnchild(0, 0);
+	reap(pid, 0);
+	if (waitpid(pid, &status, 0) >= 0 || errno != ESRCH) {
+		errx(1, "Second waitpid on a child didn't fail with ESRCH");
+	}
+
+	pid = spawnchild(0, 0);
+	if (waitpid(pid, &status, 0x100) >= 0 || errno != EINVAL) {
+		errx(1, "waitpid with bad options didn't fail with EINVAL");
+	}
+	reap(pid, 0);
+}
+
+static
+void
+report(const char *what, unsigned long usecs)
+{
+	printf("%-8s %4d children in %8lu us: %5lu us each\n",
+	       what, NROUNDS, usecs, usecs / NROUNDS);
+}
+
+static
+void
+bench(void)
+{
+	time_t s0;
+	unsigned long ns0;
+	int i, j;
+
+	__time(&s0, &ns0);
+	for (i=0; i<NROUNDS; i++) {
+		reap(spawnchild(0, 0), 0);
+	}
+	report("serial", elapsed(s0, ns0));
+
+	__time(&s0, &ns0);
+	for (i=0; i<NROUNDS; i+=NBATCH) {
+		for (j=0; j<NBATCH; j++) {
+			spawnchild(0, 0);
+		}
+		for (j=0; j<NBATCH; j++) {
+			if (waitpid(WAIT_ANY, NULL, 0) < 0) {
+				err(1, "waitpid WAIT_ANY");
+			}
+		}
+	}
+	report("batched", elapsed(s0, ns0));
+}
+
+int
+main(void)
+{
+	bypid();
+	byany();
+	nohang();
+	killed();
+	errors();
+	bench();
+
+	printf("waitbench: passed\n");
+	return 0;
+}